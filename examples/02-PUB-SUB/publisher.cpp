@@ -8,7 +8,7 @@
 #include <vector>
 #include <stdlib.h>
 
-#include "../../zmqHelper.hpp"
+#include "../../zmqHelperXPublisher.hpp"
 
 // ---------------------------------------------------------------
 // ---------------------------------------------------------------
@@ -18,19 +18,24 @@ int main () {
 
   const int N = 20;
 
-  SocketAdaptor< ZMQ_PUB > sa; 
+  zmq::context_t theContext {1};
+
+  // (a XPUB underneath: it gets the subscriptions)
+  SubscriptionAwarePublisher publisher {theContext};
   
-  sa.bind ("tcp://*:5555");
+  publisher.bind ("tcp://*:5555");
+
+  // publish once the subscriber has subscribed "news" (not into
+  // the void: a connection alone does not mean subscribed)
+  std::cout << " waiting for a subscriber \n";
+  publisher.awaitSubscriber ("news");
   
   int i;
   
   for (i=1; i<=N; i++) {
 	std::cout << " publishing " << i << "\n";
 	
-	std::vector<std::string> multi = { "news", "nachrichten" };
-	sa.sendText ( multi );
-	
-	sleep (1);
+	publisher.publish ("news", { "nachrichten" });
   } // true
 
   assert ( i = N+1);
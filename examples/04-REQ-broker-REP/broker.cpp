@@ -6,7 +6,7 @@
 #include <string>
 #include <iostream>
 
-#include "../../zmqHelper.hpp"
+#include "../../zmqHelperCache.hpp"
 
 using namespace zmqHelper;
 
@@ -33,56 +33,18 @@ int main ()
   std::cout << " done \n";
 
   //
+  // forward whole messages both ways, moving the zmq frames
+  // (receiveText()/sendText() would copy them into strings and back)
   //
-  //
-  while (true) {
-
-        std::vector<std::string> lines;
-        
-        // 
-        //  wait (blocking poll) for data in any socket
-        // 
-        std::vector< zmqHelper::ZmqSocketType * > list
-          = {  frontend_ROUTER.getZmqSocket(),  backend_DEALER.getZmqSocket() };
-
-        zmqHelper::ZmqSocketType *  who = zmqHelper::waitForDataInSockets ( list );
-
-        // 
-        //  there is data, where is it from?
-        // 
-        if ( who ==  frontend_ROUTER.getZmqSocket() ) {
-          // 
-          // from frontend, read ...
-          // 
-          frontend_ROUTER.receiveText (lines);
-
-          // 
-          // ... and resend
-          // 
-          backend_DEALER.sendText( lines );
-
-		  std::cout << " ----------->>>>>>> from frontend to backend \n";
+  Proxy< ZMQ_ROUTER, ZMQ_DEALER > proxy {frontend_ROUTER, backend_DEALER};
 
-        }
-
-        else if ( who ==  backend_DEALER.getZmqSocket() ) {
-          // 
-          // from backend, read ...
-          // 
-          backend_DEALER.receiveText (lines);
-
-          // 
-          // ... and resend
-          // 
-          frontend_ROUTER.sendText( lines );
-
-		  std::cout << " <<<<<<------- from backend to frontend \n";
-		} 
-
-		else if ( who == nullptr ) {
-		  std::cerr << "Error in poll ?\n";
-		}
+  //
+  // requests starting with a cacheHeader () frame are answered
+  // from the cache when possible (the rest pass through)
+  //
+  ResponseCache cache;
+  proxy.addStage (cache);
 
-  } // while (true)
+  proxy.run (); // forever: there is no control socket
 
 } // () main
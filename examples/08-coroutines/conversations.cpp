@@ -0,0 +1,97 @@
+// ---------------------------------------------------------------
+// conversations.cpp
+//
+// Many concurrent request-reply conversations
+// (coroutines) on a single thread:
+//
+//    N x DEALER (one per conversation) --> ROUTER echo server
+//
+// Each conversation costs a coroutine frame, not a thread.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "../../zmqHelperCoroutines.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int CONVERSATIONS = 400;
+const int ROUNDS = 20;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+Task echoServer (Executor & ex, zmq::context_t & context, int expected) {
+
+  CoSocket< ZMQ_ROUTER > router {ex, context};
+  router.bind ("inproc://echo");
+
+  for (int i=1; i<=expected; i++) {
+	// identity, empty, payload
+	std::vector<std::string> lines = co_await router.receive ();
+
+	co_await router.send (std::move (lines));
+  } // for
+
+  std::cout << " echo server: " << expected << " requests served \n";
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+Task conversation (Executor & ex, zmq::context_t & context, int who, int & done) {
+
+  CoSocket< ZMQ_DEALER > dealer {ex, context};
+  dealer.connect ("inproc://echo");
+
+  for (int i=1; i<=ROUNDS; i++) {
+	std::string text = std::to_string (who) + ":" + std::to_string (i);
+
+	std::vector<std::string> request = { "", text };
+	co_await dealer.send (request);
+
+	std::vector<std::string> lines = co_await dealer.receive ();
+
+	assert (lines.size () == 2 && lines[1] == text);
+  } // for
+
+  done++;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t context {1, 2 * CONVERSATIONS};
+
+  Executor ex;
+
+  int done = 0;
+
+  auto start = std::chrono::steady_clock::now ();
+
+  // the server binds first (it is the first one to run)
+  ex.spawn ( echoServer (ex, context, CONVERSATIONS * ROUNDS) );
+
+  for (int i=1; i<=CONVERSATIONS; i++) {
+	ex.spawn ( conversation (ex, context, i, done) );
+  }
+
+  size_t stuck = ex.run (); // (0: all of them finished)
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+
+  std::cout << " conversations done: " << done << " of " << CONVERSATIONS
+			<< " (" << ROUNDS << " rounds each) in " << elapsed << " ms,"
+			<< " one thread \n";
+
+  assert (stuck == 0);
+  assert (done == CONVERSATIONS);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,100 @@
+// ---------------------------------------------------------------
+// peers.cpp
+//
+// Hundreds of per-peer REP sockets served by a SocketScheduler:
+// the number of threads is the number of cores, not the number
+// of sockets.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <set>
+#include <sstream>
+
+#include "../../zmqHelperScheduler.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int PEERS = 300;
+const int ROUNDS = 10;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+std::string thisThread () {
+  std::ostringstream s;
+  s << std::this_thread::get_id ();
+  return s.str ();
+}
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1, 4 * PEERS};
+
+  SocketScheduler scheduler {theContext}; // one thread per core
+
+  //
+  // one REP socket for each peer
+  //
+  for (int i=0; i<PEERS; i++) {
+	std::string url = "inproc://peer-" + std::to_string (i);
+
+	scheduler.addSocket<ZMQ_REP> (
+	  [url] (SocketAdaptor<ZMQ_REP> & socket) {
+		socket.bind (url);
+	  },
+	  [] (SocketAdaptor<ZMQ_REP> & socket, std::vector<std::string> & lines) {
+		// reply: echo and who (which thread) did it
+		socket.sendText ( { lines[0], thisThread () } );
+	  } );
+  } // for
+
+  //
+  // the peers (in this thread)
+  //
+  std::vector< std::unique_ptr< SocketAdaptor<ZMQ_REQ> > > peers;
+  for (int i=0; i<PEERS; i++) {
+	peers.emplace_back ( new SocketAdaptor<ZMQ_REQ> {theContext} );
+	// inproc: connect may go before the bind (zmq >= 4.0)
+	peers.back()->connect ("inproc://peer-" + std::to_string (i));
+  }
+
+  std::set<std::string> serverThreads;
+  std::vector<std::string> lines;
+
+  for (int r=1; r<=ROUNDS; r++) {
+	for (int i=0; i<PEERS; i++) {
+	  peers[i]->sendText ( { std::to_string (i) } );
+	}
+	for (int i=0; i<PEERS; i++) {
+	  peers[i]->receiveText (lines);
+	  assert (lines[0] == std::to_string (i));
+	  serverThreads.insert (lines[1]);
+	}
+  } // for
+
+  std::cout << " " << PEERS << " sockets served by "
+			<< serverThreads.size () << " threads (pool of "
+			<< scheduler.threadCount () << ")\n";
+
+  for (unsigned int i=0; i<scheduler.threadCount (); i++) {
+	std::cout << "   pool thread " << i << ": "
+			  << scheduler.socketCount (i) << " sockets, "
+			  << scheduler.handledMessages (i) << " messages\n";
+  }
+
+  assert (serverThreads.size () <= scheduler.threadCount ());
+
+  for (auto & p : peers) {
+	p->close ();
+  }
+
+  scheduler.stop ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,81 @@
+// ---------------------------------------------------------------
+// skewed.cpp
+//
+//  ROUTER server whose requests have very different costs
+//  (most are cheap, some are expensive). Idle workers steal
+//  the requests queued behind an expensive one.
+//
+//  client (DEALER) -> ROUTER -> WorkStealingServer workers
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "../../zmqHelperWorkStealing.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const std::string URL = "tcp://127.0.0.1:5590";
+const int N = 200;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  //
+  // the handler: the request says how long (ms) it takes
+  //
+  WorkStealingServer server {theContext, URL,
+	[] (const std::vector<std::string> & request) -> std::vector<std::string> {
+	  std::this_thread::sleep_for (std::chrono::milliseconds (std::stoi (request[0])));
+	  return { "done", request[1] };
+	}, 4 }; // 4 workers
+
+  std::thread serverThread { [&server] () { server.run (); } };
+
+  //
+  // client
+  //
+  SocketAdaptor< ZMQ_DEALER > client {theContext};
+  client.connect (URL);
+
+  auto start = std::chrono::steady_clock::now ();
+
+  for (int i=1; i<=N; i++) {
+	// one in ten is expensive
+	std::string cost = (i % 10 == 0) ? "40" : "2";
+	client.sendText ( { "", cost, std::to_string (i) } );
+  }
+
+  std::vector<std::string> lines;
+  int i;
+  for (i=1; i<=N; i++) {
+	if ( ! client.receiveText (lines) ) break;
+	assert (lines.size () == 3 && lines[1] == "done");
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+
+  assert (i == N+1);
+
+  std::cout << " " << N << " requests in " << elapsed << " ms \n";
+  for (unsigned int w=0; w<server.workerCount (); w++) {
+	std::cout << "   worker " << w << ": handled " << server.handledBy (w)
+			  << ", stolen " << server.stolenBy (w) << "\n";
+  }
+
+  client.close ();
+
+  server.stop ();
+  serverThread.join ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,140 @@
+// ---------------------------------------------------------------
+// steerable.cpp
+//
+//   client REQ -> [ROUTER  Proxy  DEALER] -> REP worker
+//                        |     ^
+//                capture |     | control (PAUSE, RESUME,
+//                        v     |   STATISTICS, TERMINATE)
+//                tap (PULL)   main (REQ)
+//
+// All of them in one process, over inproc.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+
+#include "../../zmqHelperProxy.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int N = 1000;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+void showLines (const std::string & msg, const std::vector<std::string> & lines) {
+  std::cout << msg << ": |";
+  for (auto & s : lines) { std::cout << s << "|"; }
+  std::cout << "\n";
+}
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  //
+  // the proxy, in its own thread (which owns its sockets)
+  //
+  SocketAdaptorWithThread< ZMQ_ROUTER > proxyThread { theContext,
+	[&theContext] (SocketAdaptor<ZMQ_ROUTER> & frontend) {
+	  SocketAdaptor< ZMQ_DEALER > backend {theContext};
+	  SocketAdaptor< ZMQ_PUSH > capture {theContext};
+	  SocketAdaptor< ZMQ_REP > control {theContext};
+
+	  frontend.bind ("inproc://frontend");
+	  backend.bind ("inproc://backend");
+	  capture.bind ("inproc://capture");
+	  control.bind ("inproc://control");
+
+	  Proxy< ZMQ_ROUTER, ZMQ_DEALER > proxy {frontend, backend};
+	  proxy.setCapture (capture);
+	  proxy.setControl (control);
+
+	  proxy.run (); // until TERMINATE
+
+	  backend.close ();
+	  capture.close ();
+	  control.close ();
+	} };
+
+  //
+  // the worker
+  //
+  SocketAdaptorWithThread< ZMQ_REP > worker { theContext,
+	[] (SocketAdaptor<ZMQ_REP> & socket) {
+	  socket.connect ("inproc://backend");
+	  std::vector<std::string> lines;
+	  for (int i=1; i<=N; i++) {
+		socket.receiveText (lines);
+		socket.sendText ( { "reply to", lines[0] } );
+	  }
+	} };
+
+  //
+  // the tap, counting the captured frames
+  //
+  int captured = 0;
+  SocketAdaptorWithThread< ZMQ_PULL > tap { theContext,
+	[&captured] (SocketAdaptor<ZMQ_PULL> & socket) {
+	  socket.connect ("inproc://capture");
+	  std::vector<std::string> lines;
+	  // 2N messages: N requests and N replies
+	  while ( captured < 2*N && socket.receiveText (lines) ) {
+		captured++;
+	  }
+	} };
+
+  SocketAdaptor< ZMQ_REQ > client {theContext};
+  client.connect ("inproc://frontend");
+
+  SocketAdaptor< ZMQ_REQ > control {theContext};
+  control.connect ("inproc://control");
+
+  std::vector<std::string> lines;
+
+  //
+  // paused: the request waits in the proxy
+  //
+  control.sendText ( {"PAUSE"} );
+  control.receiveText (lines);
+
+  client.sendText ( {"1"} );
+  bool got = client.receiveTextInTimeout (lines, 300);
+  std::cout << " while paused, reply received? " << got << "\n";
+  assert ( ! got );
+
+  control.sendText ( {"RESUME"} );
+  control.receiveText (lines);
+
+  client.receiveText (lines);
+  showLines (" after resume", lines);
+
+  for (int i=2; i<=N; i++) {
+	client.sendText ( { std::to_string (i) } );
+	client.receiveText (lines);
+  }
+
+  control.sendText ( {"STATISTICS"} );
+  control.receiveText (lines);
+  showLines (" statistics", lines);
+
+  control.sendText ( {"TERMINATE"} );
+  control.receiveText (lines);
+
+  proxyThread.joinTheThread ();
+  worker.joinTheThread ();
+  tap.joinTheThread ();
+
+  std::cout << " captured messages: " << captured << "\n";
+  assert (captured == 2*N);
+
+  client.close ();
+  control.close ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
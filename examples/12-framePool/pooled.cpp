@@ -0,0 +1,90 @@
+// ---------------------------------------------------------------
+// pooled.cpp
+//
+//  PUSH -> PULL (inproc) of many middle sized messages:
+//  the sender builds its frames on pooled buffers,
+//  the receiver reuses pmr strings backed by the pool.
+//  Once the buffers in flight (bound by the HWM) are made,
+//  the pools stop calling malloc.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "../../zmqHelperFramePool.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int N = 200000;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  //
+  // receiver
+  //
+  SocketAdaptorWithThread< ZMQ_PULL > receiver { theContext,
+	[] (SocketAdaptor<ZMQ_PULL> & socket) {
+	  socket.bind ("inproc://pooled");
+
+	  FramePoolResource resource;
+	  std::pmr::vector<std::pmr::string> lines { &resource };
+
+	  unsigned long bytes = 0;
+	  unsigned long mallocsHalfWay = 0;
+
+	  for (int i=1; i<=N; i++) {
+		socket.receiveText (lines);
+		bytes += lines[1].size ();
+		if (i == N/2) {
+		  mallocsHalfWay = FramePool::forThisThread ().mallocCount ();
+		}
+	  }
+
+	  std::cout << " receiver: " << bytes << " bytes, pool mallocs: "
+				<< FramePool::forThisThread ().mallocCount ()
+				<< " (" << mallocsHalfWay << " half way)\n";
+	} };
+
+  //
+  // sender
+  //
+  SocketAdaptor< ZMQ_PUSH > sender {theContext};
+  sender.connect ("inproc://pooled");
+
+  std::vector<std::string> lines = { "header", std::string (700, 'x') };
+
+  auto start = std::chrono::steady_clock::now ();
+
+  unsigned long mallocsHalfWay = 0;
+  for (int i=1; i<=N; i++) {
+	sendTextPooled (sender, lines);
+	if (i == N/2) {
+	  mallocsHalfWay = FramePool::forThisThread ().mallocCount ();
+	}
+  }
+
+  receiver.joinTheThread ();
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+
+  FramePool & pool = FramePool::forThisThread ();
+
+  std::cout << " sender: " << N << " messages in " << elapsed << " ms,"
+			<< " pool mallocs: " << pool.mallocCount ()
+			<< " (" << mallocsHalfWay << " half way),"
+			<< " reuses: " << pool.reuseCount () << "\n";
+
+  sender.close ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,107 @@
+// ---------------------------------------------------------------
+// sessions.cpp
+//
+//  A ROUTER server keeping per client state, looked up by the
+//  raw bytes of the identity frame (no copy into a string key,
+//  no allocation per message).
+//
+//  REQ clients (one thread each) -> ROUTER server (main thread)
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+
+#include "../../zmqHelperIdentityMap.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int CLIENTS = 8;
+const int ROUNDS = 100;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+struct ClientState {
+  std::string name;
+  unsigned long requests = 0;
+};
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  SocketAdaptor< ZMQ_ROUTER > router {theContext};
+  router.bind ("inproc://sessions");
+
+  //
+  // clients: "HELLO name", ROUNDS x "COUNT", "BYE"
+  //
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REQ> > > clients;
+  for (int c=1; c<=CLIENTS; c++) {
+	std::string name = "client-" + std::to_string (c);
+	clients.emplace_back ( new SocketAdaptorWithThread<ZMQ_REQ> { theContext,
+	  [name] (SocketAdaptor<ZMQ_REQ> & socket) {
+		socket.connect ("inproc://sessions");
+		std::vector<std::string> lines;
+
+		socket.sendText ( {"HELLO", name} );
+		socket.receiveText (lines);
+
+		for (int i=1; i<=ROUNDS; i++) {
+		  socket.sendText ( {"COUNT"} );
+		  socket.receiveText (lines);
+		  assert (lines[0] == name && lines[1] == std::to_string (i));
+		}
+
+		socket.sendText ( {"BYE"} );
+		socket.receiveText (lines);
+	  } } );
+  } // for
+
+  //
+  // server
+  //
+  IdentityMap<ClientState> sessions;
+  RouterEnvelope env;
+  int goodbyes = 0;
+  unsigned long served = 0;
+
+  while ( goodbyes < CLIENTS && router.receiveEnvelope (env) ) {
+
+	ClientState & state = sessions.findOrInsert (env.identity);
+	std::string command = env.text (0);
+
+	if (command == "HELLO") {
+	  state.name = env.text (1);
+	  router.reply (env, {"WELCOME", state.name});
+	} else if (command == "COUNT") {
+	  state.requests++;
+	  router.reply (env, {state.name, std::to_string (state.requests)});
+	} else if (command == "BYE") {
+	  std::cout << " " << state.name << " leaves after "
+				<< state.requests << " requests \n";
+	  router.reply (env, {"BYE"});
+	  sessions.erase (env.identity);
+	  goodbyes++;
+	}
+	served++;
+  } // while
+
+  for (auto & c : clients) {
+	c->joinTheThread ();
+  }
+
+  std::cout << " served " << served << " requests,"
+			<< " sessions left: " << sessions.size () << "\n";
+
+  assert (sessions.size () == 0);
+
+  router.close ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,125 @@
+// ---------------------------------------------------------------
+// credits.cpp
+//
+//  Credit-based flow control:
+//
+//  DEALER client -> ROUTER [CreditBroker] ROUTER <- DEALER workers
+//
+//  The client sends a burst of requests. Each worker grants
+//  WINDOW credits, so it never has more than WINDOW requests
+//  in flight: the rest wait in the broker (and the slow worker
+//  does not get a long queue of its own).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "../../zmqHelperCredit.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int WORKERS = 3;
+const unsigned int WINDOW = 2;
+const int N = 300;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  SocketAdaptor< ZMQ_ROUTER > frontend {theContext};
+  SocketAdaptor< ZMQ_ROUTER > backend {theContext};
+  frontend.bind ("inproc://front");
+  backend.bind ("inproc://back");
+
+  std::atomic<bool> done {false};
+
+  //
+  // workers: the first one is slow
+  //
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_DEALER> > > workers;
+  for (int w=0; w<WORKERS; w++) {
+	workers.emplace_back ( new SocketAdaptorWithThread<ZMQ_DEALER> { theContext,
+	  [w, &done] (SocketAdaptor<ZMQ_DEALER> & socket) {
+		socket.connect ("inproc://back");
+
+		int delay = (w == 0) ? 20 : 1;
+		CreditWorker worker {socket, WINDOW};
+		worker.start ();
+
+		while ( ! done ) {
+		  worker.handleOne ( [w, delay] (const std::vector<std::string> & body) {
+			  std::this_thread::sleep_for (std::chrono::milliseconds (delay));
+			  return std::vector<std::string> { "done", body[0], std::to_string (w) };
+			}, 100 );
+		}
+	  } } );
+  } // for
+
+  //
+  // client: a burst of N requests, then the replies
+  //
+  std::vector<int> servedBy (WORKERS, 0);
+
+  SocketAdaptorWithThread< ZMQ_DEALER > client { theContext,
+	[&servedBy, &done] (SocketAdaptor<ZMQ_DEALER> & socket) {
+	  socket.connect ("inproc://front");
+
+	  for (int i=1; i<=N; i++) {
+		socket.sendText ( {"", std::to_string (i)} );
+	  }
+
+	  std::vector<std::string> lines;
+	  for (int i=1; i<=N; i++) {
+		socket.receiveText (lines);
+		assert (lines.size () == 4 && lines[1] == "done");
+		servedBy[ std::stoi (lines[3]) ]++;
+	  }
+	  done = true;
+	} };
+
+  //
+  // broker
+  //
+  CreditBroker broker {frontend, backend};
+
+  size_t maxQueued = 0;
+  long maxInFlight = 0;
+
+  while ( ! done ) {
+	broker.pollOnce (100);
+
+	maxQueued = std::max (maxQueued, broker.queuedCount ());
+	broker.forEachWorker ( [&maxInFlight] (const std::string &, long, long inFlight) {
+		maxInFlight = std::max (maxInFlight, inFlight);
+	  } );
+  } // while
+
+  client.joinTheThread ();
+  for (auto & w : workers) {
+	w->joinTheThread ();
+  }
+
+  std::cout << " dispatched: " << broker.dispatchedCount ()
+			<< " max queued in broker: " << maxQueued
+			<< " max in flight per worker: " << maxInFlight << "\n";
+  for (int w=0; w<WORKERS; w++) {
+	std::cout << " worker " << w << " served " << servedBy[w] << "\n";
+  }
+
+  assert (broker.dispatchedCount () == N);
+  assert (maxInFlight <= (long) WINDOW);
+  assert (servedBy[0] < servedBy[1]);
+
+  frontend.close ();
+  backend.close ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
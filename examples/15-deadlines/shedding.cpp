@@ -0,0 +1,153 @@
+// ---------------------------------------------------------------
+// shedding.cpp
+//
+//  Deadlines and load shedding under overload:
+//
+//  DEALER client -> ROUTER [CreditBroker] ROUTER <- DEALER workers
+//
+//  The client offers about twice the load the workers can take,
+//  first without deadlines (the queue grows and most replies come
+//  too late to be useful), then with a deadline header on every
+//  request (expired ones, or about to, are dropped and answered at
+//  once, and the replies got in time stay close to the capacity).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "../../zmqHelperCredit.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int WORKERS = 2;
+const int WORK_MS = 4;       // capacity: WORKERS * 1000 / WORK_MS per second
+const int N = 1000;          // requests, one per ms
+const long DEADLINE_MS = 50;
+
+// ---------------------------------------------------------------
+/// Offer N requests (one per ms) and get the replies.
+/// @return how many useful replies (got before the deadline)
+// ---------------------------------------------------------------
+int offerLoad (SocketAdaptor<ZMQ_DEALER> & socket, bool withDeadline, int & expired) {
+
+  std::vector<long long> sentAt (N, 0);
+  std::vector<std::string> lines;
+  int replies = 0;
+  int useful = 0;
+  expired = 0;
+
+  auto handleReply = [&] () {
+	replies++;
+	if ( lines[1] == EXPIRED_REPLY ) {
+	  expired++;
+	} else if ( nowMs () - sentAt[ std::stoi (lines[2]) ] <= DEADLINE_MS ) {
+	  useful++;
+	}
+  };
+
+  for (int i=0; i<N; i++) {
+	sentAt[i] = nowMs ();
+	if ( withDeadline ) {
+	  socket.sendText ( {"", deadlineHeader (DEADLINE_MS), std::to_string (i)} );
+	} else {
+	  socket.sendText ( {"", std::to_string (i)} );
+	}
+
+	// take the replies got meanwhile
+	while ( socket.receiveTextInTimeout (lines, 0) ) {
+	  handleReply ();
+	}
+	std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  }
+
+  while ( replies < N ) {
+	socket.receiveText (lines);
+	handleReply ();
+  }
+
+  return useful;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  SocketAdaptor< ZMQ_ROUTER > frontend {theContext};
+  SocketAdaptor< ZMQ_ROUTER > backend {theContext};
+  frontend.bind ("inproc://front");
+  backend.bind ("inproc://back");
+
+  std::atomic<bool> done {false};
+  std::atomic<unsigned long> shedByWorkers {0};
+
+  //
+  // workers
+  //
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_DEALER> > > workers;
+  for (int w=0; w<WORKERS; w++) {
+	workers.emplace_back ( new SocketAdaptorWithThread<ZMQ_DEALER> { theContext,
+	  [&done, &shedByWorkers] (SocketAdaptor<ZMQ_DEALER> & socket) {
+		socket.connect ("inproc://back");
+
+		CreditWorker worker {socket, 1};
+		worker.start ();
+
+		while ( ! done ) {
+		  worker.handleOne ( [] (const std::vector<std::string> & body) {
+			  std::this_thread::sleep_for (std::chrono::milliseconds (WORK_MS));
+			  return std::vector<std::string> { "done", body[0] };
+			}, 100 );
+		}
+		shedByWorkers += worker.shedCount ();
+	  } } );
+  } // for
+
+  //
+  // client
+  //
+  SocketAdaptorWithThread< ZMQ_DEALER > client { theContext,
+	[&done] (SocketAdaptor<ZMQ_DEALER> & socket) {
+	  socket.connect ("inproc://front");
+	  int expired = 0;
+
+	  int useful = offerLoad (socket, false, expired);
+	  std::cout << " without deadlines: " << useful << " useful replies of " << N << "\n";
+
+	  useful = offerLoad (socket, true, expired);
+	  std::cout << " with deadlines:    " << useful << " useful replies of " << N
+				<< " (" << expired << " expired)\n";
+
+	  assert (expired > 0);
+	  done = true;
+	} };
+
+  //
+  // broker
+  //
+  CreditBroker broker {frontend, backend};
+  broker.setShedMargin (2 * WORK_MS);
+  while ( ! done ) {
+	broker.pollOnce (100);
+  }
+
+  client.joinTheThread ();
+  for (auto & w : workers) {
+	w->joinTheThread ();
+  }
+
+  std::cout << " shed by the broker: " << broker.shedCount ()
+			<< " shed by the workers: " << shedByWorkers << "\n";
+
+  frontend.close ();
+  backend.close ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
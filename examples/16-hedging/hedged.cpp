@@ -0,0 +1,119 @@
+// ---------------------------------------------------------------
+// hedged.cpp
+//
+//  Hedged GETs to replicated key-value servers:
+//
+//  HedgingClient (a DEALER to each replica) -> REP replicas
+//
+//  Now and then, a replica takes much longer (a pause). The client
+//  makes the same GETs without hedging and with hedging, and
+//  compares the 99th percentile of the latencies.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+#include "../../zmqHelperHedging.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int REPLICAS = 3;
+const int N = 2000;
+const double SLOW_PROBABILITY = 0.02;
+const int SLOW_MS = 30;
+
+// ---------------------------------------------------------------
+/// Make N GETs. @return the 99th percentile of latency (us)
+// ---------------------------------------------------------------
+long getMany (HedgingClient & client) {
+  std::vector<long> latencies;
+  std::vector<std::string> reply;
+
+  for (int i=0; i<N; i++) {
+	std::string key = "key-" + std::to_string (i % 10);
+	auto start = std::chrono::steady_clock::now ();
+
+	bool got = client.request ( {"GET", key}, reply );
+
+	latencies.push_back ( std::chrono::duration_cast<std::chrono::microseconds>
+						  (std::chrono::steady_clock::now () - start).count () );
+	assert (got && reply[0] == "value-of-" + key);
+  }
+
+  std::sort (latencies.begin (), latencies.end ());
+  return latencies[ N * 99 / 100 ];
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+  std::atomic<bool> done {false};
+
+  //
+  // replicas
+  //
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REP> > > replicas;
+  for (int r=0; r<REPLICAS; r++) {
+	replicas.emplace_back ( new SocketAdaptorWithThread<ZMQ_REP> { theContext,
+	  [r, &done] (SocketAdaptor<ZMQ_REP> & socket) {
+		socket.bind ("inproc://replica-" + std::to_string (r));
+
+		std::mt19937 random (r);
+		std::uniform_real_distribution<double> uniform (0.0, 1.0);
+		std::vector<std::string> lines;
+
+		while ( ! done ) {
+		  if ( ! socket.receiveTextInTimeout (lines, 100) ) {
+			continue;
+		  }
+		  if ( uniform (random) < SLOW_PROBABILITY ) {
+			std::this_thread::sleep_for (std::chrono::milliseconds (SLOW_MS));
+		  }
+		  socket.sendText ( {"value-of-" + lines[1]} );
+		}
+	  } } );
+  } // for
+
+  //
+  // client
+  //
+  std::vector<std::string> urls;
+  for (int r=0; r<REPLICAS; r++) {
+	urls.push_back ("inproc://replica-" + std::to_string (r));
+  }
+  std::this_thread::sleep_for (std::chrono::milliseconds (100));
+
+  HedgingClient plain {theContext, urls, 0.95, 0.0}; // never hedges
+  long p99Plain = getMany (plain);
+
+  HedgingClient hedging {theContext, urls, 0.95, 0.05};
+  long p99Hedged = getMany (hedging);
+
+  std::cout << " p99 without hedging: " << p99Plain << " us\n"
+			<< " p99 with hedging:    " << p99Hedged << " us"
+			<< " (hedge delay " << hedging.hedgeDelay () << " ms,"
+			<< " hedge rate " << 100.0 * hedging.hedgeRate () << "%,"
+			<< " hedges won " << hedging.hedgeWinCount () << " of "
+			<< hedging.hedgeCount () << ")\n";
+
+  assert (plain.hedgeCount () == 0);
+  assert (hedging.hedgeRate () <= 0.05);
+  assert (p99Hedged < p99Plain);
+
+  done = true;
+  for (auto & r : replicas) {
+	r->joinTheThread ();
+  }
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,138 @@
+// ---------------------------------------------------------------
+// cached.cpp
+//
+//   REQ clients -> [ROUTER  Proxy + ResponseCache  DEALER] -> REP workers
+//
+//  Many clients asking for the same few keys at the same time:
+//  the first one of each goes to a worker, the others wait for its
+//  reply (coalesced) and later ones are answered by the broker (hits).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "../../zmqHelperCache.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int WORKERS = 2;
+const int CLIENTS = 20;
+const int ROUNDS = 50;
+const int KEYS = 5;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  ResponseCache cache {64, 1024*1024, 2000};
+
+  //
+  // the broker, in its own thread (which owns its sockets)
+  //
+  SocketAdaptorWithThread< ZMQ_ROUTER > broker { theContext,
+	[&theContext, &cache] (SocketAdaptor<ZMQ_ROUTER> & frontend) {
+	  SocketAdaptor< ZMQ_DEALER > backend {theContext};
+	  SocketAdaptor< ZMQ_REP > control {theContext};
+
+	  frontend.bind ("inproc://frontend");
+	  backend.bind ("inproc://backend");
+	  control.bind ("inproc://control");
+
+	  Proxy< ZMQ_ROUTER, ZMQ_DEALER > proxy {frontend, backend};
+	  proxy.setControl (control);
+	  proxy.addStage (cache);
+
+	  proxy.run (); // until TERMINATE
+
+	  backend.close ();
+	  control.close ();
+	} };
+
+  //
+  // workers (slow lookups)
+  //
+  std::atomic<bool> done {false};
+  std::atomic<int> backendCalls {0};
+
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REP> > > workers;
+  for (int w=0; w<WORKERS; w++) {
+	workers.emplace_back ( new SocketAdaptorWithThread<ZMQ_REP> { theContext,
+	  [&done, &backendCalls] (SocketAdaptor<ZMQ_REP> & socket) {
+		socket.connect ("inproc://backend");
+		std::vector<std::string> lines;
+		while ( ! done ) {
+		  if ( ! socket.receiveTextInTimeout (lines, 100) ) {
+			continue;
+		  }
+		  backendCalls++;
+		  std::this_thread::sleep_for (std::chrono::milliseconds (5));
+		  socket.sendText ( {"value-of-" + lines[1]} );
+		}
+	  } } );
+  } // for
+
+  //
+  // clients: cacheable GETs, and now and then one not cacheable
+  //
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REQ> > > clients;
+  for (int c=0; c<CLIENTS; c++) {
+	clients.emplace_back ( new SocketAdaptorWithThread<ZMQ_REQ> { theContext,
+	  [] (SocketAdaptor<ZMQ_REQ> & socket) {
+		socket.connect ("inproc://frontend");
+		std::vector<std::string> lines;
+		for (int i=0; i<ROUNDS; i++) {
+		  std::string key = "key-" + std::to_string (i % KEYS);
+		  if ( i % 10 == 9 ) {
+			socket.sendText ( {"GET", key} );
+		  } else {
+			socket.sendText ( {cacheHeader (), "GET", key} );
+		  }
+		  socket.receiveText (lines);
+		  assert (lines.size () == 1 && lines[0] == "value-of-" + key);
+		}
+	  } } );
+  } // for
+
+  for (auto & c : clients) {
+	c->joinTheThread ();
+  }
+
+  SocketAdaptor< ZMQ_REQ > control {theContext};
+  control.connect ("inproc://control");
+  std::vector<std::string> lines;
+  control.sendText ( {"TERMINATE"} );
+  control.receiveText (lines);
+
+  broker.joinTheThread ();
+  done = true;
+  for (auto & w : workers) {
+	w->joinTheThread ();
+  }
+
+  const int requests = CLIENTS * ROUNDS;
+  const int notCacheable = CLIENTS * (ROUNDS / 10);
+
+  std::cout << " requests: " << requests << " (" << notCacheable << " not cacheable)"
+			<< " backend calls: " << backendCalls << "\n"
+			<< " hits: " << cache.hitCount ()
+			<< " misses: " << cache.missCount ()
+			<< " coalesced: " << cache.coalescedCount ()
+			<< " entries: " << cache.size ()
+			<< " bytes: " << cache.byteCount () << "\n";
+
+  assert (cache.hitCount () + cache.missCount () + cache.coalescedCount ()
+		  == (unsigned long) (requests - notCacheable));
+  assert (backendCalls == (int) cache.missCount () + notCacheable);
+
+  control.close ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,175 @@
+// ---------------------------------------------------------------
+// limited.cpp
+//
+//   clients -> [ROUTER  Proxy + RateLimitStage  DEALER] -> REP workers
+//
+//  A noisy client floods the broker while some quiet ones make
+//  a request every few ms. Without the limiter, the quiet ones
+//  wait behind the flood; with it, the noisy client gets its
+//  share (and RATE_LIMITED replies) and the quiet ones do not notice.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "../../zmqHelperRateLimit.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int WORKERS = 2;
+const int QUIET = 4;
+const int QUIET_REQUESTS = 50;
+const int NOISY_REQUESTS = 2000;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+long long usSince (std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::microseconds>
+	(std::chrono::steady_clock::now () - t).count ();
+}
+
+// ---------------------------------------------------------------
+/// Run the clients against a broker with (or without) limiter.
+// ---------------------------------------------------------------
+void scenario (zmq::context_t & theContext, bool limit) {
+
+  std::string tag = limit ? "-limited" : "-open";
+  std::string front = "inproc://front" + tag;
+  std::string back = "inproc://back" + tag;
+  std::string controlUrl = "inproc://control" + tag;
+
+  RateLimiter limiter {200, 10, 50}; // 200/s, bursts of 10, wait up to 50ms
+  RateLimitStage stage {limiter};
+
+  SocketAdaptorWithThread< ZMQ_ROUTER > broker { theContext,
+	[&] (SocketAdaptor<ZMQ_ROUTER> & frontend) {
+	  SocketAdaptor< ZMQ_DEALER > backend {theContext};
+	  SocketAdaptor< ZMQ_REP > control {theContext};
+	  frontend.bind (front);
+	  backend.bind (back);
+	  control.bind (controlUrl);
+
+	  Proxy< ZMQ_ROUTER, ZMQ_DEALER > proxy {frontend, backend};
+	  proxy.setControl (control);
+	  if ( limit ) {
+		proxy.addStage (stage);
+	  }
+	  proxy.run ();
+
+	  backend.close ();
+	  control.close ();
+	} };
+
+  std::atomic<bool> done {false};
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REP> > > workers;
+  for (int w=0; w<WORKERS; w++) {
+	workers.emplace_back ( new SocketAdaptorWithThread<ZMQ_REP> { theContext,
+	  [&] (SocketAdaptor<ZMQ_REP> & socket) {
+		socket.connect (back);
+		std::vector<std::string> lines;
+		while ( ! done ) {
+		  if ( socket.receiveTextInTimeout (lines, 100) ) {
+			std::this_thread::sleep_for (std::chrono::milliseconds (1));
+			socket.sendText ( {"done"} );
+		  }
+		}
+	  } } );
+  } // for
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  //
+  // the noisy client: all its requests at once
+  //
+  int noisyServed = 0;
+  int noisyLimited = 0;
+  SocketAdaptorWithThread< ZMQ_DEALER > noisy { theContext,
+	[&] (SocketAdaptor<ZMQ_DEALER> & socket) {
+	  socket.connect (front);
+	  std::vector<std::string> lines;
+	  for (int i=0; i<NOISY_REQUESTS; i++) {
+		socket.sendText ( {"", "noise"} );
+	  }
+	  for (int i=0; i<NOISY_REQUESTS; i++) {
+		socket.receiveText (lines);
+		(lines[1] == RATE_LIMITED_REPLY ? noisyLimited : noisyServed)++;
+	  }
+	} };
+
+  //
+  // the quiet clients
+  //
+  std::vector<long long> latencies;
+  std::mutex latenciesMutex;
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REQ> > > quiet;
+  for (int q=0; q<QUIET; q++) {
+	quiet.emplace_back ( new SocketAdaptorWithThread<ZMQ_REQ> { theContext,
+	  [&] (SocketAdaptor<ZMQ_REQ> & socket) {
+		socket.connect (front);
+		std::vector<std::string> lines;
+		for (int i=0; i<QUIET_REQUESTS; i++) {
+		  auto start = std::chrono::steady_clock::now ();
+		  socket.sendText ( {"hello"} );
+		  socket.receiveText (lines);
+		  long long us = usSince (start);
+		  assert (lines[0] == "done");
+		  {
+			std::lock_guard<std::mutex> lock {latenciesMutex};
+			latencies.push_back (us);
+		  }
+		  std::this_thread::sleep_for (std::chrono::milliseconds (10));
+		}
+	  } } );
+  } // for
+
+  for (auto & q : quiet) {
+	q->joinTheThread ();
+  }
+  noisy.joinTheThread ();
+
+  SocketAdaptor< ZMQ_REQ > control {theContext};
+  control.connect (controlUrl);
+  std::vector<std::string> lines;
+  control.sendText ( {"TERMINATE"} );
+  control.receiveText (lines);
+  control.close ();
+
+  broker.joinTheThread ();
+  done = true;
+  for (auto & w : workers) {
+	w->joinTheThread ();
+  }
+
+  std::sort (latencies.begin (), latencies.end ());
+  std::cout << (limit ? " with limiter:    " : " without limiter: ")
+			<< " quiet clients p99 " << latencies[latencies.size () * 99 / 100] << " us,"
+			<< " noisy served " << noisyServed << " limited " << noisyLimited << "\n";
+
+  if ( limit ) {
+	std::cout << "   limiter: admitted " << limiter.admittedCount ()
+			  << " delayed " << limiter.delayedCount ()
+			  << " rejected " << limiter.rejectedCount ()
+			  << " clients " << limiter.clientCount () << "\n";
+	assert (noisyLimited > 0);
+	assert (limiter.rejectedCount () == (unsigned long) noisyLimited);
+  }
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  scenario (theContext, false);
+  scenario (theContext, true);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
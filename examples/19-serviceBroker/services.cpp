@@ -0,0 +1,172 @@
+// ---------------------------------------------------------------
+// services.cpp
+//
+//  REQ clients -> ROUTER [ServiceBroker] ROUTER <- DEALER workers
+//
+//  Two services behind one endpoint: "slow" (50ms a request) and
+//  "fast" (1ms). The slow one is saturated, but the fast one has
+//  its own ready queue, so its clients do not wait behind it.
+//  A worker leaving without saying so is evicted (heartbeats).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+
+#include "../../zmqHelperServiceBroker.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const long HEARTBEAT_MS = 100;
+
+const int SLOW_CLIENTS = 6;
+const int SLOW_REQUESTS = 5;
+const int FAST_CLIENTS = 2;
+const int FAST_REQUESTS = 100;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+struct Latencies {
+  std::mutex mutex;
+  std::vector<long long> us;
+
+  void add (long long v) {
+	std::lock_guard<std::mutex> lock {mutex};
+	us.push_back (v);
+  }
+
+  long long percentile (double p) {
+	std::sort (us.begin (), us.end ());
+	return us[ std::min (us.size () - 1, size_t (p * us.size ())) ];
+  }
+};
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  SocketAdaptor< ZMQ_ROUTER > frontend {theContext};
+  SocketAdaptor< ZMQ_ROUTER > backend {theContext};
+  frontend.bind ("inproc://services");
+  backend.bind ("inproc://workers");
+
+  ServiceBroker broker {frontend, backend, HEARTBEAT_MS};
+
+  //
+  // a worker which registers and goes away silently
+  //
+  SocketAdaptorWithThread< ZMQ_DEALER > doomed { theContext,
+	[] (SocketAdaptor<ZMQ_DEALER> & socket) {
+	  socket.connect ("inproc://workers");
+	  ServiceWorker worker {socket, {"fast"}, HEARTBEAT_MS};
+	  worker.start ();
+	  socket.close ();
+	} };
+  doomed.joinTheThread ();
+
+  auto until = std::chrono::steady_clock::now () + std::chrono::milliseconds (5 * HEARTBEAT_MS);
+  while ( std::chrono::steady_clock::now () < until ) {
+	broker.pollOnce (HEARTBEAT_MS);
+  }
+  std::cout << " silent worker evicted: " << broker.evictedCount ()
+			<< " workers now: " << broker.workerCount () << "\n";
+  assert (broker.evictedCount () == 1 && broker.workerCount () == 0);
+
+  //
+  // workers: 2 slow, 2 fast, 1 for both
+  //
+  std::atomic<bool> done {false};
+  std::vector< std::vector<std::string> > roles = {
+	{"slow"}, {"slow"}, {"fast"}, {"fast"}, {"fast", "slow"} };
+
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_DEALER> > > workers;
+  for (auto & services : roles) {
+	workers.emplace_back ( new SocketAdaptorWithThread<ZMQ_DEALER> { theContext,
+	  [services, &done] (SocketAdaptor<ZMQ_DEALER> & socket) {
+		socket.connect ("inproc://workers");
+		ServiceWorker worker {socket, services, HEARTBEAT_MS};
+		worker.start ();
+		while ( ! done ) {
+		  worker.handleOne ( [] (const std::string & service,
+								 const std::vector<std::string> & body) {
+			  int ms = (service == "slow") ? 50 : 1;
+			  std::this_thread::sleep_for (std::chrono::milliseconds (ms));
+			  return std::vector<std::string> { service, body[0] };
+			}, 100 );
+		}
+		worker.stop ();
+	  } } );
+  } // for
+
+  //
+  // clients
+  //
+  Latencies fast, slow;
+  std::atomic<int> clientsDone {0};
+
+  auto client = [&] (const std::string & service, int requests, Latencies & latencies) {
+	return [&, service, requests] (SocketAdaptor<ZMQ_REQ> & socket) {
+	  socket.connect ("inproc://services");
+	  std::vector<std::string> lines;
+	  for (int i=0; i<requests; i++) {
+		auto start = std::chrono::steady_clock::now ();
+		socket.sendText ( {service, std::to_string (i)} );
+		socket.receiveText (lines);
+		latencies.add ( std::chrono::duration_cast<std::chrono::microseconds>
+						(std::chrono::steady_clock::now () - start).count () );
+		assert (lines.size () == 2 && lines[0] == service && lines[1] == std::to_string (i));
+	  }
+	  clientsDone++;
+	};
+  };
+
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REQ> > > clients;
+  for (int c=0; c<SLOW_CLIENTS; c++) {
+	clients.emplace_back ( new SocketAdaptorWithThread<ZMQ_REQ> { theContext,
+		client ("slow", SLOW_REQUESTS, slow) } );
+  }
+  for (int c=0; c<FAST_CLIENTS; c++) {
+	clients.emplace_back ( new SocketAdaptorWithThread<ZMQ_REQ> { theContext,
+		client ("fast", FAST_REQUESTS, fast) } );
+  }
+
+  //
+  // broker
+  //
+  while ( clientsDone < (int) clients.size () ) {
+	broker.pollOnce (HEARTBEAT_MS);
+  }
+
+  done = true;
+  for (auto & c : clients) {
+	c->joinTheThread ();
+  }
+  // let the workers say goodbye
+  while ( broker.workerCount () > 0 ) {
+	broker.pollOnce (HEARTBEAT_MS);
+  }
+  for (auto & w : workers) {
+	w->joinTheThread ();
+  }
+
+  std::cout << " requests: fast " << broker.requestCount ("fast")
+			<< " slow " << broker.requestCount ("slow") << "\n"
+			<< " fast p99: " << fast.percentile (0.99) << " us,"
+			<< " slow p99: " << slow.percentile (0.99) << " us\n";
+
+  assert (fast.percentile (0.99) < slow.percentile (0.5));
+
+  frontend.close ();
+  backend.close ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,138 @@
+// ---------------------------------------------------------------
+// ordered.cpp
+//
+//   DEALER client -> [ROUTER  Proxy + ReorderStage  DEALER] -> REP workers
+//
+//  A stream of numbered requests goes through a pool of workers
+//  taking random times. Without the stage the replies come back
+//  out of order; with it, in order (and at most CAPACITY of them
+//  in flight).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+#include "../../zmqHelperReorder.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int WORKERS = 4;
+const int N = 2000;
+const size_t CAPACITY = 64;
+
+// ---------------------------------------------------------------
+/// Stream N requests through a broker (with or without the stage).
+/// @return replies got out of order
+// ---------------------------------------------------------------
+int stream (zmq::context_t & theContext, bool ordered) {
+
+  std::string tag = ordered ? "-ordered" : "-plain";
+  std::string front = "inproc://front" + tag;
+  std::string back = "inproc://back" + tag;
+  std::string controlUrl = "inproc://control" + tag;
+
+  ReorderStage reorder {CAPACITY};
+
+  SocketAdaptorWithThread< ZMQ_ROUTER > broker { theContext,
+	[&] (SocketAdaptor<ZMQ_ROUTER> & frontend) {
+	  SocketAdaptor< ZMQ_DEALER > backend {theContext};
+	  SocketAdaptor< ZMQ_REP > control {theContext};
+	  frontend.bind (front);
+	  backend.bind (back);
+	  control.bind (controlUrl);
+
+	  Proxy< ZMQ_ROUTER, ZMQ_DEALER > proxy {frontend, backend};
+	  proxy.setControl (control);
+	  if ( ordered ) {
+		proxy.addStage (reorder);
+	  }
+	  proxy.run ();
+
+	  backend.close ();
+	  control.close ();
+	} };
+
+  std::atomic<bool> done {false};
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REP> > > workers;
+  for (int w=0; w<WORKERS; w++) {
+	workers.emplace_back ( new SocketAdaptorWithThread<ZMQ_REP> { theContext,
+	  [&, w] (SocketAdaptor<ZMQ_REP> & socket) {
+		socket.connect (back);
+		std::mt19937 random (w);
+		std::uniform_int_distribution<int> micros (0, 2000);
+		std::vector<std::string> lines;
+		while ( ! done ) {
+		  if ( socket.receiveTextInTimeout (lines, 100) ) {
+			std::this_thread::sleep_for (std::chrono::microseconds (micros (random)));
+			socket.sendText ( {"result", lines[0]} );
+		  }
+		}
+	  } } );
+  } // for
+
+  //
+  // the client: the whole stream at once, then the results
+  //
+  SocketAdaptor< ZMQ_DEALER > client {theContext};
+  client.connect (front);
+
+  for (int i=0; i<N; i++) {
+	client.sendText ( {"", std::to_string (i)} );
+  }
+
+  int outOfOrder = 0;
+  int expected = 0;
+  std::vector<std::string> lines;
+  for (int i=0; i<N; i++) {
+	client.receiveText (lines);
+	int got = std::stoi (lines[2]);
+	if ( got != expected ) {
+	  outOfOrder++;
+	}
+	expected = got + 1;
+  }
+  client.close ();
+
+  SocketAdaptor< ZMQ_REQ > control {theContext};
+  control.connect (controlUrl);
+  control.sendText ( {"TERMINATE"} );
+  control.receiveText (lines);
+  control.close ();
+
+  broker.joinTheThread ();
+  done = true;
+  for (auto & w : workers) {
+	w->joinTheThread ();
+  }
+
+  std::cout << (ordered ? " with reorder stage: " : " without it:         ")
+			<< outOfOrder << " replies out of order";
+  if ( ordered ) {
+	std::cout << " (" << reorder.reorderedCount () << " reordered,"
+			  << " up to " << reorder.maxHeldCount () << " requests held back)";
+  }
+  std::cout << "\n";
+
+  return outOfOrder;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  stream (theContext, false);
+  int outOfOrder = stream (theContext, true);
+
+  assert (outOfOrder == 0);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,139 @@
+// ---------------------------------------------------------------
+// shards.cpp
+//
+//  A word count split in SHARDS REP servers. A query asks every
+//  shard and adds the counts:
+//
+//  - one after another (REQ): the sum of the latencies
+//  - scatterGather (): the latency of the slowest shard
+//  - scatterGather () with a shard too slow: a partial result
+//    within the timeout, saying which shard did not answer.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "../../zmqHelperScatterGather.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int SHARDS = 8;
+const int WORK_MS = 20;
+const int SLOW_MS = 300;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+long msSince (std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - t).count ();
+}
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+  std::atomic<bool> done {false};
+
+  //
+  // shards: shard s counts s+1 times each word;
+  // the last one is slow for "slow" words
+  //
+  std::vector<std::string> urls;
+  std::vector< std::unique_ptr< SocketAdaptorWithThread<ZMQ_REP> > > shards;
+  for (int s=0; s<SHARDS; s++) {
+	urls.push_back ("inproc://shard-" + std::to_string (s));
+	shards.emplace_back ( new SocketAdaptorWithThread<ZMQ_REP> { theContext,
+	  [s, &done] (SocketAdaptor<ZMQ_REP> & socket) {
+		socket.bind ("inproc://shard-" + std::to_string (s));
+		std::vector<std::string> lines;
+		while ( ! done ) {
+		  if ( ! socket.receiveTextInTimeout (lines, 100) ) {
+			continue;
+		  }
+		  bool slow = (s == SHARDS-1) && lines[1].find ("slow") == 0;
+		  std::this_thread::sleep_for (std::chrono::milliseconds (slow ? SLOW_MS : WORK_MS));
+		  socket.sendText ( { std::to_string (s+1) } );
+		}
+	  } } );
+  } // for
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+
+  const long expected = SHARDS * (SHARDS + 1) / 2;
+  auto sum = [] (long & total, size_t, const std::vector<std::string> & reply) {
+	total += std::stol (reply[0]);
+  };
+
+  //
+  // one after another
+  //
+  {
+	auto start = std::chrono::steady_clock::now ();
+	long total = 0;
+	std::vector<std::string> lines;
+	for (auto & url : urls) {
+	  SocketAdaptor< ZMQ_REQ > req {theContext};
+	  req.connect (url);
+	  req.sendText ( {"COUNT", "foo"} );
+	  req.receiveText (lines);
+	  total += std::stol (lines[0]);
+	  req.close ();
+	}
+	std::cout << " one after another: total " << total << " in " << msSince (start) << " ms\n";
+	assert (total == expected);
+  }
+
+  ScatterGather all {theContext, urls};
+
+  //
+  // scatter-gather
+  //
+  {
+	auto start = std::chrono::steady_clock::now ();
+	auto result = all.scatterGather<long> ( {"COUNT", "foo"}, 1000, 0, sum );
+	std::cout << " scatter-gather:    total " << result.value << " in " << msSince (start) << " ms\n";
+	assert (result.complete && result.value == expected);
+  }
+
+  //
+  // scatter-gather, a shard too slow
+  //
+  {
+	auto start = std::chrono::steady_clock::now ();
+	auto result = all.scatterGather<long> ( {"COUNT", "slowpoke"}, 100, 0, sum );
+	std::cout << " with a slow shard: total " << result.value << " in " << msSince (start) << " ms"
+			  << " (" << result.replied << " of " << SHARDS << " replied; timed out:";
+	for (int s=0; s<SHARDS; s++) {
+	  if ( result.status[s] == PeerStatus::TIMED_OUT ) {
+		std::cout << " shard-" << s;
+	  }
+	}
+	std::cout << ")\n";
+	assert ( ! result.complete && result.status[SHARDS-1] == PeerStatus::TIMED_OUT );
+	assert (result.value == expected - SHARDS);
+  }
+
+  //
+  // the late reply of the slow shard is ignored
+  //
+  {
+	auto result = all.scatterGather<long> ( {"COUNT", "foo"}, 1000, 0, sum );
+	assert (result.complete && result.value == expected);
+	std::cout << " next query: total " << result.value
+			  << " (late replies ignored: " << all.lateReplyCount () << ")\n";
+  }
+
+  done = true;
+  for (auto & s : shards) {
+	s->joinTheThread ();
+  }
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
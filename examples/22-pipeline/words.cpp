@@ -0,0 +1,112 @@
+// ---------------------------------------------------------------
+// words.cpp
+//
+//  A Pipeline of three stages counting the words of "lines":
+//
+//    main (ventilator) -> split (2) -> score (4) -> format (1) -> sink
+//
+//  "score" is the slow one: stats() shows it (busy near 1)
+//  while the others wait. Two jobs are submitted and waited
+//  for separately; every item of a job reaches the sink.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sstream>
+
+#include "../../zmqHelperPipeline.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int LINES_PER_JOB = 400;
+const int WORK_US = 500; // the "score" stage per item
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  Pipeline pipe {theContext, "inproc://words", 100};
+
+  // line -> its words
+  pipe.addStage ("split", 2, [] (std::vector<std::string> & item) {
+	  std::istringstream in {item[0]};
+	  std::vector<std::string> words;
+	  std::string w;
+	  while ( in >> w ) {
+		words.push_back (w);
+	  }
+	  item.swap (words);
+	  return ! item.empty (); // empty lines are dropped
+	});
+
+  // words -> their count (pretends to be expensive)
+  pipe.addStage ("score", 4, [] (std::vector<std::string> & item) {
+	  std::this_thread::sleep_for (std::chrono::microseconds (WORK_US));
+	  item.assign ( {std::to_string (item.size ())} );
+	  return true;
+	});
+
+  // count -> "count=n"
+  pipe.addStage ("format", 1, [] (std::vector<std::string> & item) {
+	  item[0] = "count=" + item[0];
+	  return true;
+	});
+
+  // (the sink thread only)
+  std::map<unsigned long, unsigned long> words;
+  pipe.setSink ( [&words] (unsigned long job, const std::vector<std::string> & item) {
+	  words[job] += std::stoul (item[0].substr (6));
+	});
+
+  pipe.start ();
+
+  //
+  // jobs: lines of 1..5 words, every 10th line empty
+  //
+  std::vector< std::vector<std::string> > items;
+  unsigned long expected = 0;
+  for (int i=0; i<LINES_PER_JOB; i++) {
+	std::string line;
+	if ( i % 10 != 9 ) {
+	  for (int w=0; w<=i%5; w++) {
+		line += "word ";
+	  }
+	  expected += i%5 + 1;
+	}
+	items.push_back ( {line} );
+  }
+
+  auto start = std::chrono::steady_clock::now ();
+
+  auto first = pipe.submit (items);
+  auto second = pipe.submit (items);
+
+  bool done = pipe.waitJob (first, 10000) && pipe.waitJob (second, 10000);
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+
+  assert (done);
+
+  std::cout << " 2 jobs of " << LINES_PER_JOB << " lines in " << elapsed << " ms,"
+			<< " words: " << words[first] << " + " << words[second] << "\n";
+
+  for (auto & st : pipe.stats ()) {
+	std::cout << "   " << st.name << " (" << st.workers << " workers): "
+			  << st.items << " items, " << (long) st.itemsPerSecond << " items/s,"
+			  << " busy " << (int) (st.busy * 100) << "%\n";
+  }
+
+  pipe.stop ();
+
+  assert (words[first] == expected && words[second] == expected);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
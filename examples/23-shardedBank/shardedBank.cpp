@@ -0,0 +1,283 @@
+// ---------------------------------------------------------------
+// shardedBank.cpp
+//
+//  The bank of 05-inproc-bankThreads serves everybody from one
+//  REP thread, one request at a time. Here the accounts are
+//  hashed onto N shards: each shard thread owns its accounts
+//  (no locks) behind a ROUTER (inproc), and commits the "put"s
+//  waiting in its queue as a group (one journal flush per batch,
+//  not per transaction).
+//
+//  TELLERS threads (each one a DEALER to every shard) play
+//  PERSONS persons, with up to WINDOW transactions in flight,
+//  sending each one to the shard of its account.
+//
+//  Reports transactions/s with 1 shard without group commit,
+//  then with group commit from 1 shard up to the cores.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <future>
+#include <atomic>
+
+#include "../../zmqHelperIdentityMap.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int PERSONS = 5000;
+const int TELLERS = 8;
+const int WINDOW = 32;            // transactions in flight per teller
+const int COMMIT_US = 200;        // a journal flush (per batch)
+const int MAX_BATCH = 256;
+const long RUN_MS = 1000;
+
+// (one per core; hardware_concurrency () may be 0: unknown)
+const unsigned int MAX_SHARDS = std::max (1u, std::thread::hardware_concurrency ());
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+std::string shardUrl (unsigned int i) {
+  return "inproc://bank-shard-" + std::to_string (i);
+}
+
+unsigned int shardOf (const std::string & account, unsigned int shards) {
+  return hashBytes (account.data (), account.size ()) % shards;
+}
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+class Shard {
+
+private:
+
+  zmq::context_t & theContext;
+  const unsigned int index;
+  const int maxBatch;
+
+  IdentityMap<long> accounts {PERSONS}; // balance in cents
+
+  std::atomic<bool> running {true};
+  std::promise<void> bound;
+  std::thread * theThread = nullptr;
+
+  unsigned long transactions = 0;
+  unsigned long batches = 0;
+
+  // .............................................................
+  // .............................................................
+  void main_Shard () {
+	SocketAdaptor<ZMQ_ROUTER> socket {theContext};
+	socket.bind (shardUrl (index));
+	bound.set_value ();
+
+	// batch[k]: identity, account, op, amount
+	std::vector< std::vector<std::string> > batch (maxBatch);
+	std::vector<std::string> reply (3);
+
+	while ( running ) {
+	  if ( ! socket.receiveTextInTimeout (batch[0], 100) ) {
+		continue;
+	  }
+
+	  // group: whatever else is already waiting
+	  int n = 1;
+	  while ( n < maxBatch && socket.receiveTextInTimeout (batch[n], 0) ) {
+		n++;
+	  }
+
+	  for (int k=0; k<n; k++) {
+		long & balance = accounts.findOrInsert (batch[k][1]);
+		if ( batch[k][2] == "put" ) {
+		  balance += std::stol (batch[k][3]);
+		}
+	  }
+
+	  // commit: one flush for the whole batch
+	  std::this_thread::sleep_for (std::chrono::microseconds (COMMIT_US));
+	  batches++;
+	  transactions += n;
+
+	  for (int k=0; k<n; k++) {
+		reply[0] = batch[k][0];
+		reply[1] = "OK";
+		reply[2] = std::to_string (* accounts.find (batch[k][1].data (), batch[k][1].size ()));
+		socket.sendText (reply);
+	  }
+	} // while
+
+	socket.close ();
+  }
+
+public:
+
+  // .............................................................
+  // .............................................................
+  Shard (zmq::context_t & aContext, unsigned int index_, int maxBatch_)
+	: theContext {aContext}, index {index_}, maxBatch {maxBatch_}
+  {
+	theThread = new std::thread (&Shard::main_Shard, this);
+	bound.get_future ().wait ();
+  }
+
+  // .............................................................
+  // .............................................................
+  void stop () {
+	if ( theThread == nullptr ) {
+	  return;
+	}
+	running = false;
+	theThread->join ();
+	delete theThread;
+	theThread = nullptr;
+  }
+
+  ~Shard () {
+	stop ();
+  }
+
+  // .............................................................
+  /// (after stop)
+  // .............................................................
+  long total () {
+	long sum = 0;
+	accounts.forEach ( [&sum] (const std::string &, long & balance) { sum += balance; } );
+	return sum;
+  }
+
+  unsigned long transactionCount () const { return transactions; }
+  unsigned long batchCount () const { return batches; }
+
+}; // class
+
+// ---------------------------------------------------------------
+/// A teller: "put"s for random persons, each one to the shard
+/// of the account, WINDOW at most in flight, during RUN_MS.
+/// @return cents put
+// ---------------------------------------------------------------
+long teller (zmq::context_t & theContext, unsigned int shards, unsigned int seed) {
+
+  std::vector< std::unique_ptr< SocketAdaptor<ZMQ_DEALER> > > sockets;
+  std::vector<zmq::pollitem_t> items;
+  for (unsigned int s=0; s<shards; s++) {
+	sockets.emplace_back ( new SocketAdaptor<ZMQ_DEALER> {theContext} );
+	sockets.back()->connect (shardUrl (s));
+	items.push_back ( { * sockets.back()->getZmqSocket (), 0, ZMQ_POLLIN, 0 } );
+  }
+
+  std::mt19937 random {seed};
+  std::uniform_int_distribution<int> person {1, PERSONS};
+  std::uniform_int_distribution<int> cents {1, 100};
+
+  auto end = std::chrono::steady_clock::now () + std::chrono::milliseconds (RUN_MS);
+  std::vector<std::string> request (3);
+  std::vector<std::string> lines;
+  long put = 0;
+  int inFlight = 0;
+
+  while ( true ) {
+	bool sending = std::chrono::steady_clock::now () < end;
+	while ( sending && inFlight < WINDOW ) {
+	  int amount = cents (random);
+	  request[0] = "person-" + std::to_string (person (random));
+	  request[1] = "put";
+	  request[2] = std::to_string (amount);
+	  sockets[shardOf (request[0], shards)]->sendText (request);
+	  put += amount;
+	  inFlight++;
+	}
+
+	if ( ! sending && inFlight == 0 ) {
+	  break;
+	}
+
+	zmq::poll (items.data (), items.size (), 100);
+	for (unsigned int s=0; s<shards; s++) {
+	  if ( items[s].revents & ZMQ_POLLIN ) {
+		while ( sockets[s]->receiveTextInTimeout (lines, 0) ) {
+		  assert (lines[0] == "OK");
+		  inFlight--;
+		}
+	  }
+	}
+  } // while
+
+  for (auto & s : sockets) {
+	s->close ();
+  }
+  return put;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+void run (zmq::context_t & theContext, unsigned int shards, int maxBatch) {
+
+  std::vector< std::unique_ptr<Shard> > theShards;
+  for (unsigned int s=0; s<shards; s++) {
+	theShards.emplace_back ( new Shard {theContext, s, maxBatch} );
+  }
+
+  auto start = std::chrono::steady_clock::now ();
+
+  std::vector< std::future<long> > tellers;
+  for (int t=0; t<TELLERS; t++) {
+	tellers.push_back ( std::async (std::launch::async, teller,
+									std::ref (theContext), shards, t + 1) );
+  }
+
+  long put = 0;
+  for (auto & t : tellers) {
+	put += t.get ();
+  }
+
+  double seconds = std::chrono::duration<double>
+	(std::chrono::steady_clock::now () - start).count ();
+
+  long total = 0;
+  unsigned long transactions = 0;
+  unsigned long batches = 0;
+  for (auto & s : theShards) {
+	s->stop ();
+	total += s->total ();
+	transactions += s->transactionCount ();
+	batches += s->batchCount ();
+  }
+
+  // every cent put is in some account
+  assert (total == put);
+
+  std::cout << "   " << shards << " shard(s), batch <= " << maxBatch << ": "
+			<< (long) (transactions / seconds) << " tx/s,"
+			<< " mean batch " << (batches ? transactions / batches : 0) << "\n";
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  std::cout << " " << PERSONS << " persons, " << TELLERS << " tellers,"
+			<< " commit " << COMMIT_US << " us\n";
+
+  std::cout << " no group commit:\n";
+  run (theContext, 1, 1);
+
+  std::cout << " group commit:\n";
+  // 1, 2, 4 ... and the number of cores (if not a power of 2)
+  unsigned int shards = 1;
+  for (; shards<=MAX_SHARDS; shards *= 2) {
+	run (theContext, shards, MAX_BATCH);
+  }
+  if ( shards / 2 != MAX_SHARDS ) {
+	run (theContext, MAX_SHARDS, MAX_BATCH);
+  }
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
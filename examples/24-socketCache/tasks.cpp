@@ -0,0 +1,113 @@
+// ---------------------------------------------------------------
+// tasks.cpp
+//
+//  Short tasks, each one a short conversation (REQ -> ROUTER,
+//  over tcp) as personRole in 05-inproc-bankThreads does:
+//  first with a new socket per task (socket + connection each
+//  time), then with the sockets of SocketCache.
+//
+//  PERSONS threads, TASKS tasks each, ROUNDS requests per task.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+
+#include "../../zmqHelperSocketCache.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int PERSONS = 4;
+const int TASKS = 500;
+const int ROUNDS = 2;
+
+const std::string URL = "tcp://localhost:5590";
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+void conversation (SocketAdaptor<ZMQ_REQ> & socket, const std::string & name) {
+  std::vector<std::string> lines;
+  for (int r=0; r<ROUNDS; r++) {
+	socket.sendText ( {name, "put", "12.34"} );
+	socket.receiveText (lines);
+	assert (lines[0] == "OK" && lines[1] == name);
+  }
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+long runPersons (zmq::context_t & theContext, bool cached) {
+
+  auto start = std::chrono::steady_clock::now ();
+
+  std::vector<std::thread> persons;
+  for (int p=0; p<PERSONS; p++) {
+	persons.emplace_back ( [&theContext, cached, p] () {
+		std::string name = "person-" + std::to_string (p);
+		for (int t=0; t<TASKS; t++) {
+		  if ( cached ) {
+			auto socket = SocketCache::forThisThread ().get<ZMQ_REQ> (theContext, URL);
+			conversation (*socket, name);
+		  } else {
+			SocketAdaptor<ZMQ_REQ> socket {theContext};
+			socket.connect (URL);
+			conversation (socket, name);
+			socket.close ();
+		  }
+		}
+
+		if ( cached ) {
+		  SocketCache & cache = SocketCache::forThisThread ();
+		  assert (cache.missCount () == 1 && cache.hitCount () == TASKS - 1);
+		}
+	  } );
+  }
+
+  for (auto & p : persons) {
+	p.join ();
+  }
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  std::atomic<bool> open {true};
+
+  //
+  // server
+  //
+  SocketAdaptorWithThread< ZMQ_ROUTER > server { theContext,
+	[&open] (SocketAdaptor<ZMQ_ROUTER> & socket) {
+	  socket.bind ("tcp://*:5590");
+	  RouterEnvelope env;
+	  while ( open ) {
+		if ( socket.receiveEnvelope (env, 100) ) {
+		  socket.reply (env, {"OK", env.text (0)});
+		}
+	  }
+	  socket.close ();
+	} };
+
+  long plain = runPersons (theContext, false);
+  long cached = runPersons (theContext, true);
+
+  std::cout << " " << PERSONS * TASKS << " tasks,"
+			<< " new socket each: " << plain << " ms,"
+			<< " cached sockets: " << cached << " ms\n";
+
+  open = false;
+  server.joinTheThread ();
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
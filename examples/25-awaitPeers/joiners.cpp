@@ -0,0 +1,102 @@
+// ---------------------------------------------------------------
+// joiners.cpp
+//
+//  The slow joiner problem: a PUSH (tcp) sending tasks to
+//  WORKERS PULL threads which connect a bit later, each one.
+//
+//  Sending at once, the first worker connected gets (nearly) all.
+//  Sleeping "long enough" wastes time, and may be not enough.
+//  With monitor() + awaitPeers(WORKERS), the PUSH starts the
+//  instant the last worker is connected, and all get their share.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "../../zmqHelper.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int WORKERS = 4;
+const int TASKS = 4000;
+
+const int PORT = 5591;
+
+// ---------------------------------------------------------------
+/// Tasks got by each worker (the last task of each is "END").
+// ---------------------------------------------------------------
+std::vector<int> run (zmq::context_t & theContext, bool await, int port) {
+
+  SocketAdaptor<ZMQ_PUSH> pusher {theContext};
+  pusher.monitor ();
+  pusher.bind ("tcp://*:" + std::to_string (port));
+
+  std::vector<int> got (WORKERS, 0);
+  std::vector<std::thread> workers;
+  for (int w=0; w<WORKERS; w++) {
+	workers.emplace_back ( [&theContext, &got, w, port] () {
+		// joining late, each one a bit more
+		std::this_thread::sleep_for (std::chrono::milliseconds (10 * (w + 1)));
+		SocketAdaptor<ZMQ_PULL> socket {theContext};
+		socket.connect ("tcp://localhost:" + std::to_string (port));
+		std::vector<std::string> lines;
+		while ( socket.receiveText (lines) && lines[0] != "END" ) {
+		  got[w]++;
+		}
+		socket.close ();
+	  } );
+  }
+
+  auto start = std::chrono::steady_clock::now ();
+  if ( await ) {
+	bool ready = pusher.awaitPeers (WORKERS, 5000);
+	assert (ready);
+  }
+  auto waited = std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+
+  for (int t=0; t<TASKS; t++) {
+	pusher.sendText ( {"task", std::to_string (t)} );
+  }
+
+  // one END each (round robin, once all are connected)
+  pusher.awaitPeers (WORKERS, 5000);
+  for (int w=0; w<WORKERS; w++) {
+	pusher.sendText ( {"END"} );
+  }
+
+  for (auto & w : workers) {
+	w.join ();
+  }
+  pusher.close ();
+
+  std::cout << (await ? "   awaitPeers: " : "   at once:    ")
+			<< "waited " << waited << " ms, tasks per worker:";
+  for (int g : got) {
+	std::cout << " " << g;
+  }
+  std::cout << "\n";
+
+  return got;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  run (theContext, false, PORT);
+  std::vector<int> got = run (theContext, true, PORT + 1);
+
+  for (int g : got) {
+	assert (g == TASKS / WORKERS);
+  }
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,104 @@
+// ---------------------------------------------------------------
+// profiles.cpp
+//
+//  A fast PUSH and a slow PULL (inproc), both sockets made with
+//  a profile (a set of typed options):
+//
+//   - HighThroughput: the sender never waits (long queues), but
+//     messages wait long in them before being read.
+//   - LowLatency: short queues, the sender is held back, and a
+//     message read is a recent one.
+//
+//  Reports the age of the messages when read, and how long the
+//  sender took. Also typed set / get of single options.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../../zmqHelperOptions.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int N = 5000;
+const int WORK_US = 50; // per message read
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+long nowUs () {
+  return std::chrono::duration_cast<std::chrono::microseconds>
+	(std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+template<typename Profile>
+void run (zmq::context_t & theContext, const std::string & name, const Profile & profile) {
+
+  std::string url = "inproc://profile-" + name;
+
+  std::vector<long> ages;
+  SocketAdaptorWithThread< ZMQ_PULL > receiver { theContext,
+	[&url, &ages, &profile] (SocketAdaptor<ZMQ_PULL> & socket) {
+	  profile.applyTo (socket);
+	  socket.bind (url);
+	  std::vector<std::string> lines;
+	  for (int i=0; i<N; i++) {
+		socket.receiveText (lines);
+		ages.push_back (nowUs () - std::stol (lines[0]));
+		std::this_thread::sleep_for (std::chrono::microseconds (WORK_US));
+	  }
+	} };
+
+  SocketAdaptor< ZMQ_PUSH > sender {theContext, profile};
+  sender.connect (url);
+
+  long start = nowUs ();
+  for (int i=0; i<N; i++) {
+	sender.sendText ( {std::to_string (nowUs ())} );
+  }
+  long sending = nowUs () - start;
+
+  receiver.joinTheThread ();
+  sender.close ();
+
+  std::sort (ages.begin (), ages.end ());
+  std::cout << "   " << name << ": sender done in " << sending / 1000 << " ms,"
+			<< " message age p50 " << ages[N/2] / 1000 << " ms,"
+			<< " p99 " << ages[N*99/100] / 1000 << " ms\n";
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  //
+  // single options
+  //
+  SocketAdaptor< ZMQ_DEALER > dealer {theContext};
+  dealer.set<option::SendHwm> (500);
+  dealer.set<option::RoutingId> ("dealer-1");
+  dealer.set<option::Affinity> (1);
+  // dealer.set<option::RouterMandatory> (1); // does not compile: not a ROUTER
+
+  assert (dealer.get<option::SendHwm> () == 500);
+  assert (dealer.get<option::RoutingId> () == "dealer-1");
+  dealer.close ();
+
+  //
+  // profiles
+  //
+  std::cout << " " << N << " messages, " << WORK_US << " us each to read:\n";
+  run (theContext, "high-throughput", profile::HighThroughput {});
+  run (theContext, "low-latency", profile::LowLatency {});
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
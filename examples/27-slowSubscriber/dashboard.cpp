@@ -0,0 +1,136 @@
+// ---------------------------------------------------------------
+// dashboard.cpp
+//
+//  A feed publishing quotes of TOPICS topics, fast, and a slow
+//  dashboard (1 ms per quote drawn), for RUN_MS:
+//
+//   - plain SUB: quotes wait in the zmq queues (till the HWM),
+//     what is drawn is old, and grows older;
+//   - SlowSubscriber CONFLATE: the latest quote of each topic;
+//   - SlowSubscriber DROP_OLDEST: the last RING quotes.
+//
+//  Reports the age of the quotes drawn (publish -> draw).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../../zmqHelperSlowSubscriber.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int TOPICS = 10;
+const long RUN_MS = 1000;
+const int DRAW_US = 1000;
+const size_t RING = 20;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+long nowUs () {
+  return std::chrono::duration_cast<std::chrono::microseconds>
+	(std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+// ---------------------------------------------------------------
+/// Publish quotes: topic, publish time (us), during RUN_MS.
+// ---------------------------------------------------------------
+void feed (zmq::context_t & theContext, const std::string & url, std::atomic<bool> & on) {
+  SocketAdaptor<ZMQ_PUB> publisher {theContext};
+  publisher.bind (url);
+  on = true;
+
+  long end = nowUs () + RUN_MS * 1000;
+  for (long i=0; nowUs () < end; i++) {
+	publisher.sendText ( {"Q" + std::to_string (i % TOPICS), std::to_string (nowUs ())} );
+	if ( i % 10 == 0 ) {
+	  std::this_thread::sleep_for (std::chrono::microseconds (100));
+	}
+  }
+  publisher.sendText ( {"END"} );
+  publisher.close ();
+} // ()
+
+// ---------------------------------------------------------------
+/// Draw quotes until END. @return ages (us)
+// ---------------------------------------------------------------
+template<typename Receive>
+std::vector<long> draw (Receive receive) {
+  std::vector<long> ages;
+  std::vector<std::string> lines;
+  while ( receive (lines) && lines[0] != "END" ) {
+	ages.push_back (nowUs () - std::stol (lines[1]));
+	std::this_thread::sleep_for (std::chrono::microseconds (DRAW_US));
+  }
+  return ages;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+void report (const std::string & name, std::vector<long> ages) {
+  std::sort (ages.begin (), ages.end ());
+  std::cout << "   " << name << ": drawn " << ages.size ()
+			<< ", age p50 " << ages[ages.size () / 2] / 1000 << " ms,"
+			<< " max " << ages.back () / 1000 << " ms";
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  //
+  // plain SUB
+  //
+  {
+	SocketAdaptor<ZMQ_SUB> socket {theContext};
+	std::atomic<bool> on {false};
+	std::thread publisher {feed, std::ref (theContext), "inproc://feed-plain", std::ref (on)};
+	while ( ! on ) { std::this_thread::yield (); }
+	socket.connect ("inproc://feed-plain");
+	socket.subscribe ("");
+
+	auto ages = draw ( [&socket] (std::vector<std::string> & lines) {
+		return socket.receiveTextInTimeout (lines, 2000);
+	  } );
+	publisher.join ();
+	socket.close ();
+	report ("plain SUB", ages);
+	std::cout << "\n";
+  }
+
+  //
+  // SlowSubscriber
+  //
+  for (auto policy : {SlowConsumerPolicy::CONFLATE, SlowConsumerPolicy::DROP_OLDEST}) {
+	bool conflate = policy == SlowConsumerPolicy::CONFLATE;
+	std::string url = conflate ? "inproc://feed-conflate" : "inproc://feed-ring";
+
+	std::atomic<bool> on {false};
+	std::thread publisher {feed, std::ref (theContext), url, std::ref (on)};
+	while ( ! on ) { std::this_thread::yield (); }
+
+	SlowSubscriber quotes {theContext, url, {""}, policy, conflate ? TOPICS + 1 : RING};
+
+	auto ages = draw ( [&quotes] (std::vector<std::string> & lines) {
+		return quotes.receive (lines, 2000);
+	  } );
+	publisher.join ();
+
+	report (conflate ? "CONFLATE" : "DROP_OLDEST", ages);
+	std::cout << ", dropped " << quotes.dropCount () << " of " << quotes.receivedCount ()
+			  << ", max pending " << quotes.maxPendingCount ()
+			  << ", max lag " << quotes.maxLagMs () << " ms\n";
+
+	assert (quotes.maxPendingCount () <= (conflate ? TOPICS + 1 : RING));
+	quotes.stop ();
+  }
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -0,0 +1,146 @@
+// ---------------------------------------------------------------
+// sensors.cpp
+//
+//  A publisher of TOPICS sensors ("sensor-0000" ...), each update
+//  costly to encode, and three subscribers wanting a few of them:
+//  "sensor-0001" (twice) and "sensor-002" (a prefix: 10 sensors).
+//
+//  The SubscriptionAwarePublisher waits for the subscriptions
+//  (no update lost), encodes only the wanted updates, and sees
+//  the subscribers go. Compared with encoding them all for a PUB.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+#include "../../zmqHelperXPublisher.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int TOPICS = 1000;
+const int ROUNDS = 20;
+
+const std::string URL = "inproc://sensors";
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+std::string topicOf (int i) {
+  char name[32];
+  snprintf (name, sizeof (name), "sensor-%04d", i);
+  return name;
+}
+
+// ---------------------------------------------------------------
+/// The costly part
+// ---------------------------------------------------------------
+unsigned long encodes = 0;
+
+std::string encode (int sensor, int round) {
+  encodes++;
+  std::string text;
+  for (int k=0; k<200; k++) {
+	text += std::to_string (sensor * round + k) + ",";
+  }
+  return text;
+}
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  SubscriptionAwarePublisher publisher {theContext};
+  publisher.bind (URL);
+
+  //
+  // subscribers: filter, updates expected
+  //
+  std::vector< std::pair<std::string, int> > wants =
+	{ {"sensor-0001", ROUNDS}, {"sensor-0001", ROUNDS}, {"sensor-002", 10 * ROUNDS} };
+
+  std::vector<std::thread> subscribers;
+  for (auto & w : wants) {
+	subscribers.emplace_back ( [&theContext, w] () {
+		SocketAdaptor<ZMQ_SUB> socket {theContext};
+		socket.connect (URL);
+		socket.subscribe (w.first);
+		std::vector<std::string> lines;
+		for (int i=0; i<w.second; i++) {
+		  bool got = socket.receiveTextInTimeout (lines, 5000);
+		  assert (got && lines[0].compare (0, w.first.size (), w.first) == 0);
+		}
+		socket.close (); // unsubscribes
+	  } );
+  }
+
+  // all of them in
+  while ( publisher.subscriberCount ("sensor-0001") < 2
+		  || publisher.subscriberCount ("sensor-002") < 1 ) {
+	publisher.processSubscriptions (100);
+  }
+
+  publisher.forEachSubscription ( [] (const std::string & prefix, int n) {
+	  std::cout << " subscription " << prefix << ": " << n << " subscriber(s)\n";
+	} );
+
+  //
+  // publish (only what is wanted is encoded)
+  //
+  auto start = std::chrono::steady_clock::now ();
+  for (int r=0; r<ROUNDS; r++) {
+	for (int s=0; s<TOPICS; s++) {
+	  publisher.publish (topicOf (s), [s, r] (std::vector<std::string> & body) {
+		  body.push_back (encode (s, r));
+		} );
+	}
+  }
+  auto aware = std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+  unsigned long awareEncodes = encodes;
+
+  for (auto & s : subscribers) {
+	s.join ();
+  }
+
+  // all of them out
+  while ( publisher.processSubscriptions (1000) ) { }
+  int left = 0;
+  publisher.forEachSubscription ( [&left] (const std::string &, int n) { left += n; } );
+  assert (left == 0);
+
+  publisher.close ();
+
+  //
+  // the same with a PUB: everything is encoded
+  //
+  SocketAdaptor<ZMQ_PUB> plain {theContext};
+  plain.bind ("inproc://sensors-plain");
+
+  encodes = 0;
+  start = std::chrono::steady_clock::now ();
+  for (int r=0; r<ROUNDS; r++) {
+	for (int s=0; s<TOPICS; s++) {
+	  plain.sendText ( {topicOf (s), encode (s, r)} );
+	}
+  }
+  auto all = std::chrono::duration_cast<std::chrono::milliseconds>
+	(std::chrono::steady_clock::now () - start).count ();
+  plain.close ();
+
+  std::cout << " " << ROUNDS * TOPICS << " updates:"
+			<< " PUB encodes " << encodes << " in " << all << " ms,"
+			<< " subscription aware encodes " << awareEncodes << " in " << aware << " ms"
+			<< " (published " << publisher.publishedCount ()
+			<< ", skipped " << publisher.skippedCount () << ")\n";
+
+  assert (awareEncodes == (unsigned long) ROUNDS * 11);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
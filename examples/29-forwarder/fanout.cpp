@@ -0,0 +1,161 @@
+// ---------------------------------------------------------------
+// fanout.cpp
+//
+//  A chat-like feed (CHANNELS channels) and SUBSCRIBERS SUB
+//  sockets (tcp), each on a channel, behind a Forwarder:
+//
+//    publisher (XPUB, aware) -> Forwarder (GROUPS XPUBs) -> SUBs
+//
+//  The publisher sees one subscription per channel, however many
+//  subscribers there are (merged and deduplicated). Reports
+//  messages delivered per second, with 1 group and with GROUPS.
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+
+#include "../../zmqHelperForwarder.hpp"
+#include "../../zmqHelperXPublisher.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int CHANNELS = 10;
+const int SUBSCRIBERS = 400;
+const int READERS = 4;       // threads polling the SUBs
+const unsigned int GROUPS = 4;
+const long RUN_MS = 1000;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+std::string channelOf (int k) {
+  return "channel-" + std::to_string (k % CHANNELS) + "/";
+}
+
+// ---------------------------------------------------------------
+/// Readers: each one owns SUBSCRIBERS/READERS SUBs, subscriber k
+/// on the group k % groups. @return messages delivered
+// ---------------------------------------------------------------
+unsigned long readers (zmq::context_t & theContext, int port, unsigned int groups,
+					   std::atomic<bool> & reading, std::atomic<int> & ready) {
+  std::vector<std::thread> threads;
+  std::vector<unsigned long> got (READERS, 0);
+
+  for (int r=0; r<READERS; r++) {
+	threads.emplace_back ( [&, r] () {
+		std::vector< std::unique_ptr< SocketAdaptor<ZMQ_SUB> > > subs;
+		std::vector<zmq::pollitem_t> items;
+		for (int k=r; k<SUBSCRIBERS; k+=READERS) {
+		  subs.emplace_back ( new SocketAdaptor<ZMQ_SUB> {theContext} );
+		  subs.back()->connect ("tcp://localhost:" + std::to_string (port + 1 + k % groups));
+		  subs.back()->subscribe (channelOf (k));
+		  items.push_back ( { * subs.back()->getZmqSocket (), 0, ZMQ_POLLIN, 0 } );
+		}
+		ready++;
+
+		std::vector<zmq::message_t> frames;
+		while ( reading ) {
+		  zmq::poll (items.data (), items.size (), 100);
+		  for (size_t i=0; i<subs.size (); i++) {
+			if ( items[i].revents & ZMQ_POLLIN ) {
+			  while ( subs[i]->receiveFrames (frames, 0) ) {
+				got[r]++;
+			  }
+			}
+		  }
+		}
+		for (auto & s : subs) {
+		  s->close ();
+		}
+	  } );
+  }
+
+  for (auto & t : threads) {
+	t.join ();
+  }
+
+  unsigned long total = 0;
+  for (auto g : got) {
+	total += g;
+  }
+  return total;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+void run (zmq::context_t & theContext, int port, unsigned int groups) {
+
+  SubscriptionAwarePublisher publisher {theContext};
+  publisher.bind ("tcp://*:" + std::to_string (port));
+
+  Forwarder forwarder {theContext, "forwarder-" + std::to_string (port)};
+  forwarder.connectUpstream ("tcp://localhost:" + std::to_string (port));
+  for (unsigned int g=0; g<groups; g++) {
+	forwarder.addGroup ( {"tcp://*:" + std::to_string (port + 1 + g)} );
+  }
+  forwarder.start ();
+
+  std::atomic<bool> reading {true};
+  std::atomic<int> ready {0};
+  unsigned long delivered = 0;
+  std::thread subscribers { [&] () {
+	  delivered = readers (theContext, port, groups, reading, ready);
+	} };
+
+  // every channel wanted
+  for (int c=0; c<CHANNELS; c++) {
+	bool wanted = publisher.awaitSubscriber (channelOf (c), 5000);
+	assert (wanted);
+  }
+  while ( ready < READERS ) {
+	std::this_thread::yield ();
+  }
+  std::this_thread::sleep_for (std::chrono::milliseconds (200)); // (the other subscribers)
+
+  int subscriptions = 0;
+  publisher.forEachSubscription ( [&subscriptions] (const std::string &, int n) { subscriptions += n; } );
+
+  // publish, as fast as they go
+  auto start = std::chrono::steady_clock::now ();
+  auto end = start + std::chrono::milliseconds (RUN_MS);
+  unsigned long published = 0;
+  std::string text (100, 'x');
+  while ( std::chrono::steady_clock::now () < end ) {
+	publisher.publish (channelOf (published), {"guest", text});
+	published++;
+  }
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (200)); // (drain)
+  reading = false;
+  subscribers.join ();
+
+  double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  forwarder.stop ();
+  publisher.close ();
+
+  std::cout << "   " << groups << " group(s): " << SUBSCRIBERS << " subscribers,"
+			<< " publisher sees " << subscriptions << " subscriptions,"
+			<< " published " << published << ", delivered "
+			<< (long) (delivered / seconds) << " msg/s\n";
+
+  // deduplicated: one per channel
+  assert (subscriptions == CHANNELS);
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {GROUPS}; // I/O threads
+
+  run (theContext, 5600, 1);
+  run (theContext, 5620, GROUPS);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
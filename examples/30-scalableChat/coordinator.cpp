@@ -0,0 +1,151 @@
+// ---------------------------------------------------------------
+// coordinator.cpp
+//
+//  The chat coordinator of 03-chat, for many guests:
+//
+//   - ROUTER (8000) instead of REP: a post {channel, nick, text}
+//     is acknowledged ("OK") at once, and the next one read with
+//     no wait; DEALER guests need not wait for the "OK" (the REQ
+//     guests of 03-chat still work).
+//   - the posts read in a go are published in one message per
+//     channel: {channel, nick1, text1, nick2, text2 ...}
+//     (SubscriptionAwarePublisher, 8001: posts to a channel
+//     nobody listens to are not published).
+//   - per channel: posts/s, and subscribers (from the XPUB).
+//     Printed every STATS_MS; "#STATS" gets
+//     {"STATS", channels, subscribers, posts, batches}.
+//
+//  Run it, then run.loadgen (or the guests of 03-chat).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+
+#include "../../zmqHelperXPublisher.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int MAX_DRAIN = 1000; // posts read before publishing
+const long STATS_MS = 5000;
+const int TOP = 5;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+struct Channel {
+  std::string name;
+  std::vector<std::string> batch; // nick, text, nick, text ...
+  bool pending = false;
+  unsigned long posts = 0;
+  unsigned long lastPosts = 0; // at the last stats
+  double rate = 0;
+};
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+int main ()
+{
+  zmq::context_t theContext {1};
+
+  SocketAdaptor< ZMQ_ROUTER > receiver {theContext};
+  SubscriptionAwarePublisher emitter {theContext};
+
+  receiver.bind ("tcp://*:8000");
+  emitter.bind ("tcp://*:8001");
+
+  std::unordered_map<std::string, Channel> channels;
+  std::vector<Channel *> pending;
+
+  unsigned long posts = 0;
+  unsigned long batches = 0;
+  auto lastStats = std::chrono::steady_clock::now ();
+
+  RouterEnvelope env;
+
+  while (true) {
+
+	//
+	// read (and acknowledge) what there is
+	//
+	int n = 0;
+	while ( n < MAX_DRAIN && receiver.receiveEnvelope (env, n == 0 ? 100 : 0) ) {
+	  n++;
+
+	  if ( env.body.size () == 1 && frameIs (env.body[0], "#STATS") ) {
+		int subscribed = 0;
+		int subscribers = 0;
+		emitter.processSubscriptions ();
+		emitter.forEachSubscription ( [&] (const std::string &, int k) {
+			subscribed++;
+			subscribers += k;
+		  } );
+		receiver.reply (env, {"STATS", std::to_string (subscribed), std::to_string (subscribers),
+							  std::to_string (posts), std::to_string (batches)});
+		continue;
+	  }
+
+	  if ( env.body.size () < 3 ) {
+		receiver.reply (env, {"ERROR", "expected: channel, nick, text"});
+		continue;
+	  }
+
+	  Channel & c = channels[env.text (0)];
+	  if ( ! c.pending ) {
+		c.name = env.text (0);
+		c.pending = true;
+		pending.push_back (&c);
+	  }
+	  c.batch.push_back (env.text (1));
+	  c.batch.push_back (env.text (2));
+	  c.posts++;
+	  posts++;
+
+	  receiver.reply (env, {"OK"});
+	} // while
+
+	//
+	// publish: one message per channel
+	//
+	for (Channel * c : pending) {
+	  emitter.publish (c->name, c->batch);
+	  c->batch.clear ();
+	  c->pending = false;
+	  batches++;
+	}
+	pending.clear ();
+
+	//
+	// stats
+	//
+	auto now = std::chrono::steady_clock::now ();
+	double seconds = std::chrono::duration<double> (now - lastStats).count ();
+	if ( seconds * 1000 < STATS_MS ) {
+	  continue;
+	}
+	lastStats = now;
+
+	std::vector<Channel *> busiest;
+	for (auto & kv : channels) {
+	  Channel & c = kv.second;
+	  c.rate = (c.posts - c.lastPosts) / seconds;
+	  c.lastPosts = c.posts;
+	  busiest.push_back (&c);
+	}
+	std::sort (busiest.begin (), busiest.end (),
+			   [] (Channel * a, Channel * b) { return a->rate > b->rate; } );
+
+	std::cout << " posts " << posts << ", batches " << batches
+			  << " (" << (batches ? posts / batches : 0) << " posts per batch),"
+			  << " not published " << emitter.skippedCount () << "\n";
+	for (int i=0; i<TOP && i<(int) busiest.size (); i++) {
+	  std::cout << "   " << busiest[i]->name << ": " << (long) busiest[i]->rate << " posts/s, "
+				<< emitter.subscriberCount (busiest[i]->name) << " subscribers\n";
+	}
+	std::cout << std::flush;
+  } // while
+
+} // () main
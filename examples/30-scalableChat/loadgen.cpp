@@ -0,0 +1,229 @@
+// ---------------------------------------------------------------
+// loadgen.cpp
+//
+//  Load for the coordinator (run.coord): GUESTS guests in
+//  CHANNELS channels (GUESTS/CHANNELS in each).
+//
+//   - listening: SUB_SOCKETS SUBs (tcp 8001), each one holding
+//     the subscription of some guests (of different channels),
+//     polled by READERS threads;
+//   - posting: SENDERS DEALERs (tcp 8000) posting RATE posts/s
+//     in all, for DURATION_MS, each one from a random guest to its
+//     channel, with the time sent as text. "OK"s are not waited.
+//
+//  Waits for all the subscriptions to be in (asking "#STATS")
+//  and reports posts acknowledged, deliveries, and the delivery
+//  latency (post sent -> received by a guest).
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+
+#include "../../zmqHelper.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const int GUESTS = 10000;
+const int CHANNELS = 1000;
+const int SUB_SOCKETS = 512; // (guests on a SUB: of different channels)
+const int READERS = 4;
+const int SENDERS = 4;
+const int RATE = 5000;
+const long DURATION_MS = 3000;
+
+const std::string POST_URL = "tcp://localhost:8000";
+const std::string LISTEN_URL = "tcp://localhost:8001";
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+long nowUs () {
+  return std::chrono::duration_cast<std::chrono::microseconds>
+	(std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+/// (fixed width: no channel name is a prefix of another)
+std::string channelOf (int guest) {
+  char name[32];
+  snprintf (name, sizeof (name), "channel-%04d", guest % CHANNELS);
+  return name;
+}
+
+// ---------------------------------------------------------------
+/// A reader: the SUBs r, r+READERS ... Guest g listens on
+/// SUB g % SUB_SOCKETS. Latencies (us) of the deliveries.
+// ---------------------------------------------------------------
+void reader (zmq::context_t & theContext, int r, std::atomic<bool> & reading,
+			 std::atomic<int> & ready, std::vector<long> & latencies) {
+  std::vector< std::unique_ptr< SocketAdaptor<ZMQ_SUB> > > subs;
+  std::vector<zmq::pollitem_t> items;
+  for (int s=r; s<SUB_SOCKETS; s+=READERS) {
+	subs.emplace_back ( new SocketAdaptor<ZMQ_SUB> {theContext} );
+	subs.back()->connect (LISTEN_URL);
+	for (int g=s; g<GUESTS; g+=SUB_SOCKETS) {
+	  subs.back()->subscribe (channelOf (g));
+	}
+	items.push_back ( { * subs.back()->getZmqSocket (), 0, ZMQ_POLLIN, 0 } );
+  }
+  ready++;
+
+  std::vector<std::string> lines;
+  while ( reading ) {
+	zmq::poll (items.data (), items.size (), 100);
+	for (size_t i=0; i<subs.size (); i++) {
+	  if ( items[i].revents & ZMQ_POLLIN ) {
+		while ( subs[i]->receiveTextInTimeout (lines, 0) ) {
+		  long now = nowUs ();
+		  // channel, nick, sent, nick, sent ...
+		  for (size_t k=2; k<lines.size (); k+=2) {
+			latencies.push_back (now - std::stol (lines[k]));
+		  }
+		}
+	  }
+	}
+  }
+
+  for (auto & s : subs) {
+	s->close ();
+  }
+} // ()
+
+// ---------------------------------------------------------------
+/// A sender: RATE/SENDERS posts/s. @return posts acknowledged
+// ---------------------------------------------------------------
+unsigned long sender (zmq::context_t & theContext, int id, unsigned long & sent) {
+  SocketAdaptor<ZMQ_DEALER> socket {theContext};
+  socket.connect (POST_URL);
+
+  std::mt19937 random (id);
+  std::uniform_int_distribution<int> guest {0, GUESTS - 1};
+
+  double rate = RATE / (double) SENDERS;
+  long start = nowUs ();
+  long end = start + DURATION_MS * 1000;
+  unsigned long acked = 0;
+  std::vector<std::string> lines;
+
+  sent = 0;
+  while ( true ) {
+	long now = nowUs ();
+	if ( now < end ) {
+	  unsigned long due = (now - start) * rate / 1e6;
+	  while ( sent < due ) {
+		int g = guest (random);
+		socket.sendText ( {channelOf (g), "guest-" + std::to_string (g), std::to_string (nowUs ())} );
+		sent++;
+	  }
+	} else if ( acked == sent || now > end + 5000000 ) {
+	  break;
+	}
+
+	while ( socket.receiveTextInTimeout (lines, acked < sent ? 1 : 0) ) {
+	  acked += lines[0] == "OK";
+	}
+  } // while
+
+  socket.close ();
+  return acked;
+} // ()
+
+// ---------------------------------------------------------------
+/// @return the subscribers the coordinator sees
+// ---------------------------------------------------------------
+int subscribersSeen (SocketAdaptor<ZMQ_REQ> & stats) {
+  std::vector<std::string> lines;
+  stats.sendText ( {"#STATS"} );
+  stats.receiveText (lines);
+  return std::stoi (lines[2]);
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  zmq::context_t theContext {1};
+
+  //
+  // guests listening
+  //
+  std::atomic<bool> reading {true};
+  std::atomic<int> ready {0};
+  std::vector< std::vector<long> > latencies (READERS);
+  std::vector<std::thread> readers;
+  for (int r=0; r<READERS; r++) {
+	readers.emplace_back (reader, std::ref (theContext), r, std::ref (reading),
+						  std::ref (ready), std::ref (latencies[r]));
+  }
+
+  // all the subscriptions in
+  SocketAdaptor<ZMQ_REQ> stats {theContext};
+  stats.connect (POST_URL);
+  auto waitStart = std::chrono::steady_clock::now ();
+  int seen = 0;
+  while ( (seen = subscribersSeen (stats)) < GUESTS ) {
+	if ( std::chrono::steady_clock::now () - waitStart > std::chrono::seconds (20) ) {
+	  std::cout << " only " << seen << " subscribers seen (is run.coord running?)\n";
+	  return 1;
+	}
+	std::this_thread::sleep_for (std::chrono::milliseconds (100));
+  }
+  std::cout << " " << GUESTS << " guests in " << CHANNELS << " channels,"
+			<< " coordinator sees " << seen << " subscribers\n";
+
+  //
+  // guests posting
+  //
+  std::vector<unsigned long> sent (SENDERS, 0);
+  std::vector<unsigned long> acked (SENDERS, 0);
+  std::vector<std::thread> senders;
+  for (int s=0; s<SENDERS; s++) {
+	senders.emplace_back ( [&theContext, &sent, &acked, s] () {
+		acked[s] = sender (theContext, s + 1, sent[s]);
+	  } );
+  }
+  for (auto & s : senders) {
+	s.join ();
+  }
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (500)); // (the last deliveries)
+  reading = false;
+  for (auto & r : readers) {
+	r.join ();
+  }
+  stats.close ();
+
+  //
+  // report
+  //
+  unsigned long posts = 0, acks = 0;
+  for (int s=0; s<SENDERS; s++) {
+	posts += sent[s];
+	acks += acked[s];
+  }
+  std::vector<long> all;
+  for (auto & l : latencies) {
+	all.insert (all.end (), l.begin (), l.end ());
+  }
+  std::sort (all.begin (), all.end ());
+
+  std::cout << " posts " << posts << " (" << posts * 1000 / DURATION_MS << "/s),"
+			<< " acknowledged " << acks << ","
+			<< " deliveries " << all.size () << " of " << posts * (GUESTS / CHANNELS) << "\n";
+  if ( ! all.empty () ) {
+	std::cout << " delivery latency: p50 " << all[all.size () / 2] / 1000.0 << " ms,"
+			  << " p99 " << all[all.size () * 99 / 100] / 1000.0 << " ms,"
+			  << " max " << all.back () / 1000.0 << " ms\n";
+  }
+
+  assert (acks == posts);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
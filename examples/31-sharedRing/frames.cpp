@@ -0,0 +1,113 @@
+// ---------------------------------------------------------------
+// frames.cpp
+//
+//  Big frames (8 MB, as camera images) from a process to another
+//  one of the same host: copied through an ipc socket, or written
+//  into a ring of shared memory with only a descriptor through
+//  the socket.
+//
+//  DEALER sender (this process) -> ROUTER receiver (child process)
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+
+#include "../../zmqHelperOptions.hpp"
+#include "../../zmqHelperSharedRing.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const std::string URL = "ipc:///tmp/zmqHelper-frames";
+const size_t FRAME_SIZE = 8 * 1024 * 1024;
+const int FRAMES = 200;
+
+// ---------------------------------------------------------------
+/// The receiver: reads every byte of every frame, an empty one
+/// is the end.
+// ---------------------------------------------------------------
+void receiver () {
+  zmq::context_t theContext {1};
+  SocketAdaptor< ZMQ_ROUTER > socket {theContext};
+  socket.connect (URL);
+
+  SharedRingReceiver<ZMQ_ROUTER> in {socket};
+  SharedPayload payload;
+  uint64_t sum = 0;
+  int frames = 0;
+
+  while ( in.receive (payload) && payload.size () > 0 ) {
+	const uint64_t * words = static_cast<const uint64_t *> (payload.data ());
+	for (size_t i=0; i<payload.size () / sizeof (uint64_t); i++) {
+	  sum += words[i];
+	}
+	frames++;
+	payload.release ();
+  }
+  payload.release ();
+
+  std::cout << "    receiver: " << frames << " frames, sum " << sum << std::endl;
+  socket.close ();
+} // ()
+
+// ---------------------------------------------------------------
+/// Send the frames to a new receiver process.
+/// @param minShared for the sender (bigger than a frame: inline)
+// ---------------------------------------------------------------
+void run (const char * title, size_t minShared) {
+  std::cout << " " << title << std::endl; // (before the fork)
+
+  pid_t child = fork ();
+  if ( child == 0 ) {
+	receiver ();
+	_exit (0);
+  }
+
+  zmq::context_t theContext {1};
+  SocketAdaptor< ZMQ_DEALER > socket {theContext};
+  socket.set<option::SendHwm> (4);
+  socket.bind (URL);
+
+  SharedRingSender<ZMQ_DEALER> out {socket, URL, "/zmqHelper-frames-ring",
+	  64 * 1024 * 1024, minShared};
+
+  std::vector<uint64_t> image (FRAME_SIZE / sizeof (uint64_t));
+
+  auto start = std::chrono::steady_clock::now ();
+  for (int f=0; f<FRAMES; f++) {
+	out.send (FRAME_SIZE, [&] (void * where) {
+		// "render" the image right where it goes
+		uint64_t * words = static_cast<uint64_t *> (where);
+		for (size_t i=0; i<image.size (); i++) {
+		  words[i] = f + i;
+		}
+	  } );
+  }
+  out.send (nullptr, 0); // the end
+  out.drain ();
+  waitpid (child, nullptr, 0);
+  double ms = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+  std::cout << "    " << out.sharedCount () << " in the ring, "
+			<< out.inlineCount () << " inline, "
+			<< out.fullRingCount () << " with the ring full \n"
+			<< "    " << int (FRAMES * (FRAME_SIZE / 1024.0 / 1024.0) / (ms / 1000.0))
+			<< " MB/s (" << int (ms) << " ms)\n";
+
+  socket.close ();
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  run ("copied through the socket:", FRAME_SIZE + 1);
+  run ("shared memory ring:", 64 * 1024);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
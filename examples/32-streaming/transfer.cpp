@@ -0,0 +1,144 @@
+// ---------------------------------------------------------------
+// transfer.cpp
+//
+//  A file of 2 GB sent in chunks over tcp (loopback): read with
+//  pread, or from an mmap of it; the receiver asking for one
+//  chunk at a time, or keeping a window of 8 asked for. The
+//  memory used stays the same, whatever the size of the file
+//  (but the pages of the mmap, which count as memory of the
+//  process though they are the file cache).
+//
+//  DEALER receiver (main thread) -> ROUTER sender (its thread)
+// ---------------------------------------------------------------
+
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "../../zmqHelperStreaming.hpp"
+
+using namespace zmqHelper;
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+const std::string URL = "tcp://127.0.0.1:5590";
+const char * PATH = "/tmp/zmqHelper-transfer.bin";
+const uint64_t FILE_SIZE = 2048ULL * 1024 * 1024;
+
+// ---------------------------------------------------------------
+/// @return maximum resident memory so far, in MB
+// ---------------------------------------------------------------
+long maxMemoryMB () {
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024;
+} // ()
+
+// ---------------------------------------------------------------
+/// Write the file (words 0, 1, 2 ...). @return their sum
+// ---------------------------------------------------------------
+uint64_t makeFile () {
+  int fd = open (PATH, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+  std::vector<uint64_t> block (128 * 1024);
+  uint64_t word = 0;
+  uint64_t sum = 0;
+  for (uint64_t written = 0; written < FILE_SIZE; written += block.size () * sizeof (uint64_t)) {
+	for (auto & w : block) {
+	  w = word++;
+	  sum += w;
+	}
+	if ( write (fd, block.data (), block.size () * sizeof (uint64_t)) < 0 ) {
+	  break;
+	}
+  }
+  close (fd);
+  return sum;
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+void run (StreamReceiver & in, const char * title, const std::string & name, uint64_t expected) {
+  uint64_t sum = 0;
+
+  auto start = std::chrono::steady_clock::now ();
+  long long got = in.fetch (name, [&] (const void * data, size_t size) {
+	  // (the chunk size is a multiple of 8)
+	  const uint64_t * words = static_cast<const uint64_t *> (data);
+	  for (size_t i=0; i<size / sizeof (uint64_t); i++) {
+		sum += words[i];
+	  }
+	  return true;
+	} );
+  double s = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  std::cout << " " << title << ": " << got / (1024 * 1024) << " MB, "
+			<< int (got / 1024.0 / 1024.0 / s) << " MB/s, "
+			<< (sum == expected ? "checksum ok" : "WRONG CHECKSUM")
+			<< ", max memory " << maxMemoryMB () << " MB\n";
+
+  assert (got == (long long) FILE_SIZE && sum == expected);
+} // ()
+
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+int main () {
+
+  uint64_t expected = makeFile ();
+  std::cout << " file of " << FILE_SIZE / (1024 * 1024) << " MB written"
+			<< ", max memory " << maxMemoryMB () << " MB\n";
+
+  int fd = open (PATH, O_RDONLY);
+  void * region = mmap (nullptr, FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+
+  zmq::context_t theContext {1};
+  std::atomic<bool> done {false};
+
+  //
+  // sender
+  //
+  SocketAdaptorWithThread<ZMQ_ROUTER> sender { theContext,
+	[&] (SocketAdaptor<ZMQ_ROUTER> & socket) {
+	  socket.bind (URL);
+	  StreamSender out {socket};
+	  out.offer ("by-pread", fd);
+	  out.offer ("by-mmap", region, FILE_SIZE);
+	  while ( ! done ) {
+		out.serveOnce (100);
+	  }
+	  // (munmap only when no chunk of the region is left in flight)
+	  if ( ! out.withdraw ("by-mmap", 1000) ) {
+		std::cout << " sender: " << out.inFlightCount ("by-mmap") << " chunks still in flight \n";
+	  }
+	  std::cout << " sender: " << out.chunksSent () << " chunks \n";
+	} };
+
+  //
+  // receiver
+  //
+  SocketAdaptor<ZMQ_DEALER> dealer {theContext};
+  dealer.connect (URL);
+
+  StreamReceiver oneByOne {dealer, 256 * 1024, 1};
+  run (oneByOne, "pread, 1 chunk asked for", "by-pread", expected);
+
+  StreamReceiver windowed {dealer, 256 * 1024, 8};
+  run (windowed, "pread, 8 chunks asked for", "by-pread", expected);
+  run (windowed, "mmap, 8 chunks asked for", "by-mmap", expected);
+
+  assert (windowed.fetch ("nothing", [] (const void *, size_t) { return true; }) == -1);
+
+  done = true;
+  sender.joinTheThread ();
+  dealer.close ();
+
+  munmap (region, FILE_SIZE);
+  close (fd);
+  unlink (PATH);
+
+  std::cout << " happy ending \n";
+
+  return 0;
+} // main ()
@@ -16,9 +16,16 @@
 // -----------------------------------------------------------------
 #include <zmq.hpp>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
 #include <iostream>
 #include <unistd.h>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <chrono>
 
 #include <thread>        
 #include <mutex>
@@ -120,6 +127,116 @@ namespace zmqHelper {
   class SocketOwnedByOtherThreadException {};
   class ThreadIsNotIddleException {};
   class CantSendDataException {};
+  class NotMonitoredException {};
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// A message received on a ROUTER, split: the identity of the
+  /// peer, (the empty delimiter) and the body. Frames are kept
+  /// as zmq frames (not copied). Reuse it from message to message.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class RouterEnvelope {
+  public:
+
+	// .............................................................
+	/// routing id of the peer (raw bytes)
+	zmq::message_t identity;
+
+	// .............................................................
+	/// was there an empty delimiter after the identity?
+	/// (REQ peers put it, DEALER peers may not)
+	bool delimited = false;
+
+	// .............................................................
+	/// the rest of the frames
+	std::vector<zmq::message_t> body;
+
+	// .............................................................
+	/// @return the i-th body frame as text (a copy)
+	// .............................................................
+	std::string text (unsigned int i) const {
+	  return std::string { (const char *) body[i].data (), body[i].size () };
+	}
+  };
+
+  // -----------------------------------------------------------------
+  /// @return true if the frame holds exactly this text
+  // -----------------------------------------------------------------
+  inline bool frameIs (const zmq::message_t & frame, const char * text) {
+	size_t n = strlen (text);
+	return frame.size () == n && memcmp (frame.data (), text, n) == 0;
+  } // ()
+
+  // -----------------------------------------------------------------
+  /// @return a frame with a copy of the text
+  // -----------------------------------------------------------------
+  inline zmq::message_t textFrame (const std::string & text) {
+	zmq::message_t m (text.size ());
+	memcpy (m.data (), text.data (), text.size ());
+	return m;
+  } // ()
+
+  // -----------------------------------------------------------------
+  /// @return the index of the first body frame (after the empty
+  /// delimiter, looked for from index from on), frames.size() if none
+  // -----------------------------------------------------------------
+  inline size_t bodyStart (const std::vector<zmq::message_t> & frames, size_t from = 0) {
+	for (size_t i=from; i<frames.size (); i++) {
+	  if ( frames[i].size () == 0 ) {
+		return i + 1;
+	  }
+	}
+	return frames.size ();
+  } // ()
+
+  // ---------------------------------------------------------------
+  /// @return true if the n chars at text are a number (and nothing
+  /// else), and then value gets it
+  // ---------------------------------------------------------------
+  inline bool textNumber (const char * text, size_t n, long long & value) {
+	char digits[24];
+	if ( n == 0 || n >= sizeof (digits) ) {
+	  return false;
+	}
+	memcpy (digits, text, n);
+	digits[n] = '\0';
+	if ( digits[0] != '-' && (digits[0] < '0' || digits[0] > '9') ) {
+	  return false;
+	}
+	char * end = nullptr;
+	errno = 0;
+	long long v = strtoll (digits, &end, 10);
+	if ( errno != 0 || *end != '\0' ) {
+	  return false;
+	}
+	value = v;
+	return true;
+  } // ()
+
+  // -----------------------------------------------------------------
+  /// @return true if the frame is the tag followed by a number
+  /// (nothing else: an empty or non numeric rest is false), and
+  /// then value gets the number
+  // -----------------------------------------------------------------
+  inline bool taggedNumber (const zmq::message_t & frame, const char * tag, long long & value) {
+	const size_t n = strlen (tag);
+	if ( frame.size () < n || memcmp (frame.data (), tag, n) != 0 ) {
+	  return false;
+	}
+	return textNumber (static_cast<const char *> (frame.data ()) + n, frame.size () - n, value);
+  } // ()
+
+  // ---------------------------------------------------------------
+  /// @return true if the whole frame is a number (as got from the
+  /// wire: anything else is false, never an exception), and then
+  /// value gets it
+  // ---------------------------------------------------------------
+  inline bool frameNumber (const zmq::message_t & frame, long long & value) {
+	return textNumber (static_cast<const char *> (frame.data ()), frame.size (), value);
+  } // ()
 
   // ---------------------------------------------------------------
   // ---------------------------------------------------------------
@@ -152,6 +269,13 @@ namespace zmqHelper {
 
 	ZmqSocketType  theZmqSocket; // not constructed now
 
+	// .............................................................
+	/// The events of theZmqSocket (see monitor()), and the peers
+	/// counted from them
+	// .............................................................
+	std::unique_ptr<ZmqSocketType> theMonitor;
+	int peers = 0;
+
 	// .............................................................
 	/// 
 	// .............................................................
@@ -166,6 +290,52 @@ namespace zmqHelper {
 
 	}
 
+	// .............................................................
+	/// After the identity frame of a ROUTER message: the
+	/// (optional) delimiter and the body.
+	// .............................................................
+	void sendRouteRest (const std::vector<std::string> & body, bool delimited) {
+	  if (delimited) {
+		zmq::message_t empty;
+		theZmqSocket.send (empty, body.empty () ? 0 : ZMQ_SNDMORE);
+	  }
+
+	  unsigned int many = body.size ();
+	  for (unsigned int i=0; i<many; i++) {
+		zmq::message_t part (body[i].size());
+		memcpy ((void *) part.data (), body[i].c_str(), body[i].size());
+		theZmqSocket.send (part, i+1<many ? ZMQ_SNDMORE : 0);
+	  }
+	}
+
+	// .............................................................
+	/// (for set<Option>() / get<Option>())
+	// .............................................................
+	void setOption (int id, int value) {
+	  theZmqSocket.setsockopt (id, &value, sizeof (value));
+	}
+
+	void setOption (int id, uint64_t value) {
+	  theZmqSocket.setsockopt (id, &value, sizeof (value));
+	}
+
+	void setOption (int id, const std::string & value) {
+	  theZmqSocket.setsockopt (id, value.data (), value.size ());
+	}
+
+	template<typename T>
+	void getOption (int id, T & value) {
+	  size_t size = sizeof (value);
+	  theZmqSocket.getsockopt (id, &value, &size);
+	}
+
+	void getOption (int id, std::string & value) {
+	  char buffer[256];
+	  size_t size = sizeof (buffer);
+	  theZmqSocket.getsockopt (id, buffer, &size);
+	  value.assign (buffer, size);
+	}
+
 	// .............................................................
 	/// Copy construction disallowed.
 	// .............................................................
@@ -208,6 +378,17 @@ namespace zmqHelper {
 	  // std::cerr << " < < < < < < SocketAdaptor constructuctor done \n" << std::flush;
 	}
 
+	// .............................................................
+	/// Constructor applying a profile of options
+	/// (f.ex. profile::LowLatency {}, see zmqHelperOptions.hpp).
+	// .............................................................
+	template<typename Profile>
+	SocketAdaptor (zmq::context_t & aContext, const Profile & profile)
+	  : SocketAdaptor { aContext } // forward constructor
+	{
+	  profile.applyTo (*this);
+	}
+
 	// .............................................................
 	/// Destructor. Clean up.
 	// .............................................................
@@ -257,6 +438,117 @@ namespace zmqHelper {
 	  return theZmqSocket.connected();
 	}
 
+	// .............................................................
+	/// Watch the connections of this socket (call it before
+	/// bind / connect). Events come from zmq over an inproc PAIR.
+	/// Note: inproc connections raise no events (tcp, ipc do).
+	// .............................................................
+	void monitor () {
+	  checkThreadIdentity ();
+
+	  if ( theMonitor ) {
+		return;
+	  }
+
+	  // (unique: a former one may still be closing)
+	  static std::atomic<unsigned long> monitors {0};
+	  std::string url = "inproc://zmqHelper-monitor-" + std::to_string (ZMQ_SOCKET_TYPE)
+		+ "-" + std::to_string (++monitors);
+	  if ( zmq_socket_monitor (static_cast<void *> (theZmqSocket), url.c_str (), ZMQ_EVENT_ALL) != 0 ) {
+		throw zmq::error_t {};
+	  }
+
+	  theMonitor.reset ( new ZmqSocketType {theContext, ZMQ_PAIR} );
+	  theMonitor->connect (url.c_str ());
+	}
+
+	// .............................................................
+	/// Next event of the monitor (keeps count of the peers).
+	/// @param event ZMQ_EVENT_CONNECTED, ZMQ_EVENT_ACCEPTED,
+	/// ZMQ_EVENT_DISCONNECTED, ZMQ_EVENT_HANDSHAKE_SUCCEEDED ...
+	/// @param address the endpoint of the event
+	/// @param time timeout in ms (-1 = blocking)
+	/// @return false if there was none (in time)
+	// .............................................................
+	bool receiveEvent (int & event, std::string & address, long time = 0) {
+	  checkThreadIdentity ();
+
+	  if ( ! theMonitor ) {
+		throw NotMonitoredException {};
+	  }
+
+	  if (! isDataWaiting (theMonitor.get (), time)) {
+		return false;
+	  }
+
+	  // frame 1: event (16 bits) and value (32 bits), frame 2: address
+	  zmq::message_t part;
+	  theMonitor->recv (&part);
+	  uint16_t id = 0;
+	  memcpy (&id, part.data (), sizeof (id));
+	  event = id;
+
+	  address.clear ();
+	  if ( hasMore (theMonitor.get ()) ) {
+		theMonitor->recv (&part);
+		address.assign (static_cast<const char *> (part.data ()), part.size ());
+	  }
+
+#ifdef ZMQ_EVENT_HANDSHAKE_SUCCEEDED
+	  if ( event == ZMQ_EVENT_HANDSHAKE_SUCCEEDED ) {
+		peers++;
+	  }
+#else
+	  if ( event == ZMQ_EVENT_CONNECTED || event == ZMQ_EVENT_ACCEPTED ) {
+		peers++;
+	  }
+#endif
+	  if ( event == ZMQ_EVENT_DISCONNECTED && peers > 0 ) {
+		peers--;
+	  }
+
+	  return true;
+	} // ()
+
+	// .............................................................
+	/// Wait until n peers are connected (handshake done), instead
+	/// of sleeping for a while "to let them join". Needs monitor().
+	/// On a PUB it does not mean subscribed: the subscription comes
+	/// after the handshake, so messages sent at once may still be
+	/// dropped (SubscriptionAwarePublisher::awaitSubscriber waits for
+	/// it).
+	/// @param time timeout in ms (-1 = forever)
+	/// @return false if timed out
+	// .............................................................
+	bool awaitPeers (int n, long time = -1) {
+	  auto end = std::chrono::steady_clock::now () + std::chrono::milliseconds (time);
+	  int event;
+	  std::string address;
+
+	  while ( peerCount () < n ) {
+		long left = -1;
+		if ( time >= 0 ) {
+		  left = std::chrono::duration_cast<std::chrono::milliseconds>
+			(end - std::chrono::steady_clock::now ()).count ();
+		  if ( left <= 0 ) {
+			return false;
+		  }
+		}
+		receiveEvent (event, address, left);
+	  }
+	  return true;
+	} // ()
+
+	// .............................................................
+	/// @return peers connected now. Needs monitor().
+	// .............................................................
+	int peerCount () {
+	  int event;
+	  std::string address;
+	  while ( receiveEvent (event, address, 0) ) { }
+	  return peers;
+	}
+
 	// .............................................................
 	/// subscribe (pub-sub patter,  ZMQ_SUB sockets)
 	// .............................................................
@@ -266,6 +558,36 @@ namespace zmqHelper {
 	  theZmqSocket.setsockopt(ZMQ_SUBSCRIBE, filter.c_str(), filter.size());
 	}
 
+	// .............................................................
+	/// Set an option (see zmqHelperOptions.hpp), f.ex.
+	///    socket.set<option::SendHwm> (1000);
+	/// It does not compile if the option makes no sense for
+	/// this type of socket. (Most options apply only to the
+	/// bind / connect made after).
+	// .............................................................
+	template<typename Option>
+	void set (const typename Option::value_type & value) {
+	  static_assert (Option::validFor (ZMQ_SOCKET_TYPE),
+					 "this option is not valid for this type of socket");
+	  checkThreadIdentity ();
+
+	  setOption (Option::id, value);
+	}
+
+	// .............................................................
+	/// Get an option (see zmqHelperOptions.hpp)
+	// .............................................................
+	template<typename Option>
+	typename Option::value_type get () {
+	  static_assert (Option::validFor (ZMQ_SOCKET_TYPE),
+					 "this option is not valid for this type of socket");
+	  checkThreadIdentity ();
+
+	  typename Option::value_type value {};
+	  getOption (Option::id, value);
+	  return value;
+	}
+
 	// .............................................................
 	/// Send a multipart text message
 	/// @param msgs The lines of text to send out.
@@ -281,7 +603,7 @@ namespace zmqHelper {
 
 	  unsigned int many = msgs.size ();
 	  unsigned int i=1;
-	  for (auto msg : msgs) {
+	  for (const auto & msg : msgs) {
 		zmq::message_t reply (msg.size());
 		memcpy ((void *) reply.data (), msg.c_str(), msg.size());
 		
@@ -293,10 +615,26 @@ namespace zmqHelper {
 
 	} // ()
 
+	// .............................................................
+	/// Store the i-th part of a message in out, reusing the string
+	/// already there (and its capacity) if any: a vector reused from
+	/// message to message does not allocate again in the steady state.
+	// .............................................................
+	template<typename StringVector>
+	static void storePart (StringVector & out, unsigned int i, const zmq::message_t & part) {
+	  if ( i == out.size () ) {
+		out.emplace_back ();
+	  }
+	  out[i].assign ( (const char*) part.data(), part.size() );
+	}
+
 	// .............................................................
 	/// Receive a multipart (also a single part) text message. (blocking)
+	/// (out: a std::vector<std::string>, or any vector of strings
+	/// alike, f.ex. std::pmr::vector<std::pmr::string>)
 	// .............................................................
-	bool receiveText (std::vector<std::string> & out) {
+	template<typename StringVector>
+	bool receiveText (StringVector & out) {
 	  // std::cerr << " \t\t\t\t\t\t\t receiveText called \n";
 	  return receiveTextInTimeout (out, -1);
 	}
@@ -304,31 +642,253 @@ namespace zmqHelper {
 	// .............................................................
 	/// Receive a  multipart with timeout
 	// .............................................................
-	bool receiveTextInTimeout (std::vector<std::string> & out, long time) {
+	template<typename StringVector>
+	bool receiveTextInTimeout (StringVector & out, long time) {
 
 	  checkThreadIdentity (); 
 
-	  out.clear ();
-
 	  if (! isDataWaiting (& theZmqSocket, time)) {
+		out.clear ();
 		return false;
 	  }
 		
+	  zmq::message_t reply;
+	  unsigned int i = 0;
 	  do {
-		zmq::message_t reply;
 		theZmqSocket.recv (&reply); // this blocks as well, but it makes the program to abort
 		// if a different thread closes the socket
 		
-		// char buff[100];
-		// memcpy (buff, reply.data(), reply.size());
-		out.push_back ( std::string { (char*) reply.data(), reply.size() } );
+		storePart (out, i, reply);
+		i++;
 		
 	  } while ( hasMore( & theZmqSocket ) );
 
+	  out.resize (i);
+
 	  return true;
 	
 	} // ()
 
+	// .............................................................
+	/// Non-blocking receive of a multipart message.
+	/// @return false (and out empty) if nothing was waiting.
+	// .............................................................
+	template<typename StringVector>
+	bool tryReceiveText (StringVector & out) {
+
+	  checkThreadIdentity ();
+
+	  zmq::message_t reply;
+	  if ( ! theZmqSocket.recv (&reply, ZMQ_DONTWAIT) ) {
+		out.clear ();
+		return false;
+	  }
+
+	  // once the first part is here, the rest of them are here too
+	  storePart (out, 0, reply);
+	  unsigned int i = 1;
+	  while ( hasMore( & theZmqSocket ) ) {
+		theZmqSocket.recv (&reply);
+		storePart (out, i, reply);
+		i++;
+	  }
+	  out.resize (i);
+
+	  return true;
+	} // ()
+
+	// .............................................................
+	/// Non-blocking send of a multipart message.
+	/// @return false (and nothing sent) if the socket can't take it now.
+	// .............................................................
+	bool trySendText (const std::vector<std::string> & msgs) {
+
+	  checkThreadIdentity ();
+
+	  unsigned int many = msgs.size ();
+	  unsigned int i=1;
+	  for (const auto & msg : msgs) {
+		zmq::message_t reply (msg.size());
+		memcpy ((void *) reply.data (), msg.c_str(), msg.size());
+
+		int more = i<many ? ZMQ_SNDMORE : 0;
+		// zmq accepts the whole multipart message or nothing:
+		// only the first part may be refused
+		if ( ! theZmqSocket.send (reply, more | ZMQ_DONTWAIT) ) {
+		  assert (i == 1);
+		  return false;
+		}
+		i++;
+	  }
+
+	  return true;
+	} // ()
+
+	// .............................................................
+	/// ROUTER only. Receive a message split in identity
+	/// and body, without copying the frames into strings.
+	/// env is reused: its frames are rebuilt, not reallocated.
+	/// @param time timeout in ms (-1 = blocking)
+	// .............................................................
+	bool receiveEnvelope (RouterEnvelope & env, long time = -1) {
+	  static_assert (ZMQ_SOCKET_TYPE == ZMQ_ROUTER, "receiveEnvelope() is for ROUTER sockets");
+
+	  checkThreadIdentity ();
+
+	  if (! isDataWaiting (& theZmqSocket, time)) {
+		return false;
+	  }
+
+	  theZmqSocket.recv (&env.identity);
+
+	  env.delimited = false;
+	  bool first = true;
+	  unsigned int i = 0;
+	  while ( hasMore( & theZmqSocket ) ) {
+		if ( i == env.body.size () ) {
+		  env.body.emplace_back ();
+		} else {
+		  env.body[i].rebuild ();
+		}
+		theZmqSocket.recv (&env.body[i]);
+
+		if ( first && env.body[i].size () == 0 ) {
+		  // the delimiter: not kept
+		  env.delimited = true;
+		} else {
+		  i++;
+		}
+		first = false;
+	  }
+
+	  env.body.resize (i);
+
+	  return true;
+	} // ()
+
+	// .............................................................
+	/// ROUTER only. Send body to the peer with this identity
+	/// (raw bytes). With delimited, an empty frame goes before
+	/// the body (needed by REQ peers).
+	// .............................................................
+	void sendTo (const void * identity, size_t size,
+				 const std::vector<std::string> & body, bool delimited = true) {
+	  static_assert (ZMQ_SOCKET_TYPE == ZMQ_ROUTER, "sendTo() is for ROUTER sockets");
+
+	  checkThreadIdentity ();
+
+	  if ( ! canSendData (&theZmqSocket) ) throw CantSendDataException {};
+
+	  zmq::message_t id (size);
+	  memcpy (id.data (), identity, size);
+	  theZmqSocket.send (id, body.empty () && !delimited ? 0 : ZMQ_SNDMORE);
+
+	  sendRouteRest (body, delimited);
+	} // ()
+
+	// .............................................................
+	/// ROUTER only. Send body to the peer with this identity.
+	// .............................................................
+	void sendTo (const std::string & identity,
+				 const std::vector<std::string> & body, bool delimited = true) {
+	  sendTo (identity.data (), identity.size (), body, delimited);
+	} // ()
+
+	// .............................................................
+	/// ROUTER only. Reply to the sender of env (the identity
+	/// frame is shared, not copied).
+	// .............................................................
+	void reply (const RouterEnvelope & env, const std::vector<std::string> & body) {
+	  static_assert (ZMQ_SOCKET_TYPE == ZMQ_ROUTER, "reply() is for ROUTER sockets");
+
+	  checkThreadIdentity ();
+
+	  if ( ! canSendData (&theZmqSocket) ) throw CantSendDataException {};
+
+	  zmq::message_t id;
+	  id.copy (&env.identity);
+	  theZmqSocket.send (id, body.empty () && !env.delimited ? 0 : ZMQ_SNDMORE);
+
+	  sendRouteRest (body, env.delimited);
+	} // ()
+
+	// .............................................................
+	/// Send a multipart message made of zmq frames, without copying
+	/// them (their content is handed to zmq: frames are left empty).
+	// .............................................................
+	void sendFrames (std::vector<zmq::message_t> & frames) {
+
+	  checkThreadIdentity ();
+
+	  if ( ! canSendData (&theZmqSocket) ) throw CantSendDataException {};
+
+	  unsigned int many = frames.size ();
+	  for (unsigned int i=0; i<many; i++) {
+		int more = i+1<many ? ZMQ_SNDMORE : 0;
+		theZmqSocket.send (frames[i], more);
+	  }
+
+	} // ()
+
+	// .............................................................
+	/// Receive a multipart message as zmq frames (no copy to strings).
+	/// out is reused: its frames are rebuilt, not reallocated.
+	/// @param time timeout in ms (-1 = blocking)
+	// .............................................................
+	bool receiveFrames (std::vector<zmq::message_t> & out, long time = -1) {
+
+	  checkThreadIdentity ();
+
+	  if (! isDataWaiting (& theZmqSocket, time)) {
+		out.clear ();
+		return false;
+	  }
+
+	  unsigned int i = 0;
+	  do {
+		if ( i == out.size () ) {
+		  out.emplace_back ();
+		} else {
+		  out[i].rebuild ();
+		}
+		theZmqSocket.recv (&out[i]);
+		i++;
+	  } while ( hasMore( & theZmqSocket ) );
+
+	  out.resize (i);
+
+	  return true;
+
+	} // ()
+
+	// .............................................................
+	/// @return ZMQ_EVENTS of the socket (ZMQ_POLLIN | ZMQ_POLLOUT bits)
+	/// Note: reading it may reset the (edge-triggered) notification
+	/// of the ZMQ_FD descriptor. Always check it before waiting on the fd.
+	// .............................................................
+	int getEvents () {
+	  checkThreadIdentity ();
+
+	  int events = 0;
+	  size_t size = sizeof (events);
+	  theZmqSocket.getsockopt (ZMQ_EVENTS, &events, &size);
+	  return events;
+	} // ()
+
+	// .............................................................
+	/// @return the ZMQ_FD descriptor of the socket, to wait on it
+	/// in a foreign event loop (it signals edge-triggered that
+	/// getEvents() must be checked again).
+	// .............................................................
+	int getFileDescriptor () {
+	  checkThreadIdentity ();
+
+	  int fd = -1;
+	  size_t size = sizeof (fd);
+	  theZmqSocket.getsockopt (ZMQ_FD, &fd, &size);
+	  return fd;
+	} // ()
+
 	// .............................................................
 	/// Close the socket 
 	// .............................................................
@@ -338,6 +898,12 @@ namespace zmqHelper {
 	  // if owner of the socket
 	  checkThreadIdentity (); 
 
+	  if ( theMonitor ) {
+		zmq_socket_monitor (static_cast<void *> (theZmqSocket), nullptr, 0);
+		theMonitor->close ();
+		theMonitor.reset ();
+	  }
+
 	  //
 	  // close 
 	  //
@@ -0,0 +1,459 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperCache.hpp
+ *
+ * ResponseCache: a Proxy stage (ROUTER frontend, DEALER backend)
+ * caching the replies to repeated read requests:
+ *
+ *    Proxy< ZMQ_ROUTER, ZMQ_DEALER > proxy {frontend, backend};
+ *    ResponseCache cache {1024, 16*1024*1024, 1000};
+ *    proxy.addStage (cache);
+ *
+ * Only requests whose body starts with a cache header frame
+ * (cacheHeader (ttl)) are cached:
+ *
+ *    requester.sendText ( { cacheHeader (500), "GET", "key" } );
+ *
+ * The key is the rest of the body (its frames). Then:
+ *
+ *  - hit: answered by the broker, not forwarded.
+ *  - miss: forwarded (without the header). Identical requests
+ *    arriving meanwhile wait for that same reply (single flight:
+ *    the backend sees it once) and all of them get it.
+ *
+ * Replies are kept for their TTL. Memory is bounded (entries and
+ * bytes): entries are evicted by CLOCK (second chance).
+ *
+ * For the single flight, a forwarded miss carries a flight tag
+ * instead of the client route; REP workers give it back as the
+ * rest of the envelope. A flight not answered in time (5 s by
+ * default) fails: its requesters get FLIGHT_TIMEOUT_REPLY, and a
+ * late reply is dropped.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_CACHE_H
+#define ZQM_HELPER_CACHE_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+
+#include "zmqHelperProxy.hpp"
+#include "zmqHelperIdentityMap.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// The header frame is CACHE_TAG followed by the TTL in ms
+  /// (in decimal; nothing: the default TTL of the cache)
+  // -----------------------------------------------------------------
+  const char CACHE_TAG[] = "cache=";
+
+  // -----------------------------------------------------------------
+  /// @return the header frame text to mark a request cacheable
+  // -----------------------------------------------------------------
+  inline std::string cacheHeader (long ttl = 0) {
+	return ttl > 0 ? CACHE_TAG + std::to_string (ttl) : std::string {CACHE_TAG};
+  } // ()
+
+  // -----------------------------------------------------------------
+  /// Frame put by the cache in place of the route of a miss
+  // -----------------------------------------------------------------
+  const char FLIGHT_TAG[] = "#flight=";
+
+  // -----------------------------------------------------------------
+  /// Reply body for the requests of a flight the backend did not
+  /// answer in time
+  // -----------------------------------------------------------------
+  const char FLIGHT_TIMEOUT_REPLY[] = "FLIGHT_TIMEOUT";
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The ResponseCache class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class ResponseCache : public ProxyStage {
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	struct Entry {
+	  bool filled = false;     // false: its request is in flight
+	  bool referenced = false; // CLOCK bit
+	  long long expires = 0;
+	  long ttl = 0;
+	  size_t slot = 0;         // in the ring
+	  size_t bytes = 0;
+	  std::vector<zmq::message_t> reply;
+	  Messages waiters;        // routes (with delimiter) of the requesters
+	};
+
+	// .............................................................
+	// .............................................................
+	const size_t maxBytes;
+	const long defaultTtl;
+
+	// .............................................................
+	// .............................................................
+	struct Slot {
+	  bool used = false;
+	  std::string key;
+	};
+
+	// .............................................................
+	// .............................................................
+	struct Flight {
+	  std::string key;
+	  long long expires;
+	};
+
+	IdentityMap<Entry> entries;
+	std::vector<Slot> ring;
+	size_t hand = 0;
+	size_t bytes = 0;
+
+	// by number: the oldest (first to expire) first
+	std::map<unsigned long, Flight> flights;
+	unsigned long lastFlight = 0;
+	long flightTimeout = 5000;
+
+	std::string key; // reused
+
+	// .............................................................
+	// .............................................................
+	unsigned long hits = 0;
+	unsigned long misses = 0;
+	unsigned long coalesced = 0;
+	unsigned long evictions = 0;
+	unsigned long failedFlights = 0;
+
+	// .............................................................
+	// .............................................................
+	static long long nowMs () {
+	  return std::chrono::duration_cast<std::chrono::milliseconds>
+		(std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+	}
+
+	// .............................................................
+	/// key: the frames from..end, each one preceded by its size
+	// .............................................................
+	void makeKey (const std::vector<zmq::message_t> & frames, size_t from) {
+	  key.clear ();
+	  for (size_t i=from; i<frames.size (); i++) {
+		uint32_t size = frames[i].size ();
+		key.append (reinterpret_cast<const char *> (&size), sizeof (size));
+		key.append (static_cast<const char *> (frames[i].data ()), size);
+	  }
+	}
+
+	// .............................................................
+	/// The entry at ring slot i goes away.
+	// .............................................................
+	void evict (size_t i) {
+	  const std::string & k = ring[i].key;
+	  Entry * e = entries.find (k.data (), k.size ());
+	  bytes -= e->bytes;
+	  entries.erase (k.data (), k.size ());
+	  ring[i].used = false;
+	  ring[i].key.clear ();
+	  evictions++;
+	}
+
+	// .............................................................
+	/// Move the CLOCK hand until a free slot (if wantFree) or
+	/// a victim (evicted) is found. Entries in flight stay.
+	/// @return the slot, or ring.size() if none
+	// .............................................................
+	size_t sweep (bool wantFree) {
+	  long long now = nowMs ();
+	  for (size_t k=0; k < 2*ring.size (); k++) {
+		size_t i = hand;
+		hand = (hand + 1) % ring.size ();
+
+		if ( ! ring[i].used ) {
+		  if ( wantFree ) {
+			return i;
+		  }
+		  continue;
+		}
+
+		Entry * e = entries.find (ring[i].key.data (), ring[i].key.size ());
+		if ( ! e->filled ) {
+		  continue;
+		}
+		if ( e->referenced && e->expires >= now ) {
+		  e->referenced = false; // second chance
+		  continue;
+		}
+		evict (i);
+		return i;
+	  }
+	  return ring.size ();
+	}
+
+	// .............................................................
+	/// A message for the frontend: route + copies of the reply
+	// .............................................................
+	static void answer (Messages & toFrontend, std::vector<zmq::message_t> & route,
+						std::vector<zmq::message_t> & reply) {
+	  toFrontend.emplace_back ();
+	  std::vector<zmq::message_t> & m = toFrontend.back ();
+	  for (auto & f : route) {
+		m.push_back ( std::move (f) );
+	  }
+	  for (auto & f : reply) {
+		m.emplace_back ();
+		m.back().copy (&f); // reference counted, not copied
+	  }
+	}
+
+	// .............................................................
+	/// Move the route and delimiter (frames before b) of message.
+	// .............................................................
+	static void takeRoute (std::vector<zmq::message_t> & message, size_t b,
+						   std::vector<zmq::message_t> & route) {
+	  route.clear ();
+	  for (size_t i=0; i<b; i++) {
+		route.push_back ( std::move (message[i]) );
+	  }
+	}
+
+	// .............................................................
+	/// Fail the flights not answered in time: their requesters get
+	/// FLIGHT_TIMEOUT_REPLY, the entry goes away.
+	// .............................................................
+	void expireFlights (Messages & toFrontend) {
+	  long long now = nowMs ();
+	  while ( ! flights.empty () && flights.begin()->second.expires < now ) {
+		key.swap (flights.begin()->second.key);
+		flights.erase (flights.begin ());
+
+		Entry * e = entries.find (key.data (), key.size ());
+		if ( e == nullptr || e->filled ) {
+		  continue;
+		}
+		std::vector<zmq::message_t> reply;
+		reply.push_back ( textFrame (FLIGHT_TIMEOUT_REPLY) );
+		for (auto & route : e->waiters) {
+		  answer (toFrontend, route, reply);
+		}
+		ring[e->slot].used = false;
+		ring[e->slot].key.clear ();
+		entries.erase (key.data (), key.size ());
+		failedFlights++;
+	  }
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param maxEntries entries kept at most
+	/// @param maxBytes_ bytes (keys and replies) kept at most
+	/// @param defaultTtl_ ms, for headers without TTL
+	// .............................................................
+	ResponseCache (size_t maxEntries = 1024,
+				   size_t maxBytes_ = 16*1024*1024,
+				   long defaultTtl_ = 1000)
+	  : maxBytes {maxBytes_}, defaultTtl {defaultTtl_},
+		entries {maxEntries}, ring (maxEntries)
+	{ }
+
+	// .............................................................
+	/// A miss forwarded and not answered in ms fails.
+	/// (By default, 5000).
+	// .............................................................
+	void setFlightTimeout (long ms) {
+	  flightTimeout = ms;
+	}
+
+	// .............................................................
+	// .............................................................
+	bool fromFrontend (std::vector<zmq::message_t> & message,
+					   Messages & toFrontend) override {
+
+	  size_t b = bodyStart (message);
+	  long long ttl = 0;
+	  if ( b >= message.size () ) {
+		return true; // not cacheable
+	  }
+	  if ( frameIs (message[b], CACHE_TAG) ) {
+		ttl = defaultTtl; // (a bare tag)
+	  } else if ( ! taggedNumber (message[b], CACHE_TAG, ttl) ) {
+		return true; // not cacheable (or a malformed TTL)
+	  }
+	  if ( ttl <= 0 ) {
+		ttl = defaultTtl;
+	  }
+
+	  expireFlights (toFrontend); // (not to wait for a failed one)
+
+	  makeKey (message, b+1);
+	  Entry * e = entries.find (key.data (), key.size ());
+
+	  //
+	  // hit
+	  //
+	  if ( e != nullptr && e->filled && e->expires >= nowMs () ) {
+		hits++;
+		e->referenced = true;
+		std::vector<zmq::message_t> route;
+		takeRoute (message, b, route);
+		answer (toFrontend, route, e->reply);
+		return false;
+	  }
+
+	  //
+	  // same request in flight: wait for its reply
+	  //
+	  if ( e != nullptr && ! e->filled ) {
+		coalesced++;
+		e->waiters.emplace_back ();
+		takeRoute (message, b, e->waiters.back ());
+		return false;
+	  }
+
+	  //
+	  // miss (or expired)
+	  //
+	  misses++;
+	  if ( e == nullptr ) {
+		size_t slot = sweep (true);
+		if ( slot == ring.size () ) {
+		  // everything in flight: forward it, not cached
+		  message.erase (message.begin () + b);
+		  return true;
+		}
+		ring[slot].used = true;
+		ring[slot].key = key;
+		e = & entries.findOrInsert (key);
+		e->slot = slot;
+	  } else {
+		bytes -= e->bytes;
+		e->bytes = 0;
+		e->reply.clear ();
+	  }
+
+	  e->filled = false;
+	  e->ttl = ttl;
+	  e->waiters.clear ();
+	  e->waiters.emplace_back ();
+	  takeRoute (message, b, e->waiters.back ());
+
+	  lastFlight++;
+	  flights[lastFlight] = Flight {key, nowMs () + flightTimeout};
+
+	  // flight tag, "", body (without the header)
+	  message.erase (message.begin (), message.begin () + b);
+	  message[0] = textFrame (FLIGHT_TAG + std::to_string (lastFlight));
+	  message.insert (message.begin () + 1, zmq::message_t {});
+	  return true;
+	}
+
+	// .............................................................
+	// .............................................................
+	bool fromBackend (std::vector<zmq::message_t> & message,
+					  Messages & toFrontend) override {
+
+	  long long flight = 0;
+	  if ( message.empty () || ! taggedNumber (message[0], FLIGHT_TAG, flight) ) {
+		return true; // not ours
+	  }
+
+	  auto it = flights.find (flight);
+	  if ( it == flights.end () ) {
+		return false;
+	  }
+	  key.swap (it->second.key);
+	  flights.erase (it);
+
+	  Entry * e = entries.find (key.data (), key.size ());
+	  if ( e == nullptr ) {
+		return false;
+	  }
+
+	  // the reply body
+	  size_t b = bodyStart (message);
+	  std::vector<zmq::message_t> reply;
+	  size_t size = key.size ();
+	  for (size_t i=b; i<message.size (); i++) {
+		size += message[i].size ();
+		reply.push_back ( std::move (message[i]) );
+	  }
+
+	  for (auto & route : e->waiters) {
+		answer (toFrontend, route, reply);
+	  }
+	  e->waiters.clear ();
+
+	  if ( size > maxBytes ) {
+		// too big to be kept
+		ring[e->slot].used = false;
+		ring[e->slot].key.clear ();
+		entries.erase (key.data (), key.size ());
+		return false;
+	  }
+
+	  e->filled = true;
+	  e->referenced = true;
+	  e->expires = nowMs () + e->ttl;
+	  e->reply.swap (reply);
+	  e->bytes = size;
+	  bytes += size;
+
+	  while ( bytes > maxBytes && sweep (false) != ring.size () ) { }
+
+	  return false;
+	}
+
+	// .............................................................
+	// .............................................................
+	long timerDue () override {
+	  if ( flights.empty () ) {
+		return -1;
+	  }
+	  return (long) std::max (0LL, flights.begin()->second.expires - nowMs ());
+	}
+
+	// .............................................................
+	// .............................................................
+	void onTimer (Messages & toBackend, Messages & toFrontend) override {
+	  (void) toBackend;
+	  expireFlights (toFrontend);
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned long hitCount () const { return hits; }
+	unsigned long missCount () const { return misses; }
+	unsigned long coalescedCount () const { return coalesced; }
+	unsigned long evictionCount () const { return evictions; }
+	unsigned long failedFlightCount () const { return failedFlights; }
+
+	// .............................................................
+	/// @return entries kept (or in flight)
+	// .............................................................
+	size_t size () const { return entries.size (); }
+
+	// .............................................................
+	/// @return bytes kept (keys and replies)
+	// .............................................................
+	size_t byteCount () const { return bytes; }
+
+  }; // class
+
+}; // namespace
+
+#endif
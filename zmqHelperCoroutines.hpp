@@ -0,0 +1,482 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperCoroutines.hpp
+ *
+ * Optional C++20 coroutine layer on top of zmqHelper.hpp:
+ *
+ *      co_await sock.receive ()  /  co_await sock.send (frames)
+ *
+ * suspend the calling coroutine until the socket is ready.
+ * One Executor multiplexes many coroutines and many sockets
+ * on the single thread calling Executor::run(), waiting on
+ * the ZMQ_FD descriptors of the sockets (and checking ZMQ_EVENTS,
+ * as those descriptors are edge-triggered).
+ *
+ * Features C++20 (compile with -std=c++20)
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_COROUTINES_H
+#define ZQM_HELPER_COROUTINES_H
+
+#if __cplusplus < 202002L
+#error "zmqHelperCoroutines.hpp requires C++20 (-std=c++20)"
+#endif
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <coroutine>
+#include <exception>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  class Executor;
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// Task: the return type of the coroutines run by an Executor.
+  /// It starts suspended: hand it to Executor::spawn().
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class Task {
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	struct promise_type {
+
+	  std::exception_ptr error = nullptr;
+
+	  Task get_return_object () {
+		return Task { std::coroutine_handle<promise_type>::from_promise (*this) };
+	  }
+	  std::suspend_always initial_suspend () noexcept { return {}; }
+	  std::suspend_always final_suspend () noexcept { return {}; }
+	  void return_void () { }
+	  void unhandled_exception () { error = std::current_exception (); }
+	};
+
+	using HandleType = std::coroutine_handle<promise_type>;
+
+  private:
+
+	HandleType theHandle;
+
+	Task (const Task & o) = delete;
+	Task & operator=(const Task & o) = delete;
+
+	explicit Task (HandleType h) : theHandle {h} { }
+
+	friend class Executor;
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	Task (Task && o) : theHandle {o.theHandle} {
+	  o.theHandle = nullptr;
+	}
+
+	// .............................................................
+	/// A task never given to an Executor is destroyed here.
+	// .............................................................
+	~Task () {
+	  if (theHandle) {
+		theHandle.destroy ();
+	  }
+	}
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// A suspended operation (a receive or a send) waiting for
+  /// its socket to become ready.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class SocketWaiter {
+
+  public:
+
+	ZmqSocketType * socket = nullptr;
+	std::coroutine_handle<> handle = nullptr;
+
+	// .............................................................
+	/// Try to complete the operation without blocking.
+	/// @return true if done (then the coroutine is resumed).
+	// .............................................................
+	virtual bool tryComplete () = 0;
+
+	virtual ~SocketWaiter () { }
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The Executor: runs coroutines (Task) on the thread calling run().
+  /// Sockets used by the coroutines must be owned by that
+  /// same thread (i.e. created by it), as SocketAdaptor checks.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class Executor {
+
+  private:
+
+	// .............................................................
+	/// Per socket: its fd and the operations waiting on it (FIFO)
+	// .............................................................
+	struct SocketEntry {
+	  int fd = -1;
+	  bool dirty = false;
+	  std::deque<SocketWaiter *> waiters;
+	};
+
+	std::unordered_map<ZmqSocketType *, SocketEntry> theSockets;
+
+	// .............................................................
+	/// Sockets whose ZMQ_EVENTS must be checked again
+	/// (new waiter, fd fired, or the socket was just used).
+	// .............................................................
+	std::vector<ZmqSocketType *> dirtySockets;
+
+	std::deque<std::coroutine_handle<>> readyQueue;
+
+	std::unordered_set<void *> liveTasks;
+
+	// .............................................................
+	// .............................................................
+	Executor (const Executor & o) = delete;
+	Executor & operator=(const Executor & o) = delete;
+
+	// .............................................................
+	// .............................................................
+	void markDirty (SocketEntry & entry, ZmqSocketType * socket) {
+	  if (entry.dirty) {
+		return;
+	  }
+	  entry.dirty = true;
+	  dirtySockets.push_back (socket);
+	}
+
+	// .............................................................
+	/// Resume what is ready. Finished tasks are destroyed here.
+	// .............................................................
+	void runReadyCoroutines () {
+	  while ( ! readyQueue.empty () ) {
+		auto h = readyQueue.front ();
+		readyQueue.pop_front ();
+
+		h.resume ();
+
+		if ( h.done () ) {
+		  auto th = Task::HandleType::from_address (h.address ());
+		  std::exception_ptr error = th.promise().error;
+		  liveTasks.erase (h.address ());
+		  th.destroy ();
+		  if (error) {
+			std::rethrow_exception (error);
+		  }
+		}
+	  } // while
+	}
+
+	// .............................................................
+	/// Complete the waiting operations whose sockets are ready now.
+	/// @return true if some coroutine became ready.
+	// .............................................................
+	bool completeWaiters () {
+	  bool progress = false;
+
+	  std::vector<ZmqSocketType *> toCheck;
+	  toCheck.swap (dirtySockets);
+
+	  for (auto socket : toCheck) {
+		auto it = theSockets.find (socket);
+		if ( it == theSockets.end () ) {
+		  continue;
+		}
+		SocketEntry & entry = it->second;
+		entry.dirty = false;
+
+		// try the waiters in arrival order (a receive may fail
+		// while a send on the same socket goes on)
+		auto & waiters = entry.waiters;
+		for (auto w = waiters.begin (); w != waiters.end (); ) {
+		  if ( (*w)->tryComplete () ) {
+			readyQueue.push_back ( (*w)->handle );
+			w = waiters.erase (w);
+			progress = true;
+		  } else {
+			++w;
+		  }
+		}
+
+		if ( waiters.empty () ) {
+		  theSockets.erase (it);
+		}
+	  } // for
+
+	  return progress;
+	}
+
+	// .............................................................
+	/// Block until some fd of a socket with waiters fires.
+	// .............................................................
+	void waitForSockets () {
+	  std::vector<zmq::pollitem_t> items;
+	  std::vector<ZmqSocketType *> sockets;
+	  items.reserve (theSockets.size ());
+	  sockets.reserve (theSockets.size ());
+
+	  for (auto & p : theSockets) {
+		items.push_back ( { nullptr, p.second.fd, ZMQ_POLLIN, 0 } );
+		sockets.push_back (p.first);
+	  }
+
+	  zmq::poll ( &items[0], items.size (), -1 );
+
+	  for (unsigned int i=0; i<items.size (); i++) {
+		if ( items[i].revents != 0 ) {
+		  markDirty (theSockets[sockets[i]], sockets[i]);
+		}
+	  }
+	}
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	Executor () { }
+
+	// .............................................................
+	/// Destructor. Unfinished coroutines are destroyed.
+	// .............................................................
+	~Executor () {
+	  theSockets.clear ();
+	  for (auto addr : liveTasks) {
+		Task::HandleType::from_address (addr).destroy ();
+	  }
+	}
+
+	// .............................................................
+	/// Hand a coroutine to the executor. It will start in run().
+	// .............................................................
+	void spawn (Task && t) {
+	  auto h = t.theHandle;
+	  t.theHandle = nullptr;
+	  liveTasks.insert (h.address ());
+	  readyQueue.push_back (h);
+	}
+
+	// .............................................................
+	/// Register a suspended operation (called by the awaitables).
+	// .............................................................
+	void suspend (SocketWaiter * w, int fd) {
+	  SocketEntry & entry = theSockets[w->socket];
+	  entry.fd = fd;
+	  entry.waiters.push_back (w);
+	  markDirty (entry, w->socket);
+	}
+
+	// .............................................................
+	/// Note that the socket has been used, so its ZMQ_FD
+	/// may not fire again for the ones waiting on it.
+	// .............................................................
+	void touch (ZmqSocketType * socket) {
+	  auto it = theSockets.find (socket);
+	  if ( it != theSockets.end () ) {
+		markDirty (it->second, socket);
+	  }
+	}
+
+	// .............................................................
+	/// Run the coroutines until all of them are finished, or the
+	/// ones left wait for nothing that can wake them (a deadlock:
+	/// they stay suspended until the executor is destroyed).
+	/// An exception escaping a coroutine is rethrown here.
+	/// @return coroutines left suspended (0: all finished)
+	// .............................................................
+	size_t run () {
+	  while ( ! liveTasks.empty () ) {
+
+		runReadyCoroutines ();
+
+		if ( liveTasks.empty () ) {
+		  break;
+		}
+
+		if ( completeWaiters () ) {
+		  continue;
+		}
+
+		if ( ! dirtySockets.empty () ) {
+		  continue;
+		}
+
+		if ( theSockets.empty () ) {
+		  // live tasks, but nobody ready and nobody waiting
+		  // on a socket: they are waiting for something else
+		  break;
+		}
+
+		waitForSockets ();
+	  } // while
+
+	  return liveTasks.size ();
+	}
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// CoSocket: a SocketAdaptor whose receive() and send()
+  /// are awaited from a coroutine run by an Executor.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  template<int ZMQ_SOCKET_TYPE>
+  class CoSocket {
+
+  public:
+
+	using SocketAdaptorType = SocketAdaptor<ZMQ_SOCKET_TYPE>;
+
+  private:
+
+	Executor & theExecutor;
+
+	SocketAdaptorType theSocketAdaptor;
+
+	int theFd = -1;
+
+	CoSocket (const CoSocket & o) = delete;
+	CoSocket & operator=(const CoSocket & o) = delete;
+
+	// .............................................................
+	// .............................................................
+	int fd () {
+	  if (theFd < 0) {
+		theFd = theSocketAdaptor.getFileDescriptor ();
+	  }
+	  return theFd;
+	}
+
+  public:
+
+	// .............................................................
+	/// Awaitable returned by receive()
+	// .............................................................
+	class ReceiveAwaitable : public SocketWaiter {
+	  CoSocket & cs;
+	  std::vector<std::string> lines;
+	public:
+	  explicit ReceiveAwaitable (CoSocket & c) : cs {c} { }
+	  bool tryComplete () override {
+		if ( ! cs.theSocketAdaptor.tryReceiveText (lines) ) {
+		  return false;
+		}
+		cs.theExecutor.touch (cs.getZmqSocket ());
+		return true;
+	  }
+	  bool await_ready () { return tryComplete (); }
+	  void await_suspend (std::coroutine_handle<> h) {
+		handle = h;
+		socket = cs.getZmqSocket ();
+		cs.theExecutor.suspend (this, cs.fd ());
+	  }
+	  std::vector<std::string> await_resume () { return std::move (lines); }
+	};
+
+	// .............................................................
+	/// Awaitable returned by send()
+	// .............................................................
+	class SendAwaitable : public SocketWaiter {
+	  CoSocket & cs;
+	  std::vector<std::string> lines;
+	public:
+	  SendAwaitable (CoSocket & c, std::vector<std::string> && l)
+		: cs {c}, lines {std::move (l)} { }
+	  bool tryComplete () override {
+		if ( ! cs.theSocketAdaptor.trySendText (lines) ) {
+		  return false;
+		}
+		cs.theExecutor.touch (cs.getZmqSocket ());
+		return true;
+	  }
+	  bool await_ready () { return tryComplete (); }
+	  void await_suspend (std::coroutine_handle<> h) {
+		handle = h;
+		socket = cs.getZmqSocket ();
+		cs.theExecutor.suspend (this, cs.fd ());
+	  }
+	  void await_resume () { }
+	};
+
+	// .............................................................
+	/// Constructor. (Use our own zmq::context_t).
+	// .............................................................
+	explicit CoSocket (Executor & ex)
+	  : theExecutor {ex}
+	{ }
+
+	// .............................................................
+	/// Constructor with a specific context (share one context
+	/// among many sockets, and for 'inproc').
+	// .............................................................
+	CoSocket (Executor & ex, zmq::context_t & aContext)
+	  : theExecutor {ex}, theSocketAdaptor {aContext}
+	{ }
+
+	// .............................................................
+	/// co_await sock.receive () -> std::vector<std::string>
+	// .............................................................
+	ReceiveAwaitable receive () {
+	  return ReceiveAwaitable {*this};
+	}
+
+	// .............................................................
+	/// co_await sock.send ( {"a", "b"} )
+	// .............................................................
+	SendAwaitable send (std::vector<std::string> lines) {
+	  return SendAwaitable {*this, std::move (lines)};
+	}
+
+	// .............................................................
+	/// The wrapped adaptor: bind(), connect(), subscribe() ...
+	// .............................................................
+	SocketAdaptorType & adaptor () {
+	  return theSocketAdaptor;
+	}
+
+	// .............................................................
+	// .............................................................
+	void bind (const std::string & url) { theSocketAdaptor.bind (url); }
+	void connect (const std::string & url) { theSocketAdaptor.connect (url); }
+
+	// .............................................................
+	// .............................................................
+	ZmqSocketType * getZmqSocket () {
+	  return theSocketAdaptor.getZmqSocket ();
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
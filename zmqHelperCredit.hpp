@@ -0,0 +1,684 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperCredit.hpp
+ *
+ * Credit-based dispatch between a broker and its workers.
+ *
+ *   clients (REQ/DEALER) -> ROUTER [CreditBroker] ROUTER <- workers (DEALER)
+ *
+ * Workers grant credits to the broker. The broker only sends a
+ * request to a worker while it holds credit from it; otherwise
+ * requests wait in the broker queue. Thus, the work in flight
+ * of each worker is bounded by its credit window, instead of
+ * piling up (up to the HWM) inside slow workers.
+ *
+ * Protocol (worker side, first frame = command):
+ *
+ *   worker -> broker:  "CREDIT", n                 (grant n credits)
+ *                      "REPLY", route..., "", body (and 1 credit back)
+ *                      "HEARTBEAT", n              (idle, with n credits)
+ *   broker -> worker:  "REQUEST", route..., "", body
+ *
+ * (route: the identity frames of the client, returned as got)
+ *
+ * Workers heartbeat while idle. A worker silent for longer than
+ * the worker expiry of the broker (3 s by default: more than any
+ * request takes) is taken as dead: its credit is dropped and its
+ * requests in flight are answered WORKER_LOST_REPLY. If it was
+ * only slow, its next heartbeat registers it again, and its late
+ * replies are ignored.
+ *
+ * The body may start with a deadline header (see zmqHelperDeadline.hpp):
+ * expired requests are dropped by the broker before dispatching them
+ * and by the worker before handling them, replying EXPIRED_REPLY.
+ * Both count them (shedCount()).
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_CREDIT_H
+#define ZQM_HELPER_CREDIT_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <deque>
+#include <functional>
+
+#include "zmqHelperDeadline.hpp"
+#include "zmqHelperIdentityMap.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// Reply body for the requests in flight to a worker taken as dead
+  // -----------------------------------------------------------------
+  const char WORKER_LOST_REPLY[] = "WORKER_LOST";
+
+  // -----------------------------------------------------------------
+  /// Credit a worker may hold (over it, grants are cut)
+  // -----------------------------------------------------------------
+  const long MAX_WORKER_CREDIT = 100000;
+
+  // -----------------------------------------------------------------
+  /// Interval of the sweeps of the queue for expired requests (while
+  /// there is no credit)
+  // -----------------------------------------------------------------
+  const long SHED_SWEEP_MS = 10;
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The CreditBroker class. It does not own the sockets: call
+  /// run() (or pollOnce()) from the thread owning them.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class CreditBroker {
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	struct WorkerState {
+	  long credits = 0;
+	  long inFlight = 0;
+	  long long expiry = 0; // ms (nowMs)
+	  /// routes of the requests in flight, oldest first
+	  std::deque< std::vector<zmq::message_t> > routes;
+	};
+
+	// .............................................................
+	// .............................................................
+	SocketAdaptor<ZMQ_ROUTER> & frontend;
+	SocketAdaptor<ZMQ_ROUTER> & backend;
+
+	IdentityMap<WorkerState> workers;
+	std::vector<std::string> workerOrder; // for round robin
+	unsigned int nextWorker = 0;
+
+	// requests waiting for credit: route..., "", body
+	std::deque< std::vector<zmq::message_t> > queue;
+
+	size_t inFlight = 0;
+	unsigned long dispatched = 0;
+	unsigned long shed = 0;
+	unsigned long lost = 0;
+	long shedMargin = 0;
+	long workerExpiry = 3000;
+	long long nextSweep = 0;
+	long long nextShedSweep = 0;
+
+	// reused from message to message
+	std::vector<zmq::message_t> frames;
+	std::vector<zmq::message_t> outgoing;
+
+	// .............................................................
+	// .............................................................
+	CreditBroker (const CreditBroker & o) = delete;
+	CreditBroker & operator=(const CreditBroker & o) = delete;
+
+	// .............................................................
+	/// @return a worker with credit (round robin), or nullptr
+	// .............................................................
+	const std::string * workerWithCredit () {
+	  for (unsigned int k=0; k<workerOrder.size (); k++) {
+		unsigned int i = (nextWorker + k) % workerOrder.size ();
+		WorkerState * w = workers.find (workerOrder[i].data (), workerOrder[i].size ());
+		if ( w->credits > 0 ) {
+		  nextWorker = (i + 1) % workerOrder.size ();
+		  return &workerOrder[i];
+		}
+	  }
+	  return nullptr;
+	}
+
+	// .............................................................
+	/// If the request has expired, reply EXPIRED_REPLY to its client.
+	/// @return true if expired (the request is left empty)
+	// .............................................................
+	bool shedIfExpired (std::vector<zmq::message_t> & request, long long now) {
+	  size_t b = bodyStart (request);
+	  if ( b >= request.size () || ! isExpired (request[b], now + shedMargin) ) {
+		return false;
+	  }
+
+	  // route..., "", EXPIRED_REPLY
+	  outgoing.clear ();
+	  for (size_t i=0; i<b; i++) {
+		outgoing.push_back ( std::move (request[i]) );
+	  }
+	  outgoing.push_back ( textFrame (EXPIRED_REPLY) );
+	  frontend.sendFrames (outgoing);
+
+	  request.clear ();
+	  shed++;
+	  return true;
+	}
+
+	// .............................................................
+	/// Shed the expired requests anywhere in the queue (deadlines
+	/// need not be in order), at most every SHED_SWEEP_MS.
+	// .............................................................
+	void shedQueued (long long now) {
+	  if ( now < nextShedSweep ) {
+		return;
+	  }
+	  nextShedSweep = now + SHED_SWEEP_MS;
+
+	  size_t kept = 0;
+	  for (size_t i=0; i<queue.size (); i++) {
+		if ( ! shedIfExpired (queue[i], now) ) {
+		  if ( kept != i ) {
+			queue[kept].swap (queue[i]);
+		  }
+		  kept++;
+		}
+	  }
+	  queue.resize (kept);
+	}
+
+	// .............................................................
+	/// Send queued requests while there is credit.
+	// .............................................................
+	void dispatch () {
+	  long long now = nowMs ();
+	  while ( ! queue.empty () ) {
+
+		// no credit spent on requests nobody waits for (and shed
+		// even if there is no credit: overload is when it matters)
+		if ( shedIfExpired (queue.front (), now) ) {
+		  queue.pop_front ();
+		  continue;
+		}
+
+		const std::string * id = workerWithCredit ();
+		if ( id == nullptr ) {
+		  shedQueued (now);
+		  return;
+		}
+
+		WorkerState * w = workers.find (id->data (), id->size ());
+		w->credits--;
+		w->inFlight++;
+		inFlight++;
+		dispatched++;
+
+		std::vector<zmq::message_t> & request = queue.front ();
+
+		// the route, to tell the reply (or answer if the worker dies)
+		w->routes.emplace_back ();
+		size_t b = bodyStart (request);
+		for (size_t i=0; i+1<b; i++) {
+		  w->routes.back().emplace_back ();
+		  w->routes.back().back().copy (&request[i]); // reference counted
+		}
+
+		outgoing.clear ();
+		outgoing.push_back ( textFrame (*id) );
+		outgoing.push_back ( textFrame ("REQUEST") );
+		for (auto & f : request) {
+		  outgoing.push_back ( std::move (f) );
+		}
+		backend.sendFrames (outgoing);
+
+		queue.pop_front ();
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	void fromClient () {
+	  frontend.receiveFrames (frames);
+
+	  if ( shedIfExpired (frames, nowMs ()) || ! acceptRequest (frames) ) {
+		return;
+	  }
+
+	  // whole message moved into the queue
+	  queue.emplace_back ();
+	  queue.back().swap (frames);
+	}
+
+	// .............................................................
+	/// @return the number in the frame, if it is a valid credit
+	/// (> 0), or 0
+	// .............................................................
+	static long creditOf (const zmq::message_t & frame) {
+	  long long n = 0;
+	  if ( ! frameNumber (frame, n) || n <= 0 ) {
+		return 0;
+	  }
+	  return (long) std::min (n, (long long) MAX_WORKER_CREDIT);
+	}
+
+	// .............................................................
+	/// Add credit to a worker (up to MAX_WORKER_CREDIT).
+	// .............................................................
+	static void grant (WorkerState & w, long n) {
+	  w.credits = std::min (w.credits + n, MAX_WORKER_CREDIT);
+	}
+
+	// .............................................................
+	/// Take out of the worker the request in flight with this route
+	/// (frames[from..] up to the delimiter).
+	/// @return false if it was not there (late, after the worker
+	/// was taken as dead)
+	// .............................................................
+	bool replied (WorkerState & w, const std::vector<zmq::message_t> & reply, size_t from) {
+	  size_t b = bodyStart (reply, from);
+	  if ( b <= from || reply[b-1].size () != 0 ) {
+		return false; // no delimiter
+	  }
+	  size_t length = b - 1 - from;
+	  for (auto it = w.routes.begin (); it != w.routes.end (); ++it) {
+		bool same = it->size () == length;
+		for (size_t i=0; same && i<length; i++) {
+		  same = (*it)[i].size () == reply[from+i].size ()
+			&& memcmp ((*it)[i].data (), reply[from+i].data (), reply[from+i].size ()) == 0;
+		}
+		if ( same ) {
+		  w.routes.erase (it);
+		  w.inFlight--;
+		  inFlight--;
+		  return true;
+		}
+	  }
+	  return false;
+	}
+
+	// .............................................................
+	/// Drop the workers silent for too long: their credit, and
+	/// their requests in flight (answered WORKER_LOST_REPLY).
+	// .............................................................
+	void expireWorkers () {
+	  long long now = nowMs ();
+	  if ( now < nextSweep ) {
+		return;
+	  }
+	  nextSweep = now + std::max (workerExpiry / 4, 1L);
+
+	  for (size_t i=0; i<workerOrder.size (); ) {
+		const std::string & id = workerOrder[i];
+		WorkerState * w = workers.find (id.data (), id.size ());
+		if ( w->expiry >= now ) {
+		  i++;
+		  continue;
+		}
+
+		for (auto & route : w->routes) {
+		  outgoing.clear ();
+		  for (auto & f : route) {
+			outgoing.push_back ( std::move (f) );
+		  }
+		  outgoing.emplace_back (); // delimiter
+		  outgoing.push_back ( textFrame (WORKER_LOST_REPLY) );
+		  frontend.sendFrames (outgoing);
+		  lost++;
+		}
+		inFlight -= w->inFlight;
+
+		workers.erase (id.data (), id.size ());
+		workerOrder.erase (workerOrder.begin () + i);
+	  }
+	  if ( nextWorker >= workerOrder.size () ) {
+		nextWorker = 0;
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	void fromWorker () {
+	  backend.receiveFrames (frames);
+	  if ( frames.size () < 2 ) {
+		return;
+	  }
+
+	  WorkerState * w = workers.find (frames[0]);
+
+	  if ( w == nullptr ) {
+		// new (or taken as dead and back): only with credit
+		long n = 0;
+		if ( frames.size () >= 3
+			 && (frameIs (frames[1], "CREDIT") || frameIs (frames[1], "HEARTBEAT")) ) {
+		  n = creditOf (frames[2]);
+		}
+		if ( n == 0 ) {
+		  return; // (a late reply, or garbage)
+		}
+		w = & workers.findOrInsert (frames[0]);
+		workerOrder.push_back ( std::string { (const char *) frames[0].data (), frames[0].size () } );
+		grant (*w, n);
+		w->expiry = nowMs () + workerExpiry;
+		return;
+	  }
+
+	  w->expiry = nowMs () + workerExpiry;
+
+	  if ( frameIs (frames[1], "CREDIT") && frames.size () >= 3 ) {
+		grant (*w, creditOf (frames[2]));
+	  }
+	  else if ( frameIs (frames[1], "REPLY") ) {
+		if ( ! replied (*w, frames, 2) ) {
+		  return; // its client was already answered
+		}
+		grant (*w, 1);
+		// route..., "", body back to the client
+		outgoing.clear ();
+		for (unsigned int i=2; i<frames.size (); i++) {
+		  outgoing.push_back ( std::move (frames[i]) );
+		}
+		frontend.sendFrames (outgoing);
+	  }
+	  // HEARTBEAT: only the expiry
+	}
+
+  protected:
+
+	// .............................................................
+	/// Hook: may a request (route..., "", body) from a client
+	/// enter the queue? (By default, always).
+	// .............................................................
+	virtual bool acceptRequest (std::vector<zmq::message_t> & request) {
+	  (void) request;
+	  return true;
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param front ROUTER for the clients
+	/// @param back ROUTER for the workers
+	// .............................................................
+	CreditBroker (SocketAdaptor<ZMQ_ROUTER> & front, SocketAdaptor<ZMQ_ROUTER> & back)
+	  : frontend {front}, backend {back}
+	{ }
+
+	virtual ~CreditBroker () { }
+
+	// .............................................................
+	/// Shed too the requests with less than ms left before their
+	/// deadline (about the time a worker takes): they would be
+	/// late anyway. (By default, 0).
+	// .............................................................
+	void setShedMargin (long ms) {
+	  shedMargin = ms;
+	}
+
+	// .............................................................
+	/// A worker silent for longer than ms is taken as dead. It must
+	/// be longer than any request takes (a busy worker is silent).
+	/// (By default, 3000).
+	// .............................................................
+	void setWorkerExpiry (long ms) {
+	  workerExpiry = ms;
+	}
+
+	// .............................................................
+	/// Wait up to time ms and handle what arrives.
+	/// @return false if nothing arrived.
+	// .............................................................
+	bool pollOnce (long time = -1) {
+
+	  // (not longer than the next sweep, while workers are known)
+	  if ( ! workerOrder.empty () ) {
+		long untilSweep = (long) std::max (0LL, nextSweep - nowMs ());
+		if ( time < 0 || untilSweep < time ) {
+		  time = untilSweep;
+		}
+	  }
+
+	  zmq::pollitem_t items [] = {
+		{ *backend.getZmqSocket (), 0, ZMQ_POLLIN, 0 },
+		{ *frontend.getZmqSocket (), 0, ZMQ_POLLIN, 0 } };
+
+	  int some = zmq::poll ( &items[0], 2, time );
+
+	  // workers first: credit and replies
+	  if ( some > 0 && (items[0].revents & ZMQ_POLLIN) ) {
+		fromWorker ();
+	  }
+	  if ( some > 0 && (items[1].revents & ZMQ_POLLIN) ) {
+		fromClient ();
+	  }
+
+	  expireWorkers ();
+	  dispatch ();
+
+	  return some > 0;
+	}
+
+	// .............................................................
+	/// Forever.
+	// .............................................................
+	void run () {
+	  while (true) {
+		pollOnce (-1);
+	  }
+	}
+
+	// .............................................................
+	/// @return requests waiting for credit in the broker
+	// .............................................................
+	size_t queuedCount () const {
+	  return queue.size ();
+	}
+
+	// .............................................................
+	/// @return requests sent to workers, not replied yet
+	// .............................................................
+	size_t inFlightCount () const {
+	  return inFlight;
+	}
+
+	// .............................................................
+	/// @return requests sent to workers so far
+	// .............................................................
+	unsigned long dispatchedCount () const {
+	  return dispatched;
+	}
+
+	// .............................................................
+	/// @return requests dropped because of their deadline
+	// .............................................................
+	unsigned long shedCount () const {
+	  return shed;
+	}
+
+	// .............................................................
+	/// @return requests answered WORKER_LOST_REPLY
+	// .............................................................
+	unsigned long lostCount () const {
+	  return lost;
+	}
+
+	// .............................................................
+	/// @return workers known (they granted credit)
+	// .............................................................
+	size_t workerCount () const {
+	  return workerOrder.size ();
+	}
+
+	// .............................................................
+	/// Visit (worker identity, credits, in flight) of every worker.
+	// .............................................................
+	void forEachWorker (std::function<void(const std::string &, long, long)> f) {
+	  workers.forEach ( [&f] (const std::string & id, WorkerState & w) {
+		  f (id, w.credits, w.inFlight);
+		} );
+	}
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The CreditWorker class: the worker side of the protocol
+  /// on a DEALER socket (connected to the backend of the broker).
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class CreditWorker {
+
+  public:
+
+	// .............................................................
+	/// Gets the request body, @return the reply body.
+	// .............................................................
+	using HandlerType
+	  = std::function<std::vector<std::string>(const std::vector<std::string> &)>;
+
+  private:
+
+	SocketAdaptor<ZMQ_DEALER> & socket;
+	const unsigned int window;
+	const long heartbeat;
+
+	long long nextHeartbeat = 0;
+	unsigned long handled = 0;
+	unsigned long shed = 0;
+
+	std::vector<zmq::message_t> frames;
+	std::vector<zmq::message_t> outgoing;
+	std::vector<std::string> body;
+
+	CreditWorker (const CreditWorker & o) = delete;
+	CreditWorker & operator=(const CreditWorker & o) = delete;
+
+  protected:
+
+	// .............................................................
+	/// Hook: may the request (route..., "", body in frames[1..])
+	/// be handled? If not, reply is sent back instead.
+	// .............................................................
+	virtual bool acceptRequest (std::vector<zmq::message_t> & request,
+								std::vector<std::string> & reply) {
+	  (void) request;
+	  (void) reply;
+	  return true;
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor. The first credit is granted in start().
+	/// @param s DEALER socket (owned by the calling thread)
+	/// @param window how many requests may be in flight here.
+	/// @param heartbeatMs interval of the heartbeats while idle
+	/// (less than the worker expiry of the broker)
+	// .............................................................
+	CreditWorker (SocketAdaptor<ZMQ_DEALER> & s, unsigned int window_,
+				  long heartbeatMs = 1000)
+	  : socket {s}, window {window_}, heartbeat {heartbeatMs}
+	{ }
+
+	virtual ~CreditWorker () { }
+
+	// .............................................................
+	/// Grant the first window of credit (after connecting).
+	// .............................................................
+	void start () {
+	  socket.sendText ( {"CREDIT", std::to_string (window)} );
+	  nextHeartbeat = nowMs () + heartbeat;
+	}
+
+	// .............................................................
+	/// Handle one request (waiting up to time ms for it, sending
+	/// heartbeats meanwhile).
+	/// @return false if nothing arrived.
+	// .............................................................
+	bool handleOne (HandlerType handler, long time = -1) {
+
+	  long long end = nowMs () + time;
+	  while (true) {
+		long long now = nowMs ();
+		if ( now >= nextHeartbeat ) {
+		  // idle: every request got was replied, all the window is free
+		  socket.sendText ( {"HEARTBEAT", std::to_string (window)} );
+		  nextHeartbeat = now + heartbeat;
+		}
+
+		long long until = nextHeartbeat;
+		if ( time >= 0 && end < until ) {
+		  until = end;
+		}
+		if ( socket.receiveFrames (frames, (long) std::max (0LL, until - now)) ) {
+		  break;
+		}
+		if ( time >= 0 && nowMs () >= end ) {
+		  return false;
+		}
+	  } // while
+
+	  if ( frames.empty () || ! frameIs (frames[0], "REQUEST") ) {
+		return true; // not for us: ignore
+	  }
+
+	  // body: after the delimiter (at d), maybe with a deadline header
+	  size_t b = bodyStart (frames, 1);
+	  size_t d = b - 1;
+	  long long deadline = 0;
+	  bool hasDeadline = b < frames.size () && deadlineOf (frames[b], deadline);
+
+	  std::vector<std::string> reply;
+	  if ( hasDeadline && deadline < nowMs () ) {
+		reply = { EXPIRED_REPLY };
+		shed++;
+	  } else if ( acceptRequest (frames, reply) ) {
+		body.clear ();
+		for (size_t i = hasDeadline ? b+1 : b; i<frames.size (); i++) {
+		  body.push_back ( std::string { (const char *) frames[i].data (), frames[i].size () } );
+		}
+		reply = handler (body);
+		handled++;
+	  }
+
+	  // "REPLY", route..., "", reply (the credit is returned with it)
+	  outgoing.clear ();
+	  outgoing.push_back ( textFrame ("REPLY") );
+	  for (size_t i=1; i<=d && i<frames.size (); i++) {
+		outgoing.push_back ( std::move (frames[i]) );
+	  }
+	  for (auto & line : reply) {
+		outgoing.push_back ( textFrame (line) );
+	  }
+	  socket.sendFrames (outgoing);
+	  nextHeartbeat = nowMs () + heartbeat;
+
+	  return true;
+	}
+
+	// .............................................................
+	/// @return requests handled
+	// .............................................................
+	unsigned long handledCount () const {
+	  return handled;
+	}
+
+	// .............................................................
+	/// @return requests dropped because of their deadline
+	// .............................................................
+	unsigned long shedCount () const {
+	  return shed;
+	}
+
+	// .............................................................
+	/// start() and handle requests forever.
+	// .............................................................
+	void run (HandlerType handler) {
+	  start ();
+	  while (true) {
+		handleOne (handler);
+	  }
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
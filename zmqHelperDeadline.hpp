@@ -0,0 +1,97 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperDeadline.hpp
+ *
+ * Deadlines carried in request frames: an optional header frame,
+ * the first one of the body (after the delimiter), holding the
+ * absolute time (ms since the epoch, system clock) after which
+ * the client does not care about the reply anymore:
+ *
+ *    requester.sendText ( { deadlineHeader (50), "GET", "key" } ); // REQ
+ *    dealer.sendText ( { "", deadlineHeader (50), "GET", "key" } ); // DEALER
+ *
+ * Brokers and workers (see zmqHelperCredit.hpp) drop expired
+ * requests before dispatching or handling them, and reply
+ * EXPIRED_REPLY instead (a fast answer, no work done).
+ *
+ * Being absolute, deadlines assume the clocks of the hosts involved
+ * are in sync (as they are for inproc, ipc and a single host).
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_DEADLINE_H
+#define ZQM_HELPER_DEADLINE_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// The header frame is DEADLINE_TAG followed by the ms (in decimal)
+  // -----------------------------------------------------------------
+  const char DEADLINE_TAG[] = "deadline=";
+
+  // -----------------------------------------------------------------
+  /// Reply body of a request dropped because of its deadline
+  // -----------------------------------------------------------------
+  const char EXPIRED_REPLY[] = "EXPIRED";
+
+  // -----------------------------------------------------------------
+  /// @return ms since the epoch (system clock)
+  // -----------------------------------------------------------------
+  inline long long nowMs () {
+	return std::chrono::duration_cast<std::chrono::milliseconds>
+	  (std::chrono::system_clock::now ().time_since_epoch ()).count ();
+  } // ()
+
+  // -----------------------------------------------------------------
+  /// @return the header frame text for a deadline ms from now
+  // -----------------------------------------------------------------
+  inline std::string deadlineHeader (long ms) {
+	return DEADLINE_TAG + std::to_string (nowMs () + ms);
+  } // ()
+
+  // -----------------------------------------------------------------
+  /// @return true if the frame is a deadline header (and then,
+  /// deadline gets its value)
+  // -----------------------------------------------------------------
+  inline bool deadlineOf (const zmq::message_t & frame, long long & deadline) {
+	const size_t tag = sizeof (DEADLINE_TAG) - 1;
+	char digits[24];
+
+	if ( frame.size () <= tag || frame.size () - tag >= sizeof (digits)
+		 || memcmp (frame.data (), DEADLINE_TAG, tag) != 0 ) {
+	  return false;
+	}
+
+	size_t n = frame.size () - tag;
+	memcpy (digits, static_cast<const char *> (frame.data ()) + tag, n);
+	digits[n] = '\0';
+
+	char * end = nullptr;
+	deadline = strtoll (digits, &end, 10);
+	return end == digits + n;
+  } // ()
+
+  // -----------------------------------------------------------------
+  /// @return true if the frame is a deadline header already passed
+  // -----------------------------------------------------------------
+  inline bool isExpired (const zmq::message_t & frame, long long now) {
+	long long deadline = 0;
+	return deadlineOf (frame, deadline) && deadline < now;
+  } // ()
+
+}; // namespace
+
+#endif
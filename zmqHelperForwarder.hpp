@@ -0,0 +1,311 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperForwarder.hpp
+ *
+ * Forwarder: fans out a publisher to many subscribers over several
+ * XPUB sockets ("groups"), each in its own thread and on its own
+ * zmq I/O thread, so that fan-out is not bound to one of them:
+ *
+ *    zmq::context_t theContext {4};   // I/O threads
+ *    Forwarder forwarder {theContext};
+ *    forwarder.connectUpstream ("tcp://publisher:8001");
+ *    forwarder.addGroup ( {"tcp://0.0.0.0:9001", "tcp://0.0.0.0:9002"} );
+ *    forwarder.addGroup ( {"tcp://0.0.0.0:9003", "tcp://0.0.0.0:9004"} );
+ *    forwarder.start ();
+ *    ...
+ *    forwarder.stop ();
+ *
+ *            publisher
+ *                |
+ *          XSUB [Proxy] XPUB (inproc)       upstream thread
+ *                |
+ *      +---------+---------+
+ *      |                   |
+ *  XSUB [Proxy] XPUB   XSUB [Proxy] XPUB    a thread per group
+ *      |                   |
+ *  subscribers         subscribers
+ *
+ * Every stage is a Proxy<ZMQ_XSUB, ZMQ_XPUB>. Subscriptions go
+ * up through the XPUBs, which pass on only the first subscribe
+ * (and the last unsubscribe) of a prefix: they get to the
+ * publisher merged and deduplicated, and every group gets only
+ * what its subscribers want.
+ *
+ * Groups are spread over the I/O threads of the context (affinity):
+ * make it with as many as groups.
+ *
+ * If a url can not be bound (or connected), start() stops the
+ * stages already running and throws that error.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_FORWARDER_H
+#define ZQM_HELPER_FORWARDER_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "zmqHelperOptions.hpp"
+#include "zmqHelperProxy.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The Forwarder class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class Forwarder {
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	zmq::context_t & theContext;
+	const std::string name;
+
+	std::vector<std::string> upstream;
+	std::vector< std::vector<std::string> > groups;
+
+	std::vector<std::thread *> threads; // [0]: upstream
+
+	/// to send TERMINATE to each proxy (owned by the thread
+	/// calling start / stop)
+	std::vector< std::unique_ptr< SocketAdaptor<ZMQ_PAIR> > > controls;
+
+	// .............................................................
+	/// Stages set up (with theMutex): bound, or failed
+	// .............................................................
+	std::mutex theMutex;
+	std::condition_variable theCondition;
+	unsigned int bound = 0;
+	std::vector<bool> proxying;  // by thread: its proxy runs
+	std::exception_ptr failure;  // the first error setting up
+
+	// .............................................................
+	// .............................................................
+	Forwarder (const Forwarder & o) = delete;
+	Forwarder & operator=(const Forwarder & o) = delete;
+
+	// .............................................................
+	// .............................................................
+	std::string innerUrl () const {
+	  return "inproc://" + name;
+	}
+
+	std::string controlUrl (size_t i) const {
+	  return "inproc://" + name + "-control-" + std::to_string (i);
+	}
+
+	// .............................................................
+	// .............................................................
+	void setUp (size_t i, std::exception_ptr error) {
+	  std::unique_lock<std::mutex> theLock {theMutex};
+	  bound++;
+	  if ( error ) {
+		if ( ! failure ) {
+		  failure = error;
+		}
+	  } else {
+		proxying[i] = true;
+	  }
+	  theCondition.notify_all ();
+	}
+
+	void waitBound (unsigned int n) {
+	  std::unique_lock<std::mutex> theLock {theMutex};
+	  theCondition.wait (theLock, [this, n] () { return bound >= n; });
+	}
+
+	// .............................................................
+	/// Updates not delivered are not worth waiting for on close.
+	// .............................................................
+	void lingerNot (SocketAdaptor<ZMQ_XSUB> & front, SocketAdaptor<ZMQ_XPUB> & back,
+					SocketAdaptor<ZMQ_PAIR> & control) {
+	  front.set<option::Linger> (0);
+	  back.set<option::Linger> (0);
+	  control.set<option::Linger> (0);
+	}
+
+	// .............................................................
+	/// upstream -> inner XPUB
+	// .............................................................
+	void main_Upstream () {
+	  bool reported = false;
+	  try {
+		SocketAdaptor<ZMQ_XSUB> front {theContext};
+		SocketAdaptor<ZMQ_XPUB> back {theContext};
+		SocketAdaptor<ZMQ_PAIR> control {theContext};
+
+		lingerNot (front, back, control);
+
+		for (auto & url : upstream) {
+		  front.connect (url);
+		}
+		back.bind (innerUrl ());
+		control.bind (controlUrl (0));
+		setUp (0, nullptr);
+		reported = true;
+
+		Proxy<ZMQ_XSUB, ZMQ_XPUB> proxy {front, back};
+		proxy.setControl (control);
+		proxy.run (); // until TERMINATE
+
+		front.close ();
+		back.close ();
+		control.close ();
+	  } catch (...) {
+		// for start() (not out of the thread: std::terminate)
+		if ( ! reported ) {
+		  setUp (0, std::current_exception ());
+		}
+	  }
+	}
+
+	// .............................................................
+	/// inner XPUB -> the XPUB of group g (on I/O thread g)
+	// .............................................................
+	void main_Group (size_t g) {
+	  bool reported = false;
+	  try {
+		SocketAdaptor<ZMQ_XSUB> front {theContext};
+		SocketAdaptor<ZMQ_XPUB> back {theContext};
+		SocketAdaptor<ZMQ_PAIR> control {theContext};
+
+		int ioThreads = std::max (1, zmq_ctx_get (static_cast<void *> (theContext), ZMQ_IO_THREADS));
+		back.set<option::Affinity> ( uint64_t (1) << (g % ioThreads % 64) );
+		lingerNot (front, back, control);
+
+		front.connect (innerUrl ());
+		for (auto & url : groups[g]) {
+		  back.bind (url);
+		}
+		control.bind (controlUrl (g+1));
+		setUp (g+1, nullptr);
+		reported = true;
+
+		Proxy<ZMQ_XSUB, ZMQ_XPUB> proxy {front, back};
+		proxy.setControl (control);
+		proxy.run (); // until TERMINATE
+
+		front.close ();
+		back.close ();
+		control.close ();
+	  } catch (...) {
+		if ( ! reported ) {
+		  setUp (g+1, std::current_exception ());
+		}
+	  }
+	}
+
+  public:
+
+	// .............................................................
+	/// @param aContext context (as many I/O threads as groups)
+	/// @param name_ for its inproc endpoints (unique in the context)
+	// .............................................................
+	explicit Forwarder (zmq::context_t & aContext, const std::string & name_ = "zmqHelper-forwarder")
+	  : theContext {aContext}, name {name_}
+	{ }
+
+	// .............................................................
+	// .............................................................
+	~Forwarder () {
+	  stop ();
+	}
+
+	// .............................................................
+	/// A publisher to forward (before start()).
+	// .............................................................
+	void connectUpstream (const std::string & url) {
+	  upstream.push_back (url);
+	}
+
+	// .............................................................
+	/// A group: one XPUB bound to these urls (before start()).
+	// .............................................................
+	void addGroup (const std::vector<std::string> & urls) {
+	  groups.push_back (urls);
+	}
+
+	// .............................................................
+	/// Start the threads. Returns once every url is bound.
+	/// Throws the error of a stage which could not (after stopping
+	/// the others).
+	// .............................................................
+	void start () {
+	  if ( ! threads.empty () ) {
+		return;
+	  }
+
+	  {
+		std::unique_lock<std::mutex> theLock {theMutex};
+		bound = 0;
+		proxying.assign (1 + groups.size (), false);
+		failure = nullptr;
+	  }
+
+	  threads.push_back ( new std::thread (&Forwarder::main_Upstream, this) );
+	  waitBound (1);
+
+	  if ( ! failure ) {
+		for (size_t g=0; g<groups.size (); g++) {
+		  threads.push_back ( new std::thread (&Forwarder::main_Group, this, g) );
+		}
+		waitBound (1 + groups.size ());
+	  }
+
+	  // (a control for each proxy running, to TERMINATE it)
+	  for (size_t i=0; i<threads.size (); i++) {
+		if ( proxying[i] ) {
+		  controls.emplace_back ( new SocketAdaptor<ZMQ_PAIR> {theContext} );
+		  controls.back()->connect (controlUrl (i));
+		}
+	  }
+
+	  if ( failure ) {
+		std::exception_ptr error = failure;
+		stop ();
+		std::rethrow_exception (error);
+	  }
+	}
+
+	// .............................................................
+	/// Stop and join the threads (from the thread that started them).
+	// .............................................................
+	void stop () {
+	  for (auto & c : controls) {
+		c->sendText ( {"TERMINATE"} );
+	  }
+	  for (auto t : threads) {
+		t->join ();
+		delete t;
+	  }
+	  threads.clear ();
+	  for (auto & c : controls) {
+		c->close ();
+	  }
+	  controls.clear ();
+	}
+
+	// .............................................................
+	// .............................................................
+	size_t groupCount () const {
+	  return groups.size ();
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperFramePool.hpp
+ *
+ * FramePool: per thread pools of buffers (by size classes)
+ * to build outgoing zmq frames without calling malloc for
+ * each one of them.
+ *
+ * A frame is made with zmq_msg_init_data() on a pooled buffer.
+ * When zmq is done with it (maybe in one of its I/O threads),
+ * the free callback gives the buffer back to the pool of the
+ * thread which took it, through a lock-free stack. The owner
+ * thread reuses those buffers.
+ *
+ * Notes:
+ *  - Small frames (up to SMALL_FRAME bytes) are stored by zmq inside
+ *    the message itself (no malloc at all): the pool is not used.
+ *  - For the rest, libzmq still allocates a small block
+ *    (its reference counter) for each zmq_msg_init_data().
+ *    The payload buffer, though, comes from the pool.
+ *  - Frames larger than the biggest size class are plain frames.
+ *
+ * With C++17, the pool is also a std::pmr::memory_resource,
+ * for the receive-side containers (see FramePoolResource):
+ *
+ *   std::pmr::vector<std::pmr::string> lines { &resource };
+ *   socket.receiveText (lines);
+ *
+ * Features C++11 (C++17 for the pmr part)
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_FRAME_POOL_H
+#define ZQM_HELPER_FRAME_POOL_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The FramePool class. Get the one of your thread with
+  /// FramePool::forThisThread().
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class FramePool {
+
+  public:
+
+	// .............................................................
+	/// Size classes: 64 bytes, 128, 256 ... 64 KBytes
+	// .............................................................
+	static const int CLASSES = 11;
+	static size_t classSize (int c) { return size_t(64) << c; }
+
+	// .............................................................
+	/// Frames up to this size live inside the zmq message itself.
+	// .............................................................
+	static const size_t SMALL_FRAME = 33;
+
+  private:
+
+	// .............................................................
+	/// Header in front of every buffer
+	// .............................................................
+	struct alignas(16) Block {
+	  FramePool * owner;
+	  Block * next;
+	  int sizeClass;
+	};
+
+	// .............................................................
+	// .............................................................
+	std::thread::id ownerThreadId;
+
+	// only used by the owner thread
+	Block * localFree[CLASSES];
+
+	// given back by any thread (zmq I/O threads, f.ex.)
+	std::atomic<Block *> returned[CLASSES];
+
+	// 1 (the owner thread) + buffers out of the pool
+	std::atomic<long> references {1};
+
+	// .............................................................
+	// .............................................................
+	unsigned long mallocs = 0;
+	unsigned long reuses = 0;
+
+	// .............................................................
+	// .............................................................
+	FramePool (const FramePool & o) = delete;
+	FramePool & operator=(const FramePool & o) = delete;
+
+	// .............................................................
+	/// Only the owner thread's holder creates and retires pools
+	// .............................................................
+	FramePool () : ownerThreadId {std::this_thread::get_id ()} {
+	  for (int c=0; c<CLASSES; c++) {
+		localFree[c] = nullptr;
+		returned[c] = nullptr;
+	  }
+	}
+
+	~FramePool () {
+	  for (int c=0; c<CLASSES; c++) {
+		freeList (localFree[c]);
+		freeList (returned[c].exchange (nullptr));
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	static void freeList (Block * b) {
+	  while (b != nullptr) {
+		Block * next = b->next;
+		std::free (b);
+		b = next;
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	static char * dataOf (Block * b) {
+	  return reinterpret_cast<char *> (b) + sizeof (Block);
+	}
+
+	// .............................................................
+	// .............................................................
+	static Block * blockOf (void * data) {
+	  return reinterpret_cast<Block *> (static_cast<char *> (data) - sizeof (Block));
+	}
+
+	// .............................................................
+	/// The last one out (the owner, or a buffer coming back
+	/// after the owner thread ended) deletes the pool.
+	// .............................................................
+	void unref () {
+	  if ( references.fetch_sub (1, std::memory_order_acq_rel) == 1 ) {
+		delete this;
+	  }
+	}
+
+	// .............................................................
+	/// The owner thread ends: cached buffers are freed.
+	/// The pool lives on until every buffer out is back.
+	// .............................................................
+	void retire () {
+	  for (int c=0; c<CLASSES; c++) {
+		freeList (localFree[c]);
+		localFree[c] = nullptr;
+	  }
+	  unref ();
+	}
+
+	// .............................................................
+	/// Holder of the pool of a thread.
+	// .............................................................
+	struct Holder {
+	  FramePool * pool = new FramePool {};
+	  ~Holder () { pool->retire (); }
+	};
+
+	// .............................................................
+	// .............................................................
+	static int classFor (size_t size) {
+	  int c = 0;
+	  while ( c < CLASSES && classSize (c) < size ) {
+		c++;
+	  }
+	  return c; // CLASSES if too big
+	}
+
+  public:
+
+	// .............................................................
+	/// The pool of the calling thread.
+	// .............................................................
+	static FramePool & forThisThread () {
+	  static thread_local Holder holder;
+	  return * holder.pool;
+	}
+
+	// .............................................................
+	/// Free callback for zmq_msg_init_data(). Any thread.
+	// .............................................................
+	static void release (void * data, void * hint) {
+	  (void) data;
+	  Block * b = static_cast<Block *> (hint);
+	  FramePool * pool = b->owner;
+
+	  // push on the lock-free stack of its class
+	  std::atomic<Block *> & top = pool->returned[b->sizeClass];
+	  b->next = top.load (std::memory_order_relaxed);
+	  while ( ! top.compare_exchange_weak (b->next, b,
+										   std::memory_order_release,
+										   std::memory_order_relaxed) ) { }
+
+	  pool->unref ();
+	}
+
+	// .............................................................
+	/// A buffer of at least size bytes (owner thread only).
+	/// Give it back with release(data, hint) where hint is
+	/// the returned handle.
+	/// @return the buffer, nullptr if size is too big.
+	// .............................................................
+	void * acquire (size_t size, void * & hint) {
+
+	  int c = classFor (size);
+	  if ( c == CLASSES ) {
+		return nullptr;
+	  }
+
+	  if ( localFree[c] == nullptr ) {
+		// take back all that was given back
+		// (taking the whole stack at once: no ABA problem)
+		localFree[c] = returned[c].exchange (nullptr, std::memory_order_acquire);
+	  }
+
+	  Block * b = localFree[c];
+	  if ( b != nullptr ) {
+		localFree[c] = b->next;
+		reuses++;
+	  } else {
+		b = static_cast<Block *> ( std::malloc (sizeof (Block) + classSize (c)) );
+		if ( b == nullptr ) {
+		  throw std::bad_alloc {};
+		}
+		b->owner = this;
+		b->sizeClass = c;
+		mallocs++;
+	  }
+
+	  references.fetch_add (1, std::memory_order_relaxed);
+	  hint = b;
+	  return dataOf (b);
+	}
+
+	// .............................................................
+	/// A zmq frame with a copy of data, on a pooled buffer
+	/// (owner thread only).
+	// .............................................................
+	zmq::message_t message (const void * data, size_t size) {
+
+	  if ( size <= SMALL_FRAME ) {
+		// zmq keeps it inside the message: cheaper than the pool
+		zmq::message_t m (size);
+		memcpy (m.data (), data, size);
+		return m;
+	  }
+
+	  void * hint = nullptr;
+	  void * buffer = acquire (size, hint);
+	  if ( buffer == nullptr ) {
+		zmq::message_t m (size);
+		memcpy (m.data (), data, size);
+		return m;
+	  }
+
+	  memcpy (buffer, data, size);
+	  return zmq::message_t (buffer, size, &FramePool::release, hint);
+	}
+
+	// .............................................................
+	/// @return how many buffers were malloc'ed. Flat in the steady state.
+	// .............................................................
+	unsigned long mallocCount () const {
+	  return mallocs;
+	}
+
+	// .............................................................
+	/// @return how many times a buffer was reused
+	// .............................................................
+	unsigned long reuseCount () const {
+	  return reuses;
+	}
+
+	// .............................................................
+	/// For FramePoolResource: the handle of a buffer got by acquire().
+	// .............................................................
+	static void * hintOf (void * data) {
+	  return blockOf (data);
+	}
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  /// Send lines as pooled frames (one memcpy per line into a
+  /// reused buffer, no malloc in the steady state).
+  /// Call it from the thread owning the socket.
+  // ---------------------------------------------------------------
+  template<int ZMQ_SOCKET_TYPE>
+  void sendTextPooled (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket,
+					   const std::vector<std::string> & lines) {
+
+	static thread_local std::vector<zmq::message_t> frames;
+
+	FramePool & pool = FramePool::forThisThread ();
+
+	frames.clear ();
+	for (const auto & line : lines) {
+	  frames.push_back ( pool.message (line.data (), line.size ()) );
+	}
+
+	socket.sendFrames (frames);
+  } // ()
+
+#if __cplusplus >= 201703L
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// FramePoolResource: the pool of the creating thread as
+  /// a std::pmr::memory_resource. Allocate from the thread which
+  /// created it (deallocation may happen in any thread).
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class FramePoolResource : public std::pmr::memory_resource {
+
+  private:
+
+	FramePool & thePool;
+
+  protected:
+
+	// .............................................................
+	// .............................................................
+	void * do_allocate (size_t bytes, size_t alignment) override {
+	  void * hint = nullptr;
+	  void * p = alignment <= 16 ? thePool.acquire (bytes, hint) : nullptr;
+	  if (p == nullptr) {
+		// too big (or too aligned) for the pool
+		return ::operator new (bytes, std::align_val_t (alignment));
+	  }
+	  return p;
+	}
+
+	// .............................................................
+	// .............................................................
+	void do_deallocate (void * p, size_t bytes, size_t alignment) override {
+	  if ( alignment <= 16 && bytes <= FramePool::classSize (FramePool::CLASSES-1) ) {
+		FramePool::release (p, FramePool::hintOf (p));
+		return;
+	  }
+	  ::operator delete (p, std::align_val_t (alignment));
+	}
+
+	// .............................................................
+	// .............................................................
+	bool do_is_equal (const std::pmr::memory_resource & other) const noexcept override {
+	  return this == &other;
+	}
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	FramePoolResource () : thePool {FramePool::forThisThread ()} { }
+
+  }; // class
+
+#endif
+
+}; // namespace
+
+#endif
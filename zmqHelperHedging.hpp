@@ -0,0 +1,289 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperHedging.hpp
+ *
+ * HedgingClient: requests with hedging, to cut the tail latency
+ * of idempotent requests (reads, like GET) to replicated servers.
+ *
+ * A request is sent to one replica. If no reply arrives within
+ * the hedge delay (a percentile of the latencies seen so far),
+ * it is sent again, to another replica. The first reply wins;
+ * the other one is ignored when it arrives.
+ *
+ * The client has a DEALER connected to each replica (REP, or
+ * anything echoing the envelope): a PeerSet. Requests go round robin to the
+ * replicas without copies pending (a stalled replica is skipped
+ * until it answers), and the second copy goes to another one.
+ * Each copy goes with a correlation frame before the delimiter:
+ *
+ *    "<request number>.<copy>", "", body...
+ *
+ * which a REP socket gives back with the reply, so the servers
+ * need no changes.
+ *
+ * Hedges are bounded: at most maxHedgeRatio of the requests
+ * are sent twice (f.ex. 0.05, so the extra load is up to 5%).
+ *
+ * Only for idempotent requests: both copies may be served.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_HEDGING_H
+#define ZQM_HELPER_HEDGING_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "zmqHelperPeerSet.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The HedgingClient class. Its sockets are created by
+  /// the thread calling the constructor: use it from that one.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class HedgingClient {
+
+  public:
+
+	// .............................................................
+	/// Latencies kept to compute the hedge delay
+	// .............................................................
+	static const size_t WINDOW = 512;
+
+	// .............................................................
+	/// Until these many latencies are seen, initialDelay is used
+	// .............................................................
+	static const size_t MIN_SAMPLES = 32;
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// .............................................................
+	// .............................................................
+	PeerSet replicas;
+	size_t nextReplica = 0;
+
+	double percentile;
+	double maxHedgeRatio;
+
+	// .............................................................
+	// latencies (us): a ring of the last WINDOW ones
+	// .............................................................
+	std::vector<long> latencies;
+	size_t nextLatency = 0;
+	std::vector<long> sorted;
+	long delayMs;
+	unsigned long sinceDelayUpdate = 0;
+
+	// .............................................................
+	// .............................................................
+	unsigned long requests = 0;
+	unsigned long hedges = 0;
+	unsigned long hedgeWins = 0;
+
+	std::string correlation;
+
+	// .............................................................
+	// .............................................................
+	HedgingClient (const HedgingClient & o) = delete;
+	HedgingClient & operator=(const HedgingClient & o) = delete;
+
+	// .............................................................
+	// .............................................................
+	void sendCopy (size_t r, const std::vector<std::string> & body, unsigned long number, int copy) {
+	  replicas.send (r, std::to_string (number) + "." + std::to_string (copy), body);
+	}
+
+	// .............................................................
+	/// @return next replica (round robin) with less copies pending,
+	/// other than but (if possible)
+	// .............................................................
+	size_t pickReplica (size_t but) {
+	  size_t best = but;
+	  for (size_t k=0; k<replicas.size (); k++) {
+		size_t r = (nextReplica + k) % replicas.size ();
+		if ( r != but && (best == but || replicas.pendingAt (r) < replicas.pendingAt (best)) ) {
+		  best = r;
+		}
+	  }
+	  if ( best == but ) {
+		best = nextReplica % replicas.size (); // a single replica
+	  }
+	  nextReplica = (best + 1) % replicas.size ();
+	  return best;
+	}
+
+	// .............................................................
+	/// Add a latency and, now and then, recompute the delay.
+	// .............................................................
+	void addLatency (long us) {
+	  if ( latencies.size () < WINDOW ) {
+		latencies.push_back (us);
+	  } else {
+		latencies[nextLatency] = us;
+		nextLatency = (nextLatency + 1) % WINDOW;
+	  }
+
+	  if ( latencies.size () < MIN_SAMPLES || ++sinceDelayUpdate < MIN_SAMPLES ) {
+		return;
+	  }
+	  sinceDelayUpdate = 0;
+
+	  sorted = latencies;
+	  size_t k = std::min (sorted.size () - 1, size_t (percentile * sorted.size ()));
+	  std::nth_element (sorted.begin (), sorted.begin () + k, sorted.end ());
+	  // to ms, rounding up: at least 1 ms
+	  delayMs = std::max (1L, (sorted[k] + 999) / 1000);
+	}
+
+	// .............................................................
+	/// May one more request be hedged? (keeps the ratio bound)
+	// .............................................................
+	bool mayHedge () const {
+	  return (hedges + 1) <= maxHedgeRatio * requests;
+	}
+
+	// .............................................................
+	// .............................................................
+	static long msSince (Clock::time_point t) {
+	  return std::chrono::duration_cast<std::chrono::milliseconds> (Clock::now () - t).count ();
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param context zmq context
+	/// @param urls of the replicas (one DEALER for each)
+	/// @param percentile_ hedge after this percentile of the latency
+	/// @param maxHedgeRatio_ at most this fraction of requests hedged
+	/// @param initialDelay_ hedge delay (ms) until latencies are known
+	// .............................................................
+	HedgingClient (zmq::context_t & context,
+				   const std::vector<std::string> & urls,
+				   double percentile_ = 0.95,
+				   double maxHedgeRatio_ = 0.05,
+				   long initialDelay_ = 10)
+	  : replicas {context, urls},
+		percentile {percentile_}, maxHedgeRatio {maxHedgeRatio_},
+		delayMs {initialDelay_}
+	{
+	  latencies.reserve (WINDOW);
+	}
+
+
+	// .............................................................
+	/// Send a request (hedging it if late) and wait for its reply.
+	/// @param time timeout in ms (-1 = forever)
+	/// @return false if timed out
+	// .............................................................
+	bool request (const std::vector<std::string> & body,
+				  std::vector<std::string> & reply,
+				  long time = -1) {
+
+	  unsigned long number = ++requests;
+	  std::string prefix = std::to_string (number) + ".";
+	  bool hedged = false;
+
+	  auto start = Clock::now ();
+	  size_t primary = pickReplica (replicas.size ());
+	  sendCopy (primary, body, number, 0);
+
+	  while (true) {
+
+		//
+		// how long to wait now
+		//
+		long elapsed = msSince (start);
+		long wait = time < 0 ? -1 : std::max (0L, time - elapsed);
+		bool hedgeNext = ! hedged && mayHedge ();
+		if ( hedgeNext && (wait < 0 || delayMs - elapsed < wait) ) {
+		  wait = std::max (0L, delayMs - elapsed);
+		}
+
+		// correlation "number.copy", from any replica
+		if ( replicas.receive (prefix, wait, reply, &correlation) == replicas.size () ) {
+		  if ( hedgeNext && msSince (start) >= delayMs ) {
+			// late: send it again (to another replica)
+			sendCopy (pickReplica (primary), body, number, 1);
+			hedged = true;
+			hedges++;
+			continue;
+		  }
+		  if ( time >= 0 && msSince (start) >= time ) {
+			return false;
+		  }
+		  continue;
+		}
+
+		if ( correlation.size () > prefix.size () && correlation[prefix.size ()] == '1' ) {
+		  hedgeWins++;
+		}
+
+		addLatency ( std::chrono::duration_cast<std::chrono::microseconds>
+					 (Clock::now () - start).count () );
+		return true;
+	  } // while
+	}
+
+	// .............................................................
+	/// @return requests made
+	// .............................................................
+	unsigned long requestCount () const {
+	  return requests;
+	}
+
+	// .............................................................
+	/// @return requests sent twice
+	// .............................................................
+	unsigned long hedgeCount () const {
+	  return hedges;
+	}
+
+	// .............................................................
+	/// @return hedged requests where the second copy replied first
+	// .............................................................
+	unsigned long hedgeWinCount () const {
+	  return hedgeWins;
+	}
+
+	// .............................................................
+	/// @return late replies ignored (the losers)
+	// .............................................................
+	unsigned long ignoredCount () const {
+	  return replicas.ignoredCount ();
+	}
+
+	// .............................................................
+	/// @return fraction of requests hedged (the extra load)
+	// .............................................................
+	double hedgeRate () const {
+	  return requests == 0 ? 0.0 : double (hedges) / requests;
+	}
+
+	// .............................................................
+	/// @return current hedge delay (ms)
+	// .............................................................
+	long hedgeDelay () const {
+	  return delayMs;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
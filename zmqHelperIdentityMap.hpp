@@ -0,0 +1,236 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperIdentityMap.hpp
+ *
+ * IdentityMap<V>: a flat hash map (open addressing, linear probing)
+ * keyed by the raw bytes of ROUTER identities, to keep per-client
+ * state in a ROUTER server:
+ *
+ *    RouterEnvelope env;
+ *    IdentityMap<ClientState> clients;
+ *    ...
+ *    router.receiveEnvelope (env);
+ *    ClientState & state = clients.findOrInsert (env.identity);
+ *    ...
+ *    router.reply (env, { "ok" });
+ *
+ * Lookups take the bytes of the identity frame: no copy, no
+ * allocation. Keys are stored in std::string, which keeps short
+ * identities (as the 5 bytes ones made by zmq) inline.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_IDENTITY_MAP_H
+#define ZQM_HELPER_IDENTITY_MAP_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// FNV-1a hash of some bytes (fast for short keys).
+  // -----------------------------------------------------------------
+  inline uint32_t hashBytes (const void * data, size_t size) {
+	const unsigned char * p = static_cast<const unsigned char *> (data);
+	uint32_t h = 2166136261u;
+	for (size_t i=0; i<size; i++) {
+	  h ^= p[i];
+	  h *= 16777619u;
+	}
+	return h;
+  } // ()
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The IdentityMap class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  template<typename V>
+  class IdentityMap {
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	struct Slot {
+	  bool used = false;
+	  uint32_t hash = 0;
+	  std::string key;
+	  V value {};
+	};
+
+	std::vector<Slot> slots; // size: power of 2
+	size_t mask = 0;
+	size_t count = 0;
+
+	// .............................................................
+	// .............................................................
+	static bool sameKey (const Slot & s, uint32_t h, const void * data, size_t size) {
+	  return s.hash == h && s.key.size () == size
+		&& memcmp (s.key.data (), data, size) == 0;
+	}
+
+	// .............................................................
+	/// @return the slot with the key, or the empty one where it would go
+	// .............................................................
+	size_t probe (uint32_t h, const void * data, size_t size) const {
+	  size_t i = h & mask;
+	  while ( slots[i].used && ! sameKey (slots[i], h, data, size) ) {
+		i = (i + 1) & mask;
+	  }
+	  return i;
+	}
+
+	// .............................................................
+	/// Double the table (keeps the load factor under 3/4).
+	// .............................................................
+	void grow () {
+	  std::vector<Slot> old;
+	  old.swap (slots);
+	  // (made anew, not resized: values need only be movable)
+	  slots = std::vector<Slot> (old.size () * 2);
+	  mask = slots.size () - 1;
+	  for (auto & s : old) {
+		if ( s.used ) {
+		  size_t i = s.hash & mask;
+		  while ( slots[i].used ) {
+			i = (i + 1) & mask;
+		  }
+		  slots[i] = std::move (s);
+		}
+	  }
+	}
+
+  public:
+
+	// .............................................................
+	/// @param capacity expected number of clients (avoids growing)
+	// .............................................................
+	explicit IdentityMap (size_t capacity = 64) {
+	  size_t n = 16;
+	  while ( n * 3 < capacity * 4 ) {
+		n *= 2;
+	  }
+	  slots = std::vector<Slot> (n);
+	  mask = n - 1;
+	}
+
+	// .............................................................
+	/// @return the value for the identity, or nullptr.
+	// .............................................................
+	V * find (const void * data, size_t size) {
+	  uint32_t h = hashBytes (data, size);
+	  size_t i = probe (h, data, size);
+	  return slots[i].used ? &slots[i].value : nullptr;
+	}
+
+	V * find (const zmq::message_t & identity) {
+	  return find (identity.data (), identity.size ());
+	}
+
+	// .............................................................
+	/// @return the value for the identity (default constructed
+	/// and inserted if it was not there).
+	// .............................................................
+	V & findOrInsert (const void * data, size_t size) {
+	  uint32_t h = hashBytes (data, size);
+	  size_t i = probe (h, data, size);
+	  if ( slots[i].used ) {
+		return slots[i].value;
+	  }
+
+	  if ( (count + 1) * 4 > slots.size () * 3 ) {
+		grow ();
+		i = probe (h, data, size);
+	  }
+
+	  Slot & s = slots[i];
+	  s.used = true;
+	  s.hash = h;
+	  s.key.assign (static_cast<const char *> (data), size);
+	  s.value = V {};
+	  count++;
+	  return s.value;
+	}
+
+	V & findOrInsert (const zmq::message_t & identity) {
+	  return findOrInsert (identity.data (), identity.size ());
+	}
+
+	V & findOrInsert (const std::string & identity) {
+	  return findOrInsert (identity.data (), identity.size ());
+	}
+
+	// .............................................................
+	/// Remove the identity (backward shift: no tombstones).
+	/// @return true if it was there.
+	// .............................................................
+	bool erase (const void * data, size_t size) {
+	  uint32_t h = hashBytes (data, size);
+	  size_t i = probe (h, data, size);
+	  if ( ! slots[i].used ) {
+		return false;
+	  }
+
+	  // move back the followers that are out of their place
+	  size_t j = i;
+	  while (true) {
+		j = (j + 1) & mask;
+		if ( ! slots[j].used ) {
+		  break;
+		}
+		size_t home = slots[j].hash & mask;
+		// can slot j move to i? (is home not in (i, j] cyclically)
+		bool between = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+		if ( ! between ) {
+		  slots[i] = std::move (slots[j]);
+		  i = j;
+		}
+	  }
+
+	  slots[i].used = false;
+	  slots[i].key.clear ();
+	  slots[i].value = V {};
+	  count--;
+	  return true;
+	}
+
+	bool erase (const zmq::message_t & identity) {
+	  return erase (identity.data (), identity.size ());
+	}
+
+	// .............................................................
+	// .............................................................
+	size_t size () const {
+	  return count;
+	}
+
+	// .............................................................
+	/// Visit every (identity, value).
+	// .............................................................
+	void forEach (std::function<void(const std::string &, V &)> f) {
+	  for (auto & s : slots) {
+		if ( s.used ) {
+		  f (s.key, s.value);
+		}
+	  }
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperOptions.hpp
+ *
+ * Typed socket options, checked at compile time against the type
+ * of the socket, and profiles (sets of options) for the usual
+ * goals:
+ *
+ *    SocketAdaptor<ZMQ_PUSH> out {theContext};
+ *    out.set<option::SendHwm> (10000);
+ *    out.set<option::Linger> (0);
+ *    // out.set<option::ReceiveHwm> (10); // does not compile (PUSH)
+ *
+ *    SocketAdaptor<ZMQ_DEALER> client {theContext, profile::LowLatency {}};
+ *
+ * No getZmqSocket() needed: the calling thread is checked, as
+ * in any other call.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_OPTIONS_H
+#define ZQM_HELPER_OPTIONS_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <type_traits>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  namespace option {
+
+	// .............................................................
+	/// Which sockets send, receive ...
+	// .............................................................
+	constexpr bool anySocket (int) {
+	  return true;
+	}
+
+	constexpr bool sends (int type) {
+	  return type != ZMQ_PULL && type != ZMQ_SUB;
+	}
+
+	constexpr bool receives (int type) {
+	  return type != ZMQ_PUSH && type != ZMQ_PUB;
+	}
+
+	/// (conflate does not support multipart messages)
+	constexpr bool conflates (int type) {
+	  return type == ZMQ_PUSH || type == ZMQ_PULL || type == ZMQ_PUB
+		|| type == ZMQ_SUB || type == ZMQ_DEALER;
+	}
+
+	/// (its identity is seen by a ROUTER peer)
+	constexpr bool routed (int type) {
+	  return type == ZMQ_REQ || type == ZMQ_DEALER || type == ZMQ_ROUTER;
+	}
+
+	constexpr bool router (int type) {
+	  return type == ZMQ_ROUTER;
+	}
+
+	constexpr bool xpub (int type) {
+	  return type == ZMQ_XPUB;
+	}
+
+	// .............................................................
+	// .............................................................
+	template<int ID, typename T>
+	struct OptionOf {
+	  static constexpr int id = ID;
+	  using value_type = T;
+	};
+
+	// .............................................................
+	/// Queues: messages held at most (per peer)
+	// .............................................................
+	struct SendHwm : OptionOf<ZMQ_SNDHWM, int> {
+	  static constexpr bool validFor (int type) { return sends (type); }
+	};
+
+	struct ReceiveHwm : OptionOf<ZMQ_RCVHWM, int> {
+	  static constexpr bool validFor (int type) { return receives (type); }
+	};
+
+	// .............................................................
+	/// Kernel buffers (bytes, tcp)
+	// .............................................................
+	struct SendBuffer : OptionOf<ZMQ_SNDBUF, int> {
+	  static constexpr bool validFor (int type) { return sends (type); }
+	};
+
+	struct ReceiveBuffer : OptionOf<ZMQ_RCVBUF, int> {
+	  static constexpr bool validFor (int type) { return receives (type); }
+	};
+
+	// .............................................................
+	/// 1: queue messages only to completed connections
+	// .............................................................
+	struct Immediate : OptionOf<ZMQ_IMMEDIATE, int> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	// .............................................................
+	/// 1: keep only the last message (single part ones)
+	// .............................................................
+	struct Conflate : OptionOf<ZMQ_CONFLATE, int> {
+	  static constexpr bool validFor (int type) { return conflates (type); }
+	};
+
+	// .............................................................
+	/// ms to keep unsent messages after close (-1: forever)
+	// .............................................................
+	struct Linger : OptionOf<ZMQ_LINGER, int> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	// .............................................................
+	/// Bitmask of the I/O threads of the context to use
+	// .............................................................
+	struct Affinity : OptionOf<ZMQ_AFFINITY, uint64_t> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	// .............................................................
+	/// ms to wait for a send / receive (-1: forever)
+	// .............................................................
+	struct SendTimeout : OptionOf<ZMQ_SNDTIMEO, int> {
+	  static constexpr bool validFor (int type) { return sends (type); }
+	};
+
+	struct ReceiveTimeout : OptionOf<ZMQ_RCVTIMEO, int> {
+	  static constexpr bool validFor (int type) { return receives (type); }
+	};
+
+	// .............................................................
+	/// ms before reconnecting
+	// .............................................................
+	struct ReconnectInterval : OptionOf<ZMQ_RECONNECT_IVL, int> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	// .............................................................
+	/// TCP keepalive (-1: OS default, 0: off, 1: on), and its
+	/// idle time, interval (s) and count
+	// .............................................................
+	struct TcpKeepalive : OptionOf<ZMQ_TCP_KEEPALIVE, int> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	struct TcpKeepaliveIdle : OptionOf<ZMQ_TCP_KEEPALIVE_IDLE, int> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	struct TcpKeepaliveInterval : OptionOf<ZMQ_TCP_KEEPALIVE_INTVL, int> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	struct TcpKeepaliveCount : OptionOf<ZMQ_TCP_KEEPALIVE_CNT, int> {
+	  static constexpr bool validFor (int type) { return anySocket (type); }
+	};
+
+	// .............................................................
+	/// The identity seen by a ROUTER peer
+	// .............................................................
+	struct RoutingId : OptionOf<ZMQ_IDENTITY, std::string> {
+	  static constexpr bool validFor (int type) { return routed (type); }
+	};
+
+	// .............................................................
+	/// 1: sending to an unknown identity fails (not dropped)
+	// .............................................................
+	struct RouterMandatory : OptionOf<ZMQ_ROUTER_MANDATORY, int> {
+	  static constexpr bool validFor (int type) { return router (type); }
+	};
+
+	// .............................................................
+	/// 1: pass up every subscribe (not only new ones); VERBOSER,
+	/// every unsubscribe too
+	// .............................................................
+	struct XpubVerbose : OptionOf<ZMQ_XPUB_VERBOSE, int> {
+	  static constexpr bool validFor (int type) { return xpub (type); }
+	};
+
+#ifdef ZMQ_XPUB_VERBOSER
+	struct XpubVerboser : OptionOf<ZMQ_XPUB_VERBOSER, int> {
+	  static constexpr bool validFor (int type) { return xpub (type); }
+	};
+#endif
+
+	// .............................................................
+	/// Set the option if it makes sense for the socket, else
+	/// nothing (for profiles, that apply to any socket).
+	// .............................................................
+	template<typename Option, int ZMQ_SOCKET_TYPE>
+	void setIfValid (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket,
+					 const typename Option::value_type & value, std::true_type) {
+	  socket.template set<Option> (value);
+	}
+
+	template<typename Option, int ZMQ_SOCKET_TYPE>
+	void setIfValid (SocketAdaptor<ZMQ_SOCKET_TYPE> &,
+					 const typename Option::value_type &, std::false_type) {
+	}
+
+	template<typename Option, int ZMQ_SOCKET_TYPE>
+	void setIfValid (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket,
+					 const typename Option::value_type & value) {
+	  setIfValid<Option> (socket, value,
+						  std::integral_constant<bool, Option::validFor (ZMQ_SOCKET_TYPE)> {});
+	}
+
+  }; // namespace option
+
+  // ---------------------------------------------------------------
+  /// Profiles: give one to the constructor of a SocketAdaptor
+  /// (or call applyTo). Fields may be changed before.
+  // ---------------------------------------------------------------
+  namespace profile {
+
+	// .............................................................
+	/// Short queues (a message waits little, or is not taken),
+	/// nothing queued for peers not connected yet, nothing kept
+	/// on close.
+	// .............................................................
+	struct LowLatency {
+	  int hwm = 100;
+
+	  template<int ZMQ_SOCKET_TYPE>
+	  void applyTo (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket) const {
+		option::setIfValid<option::SendHwm> (socket, hwm);
+		option::setIfValid<option::ReceiveHwm> (socket, hwm);
+		option::setIfValid<option::Immediate> (socket, 1);
+		option::setIfValid<option::Linger> (socket, 0);
+	  }
+	};
+
+	// .............................................................
+	/// Long queues and big kernel buffers: bursts do not stall
+	/// the sender, batches fill the tcp segments.
+	// .............................................................
+	struct HighThroughput {
+	  int hwm = 100000;
+	  int buffer = 4 * 1024 * 1024;
+
+	  template<int ZMQ_SOCKET_TYPE>
+	  void applyTo (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket) const {
+		option::setIfValid<option::SendHwm> (socket, hwm);
+		option::setIfValid<option::ReceiveHwm> (socket, hwm);
+		option::setIfValid<option::SendBuffer> (socket, buffer);
+		option::setIfValid<option::ReceiveBuffer> (socket, buffer);
+	  }
+	};
+
+	// .............................................................
+	/// A hard bound on what the socket holds: short queues, small
+	/// kernel buffers, nothing queued for absent peers, nothing
+	/// kept on close.
+	// .............................................................
+	struct BoundedMemory {
+	  int hwm = 100;
+	  int buffer = 64 * 1024;
+
+	  template<int ZMQ_SOCKET_TYPE>
+	  void applyTo (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket) const {
+		option::setIfValid<option::SendHwm> (socket, hwm);
+		option::setIfValid<option::ReceiveHwm> (socket, hwm);
+		option::setIfValid<option::SendBuffer> (socket, buffer);
+		option::setIfValid<option::ReceiveBuffer> (socket, buffer);
+		option::setIfValid<option::Immediate> (socket, 1);
+		option::setIfValid<option::Linger> (socket, 0);
+	  }
+	};
+
+  }; // namespace profile
+
+}; // namespace
+
+#endif
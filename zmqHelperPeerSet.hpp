@@ -0,0 +1,175 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperPeerSet.hpp
+ *
+ * PeerSet: a DEALER connected to each of some peers (REP, or
+ * anything echoing the envelope), and requests with a correlation
+ * frame before the delimiter:
+ *
+ *    "<correlation>", "", body...
+ *
+ * so replies to earlier requests (late ones, the losers of a
+ * hedge) are told and dropped:
+ *
+ *    PeerSet peers {context, urls};
+ *    peers.send (0, "7.0", {"GET", "key"});
+ *    size_t p = peers.receive ("7.", 100, reply);  // peers.size (): none
+ *
+ * The common part of HedgingClient and ScatterGather.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_PEER_SET_H
+#define ZQM_HELPER_PEER_SET_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The PeerSet class. Its sockets are created by the thread
+  /// calling the constructor: use it from that one.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class PeerSet {
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	std::vector< std::unique_ptr< SocketAdaptor<ZMQ_DEALER> > > peers;
+	std::vector<zmq::pollitem_t> items;
+	std::vector<long> pending; // sent to each peer, not answered
+	size_t nextPeer = 0;       // the first one looked at (fairness)
+	unsigned long ignored = 0;
+
+	std::vector<zmq::message_t> frames;
+
+	PeerSet (const PeerSet & o) = delete;
+	PeerSet & operator=(const PeerSet & o) = delete;
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param context zmq context
+	/// @param urls of the peers (one DEALER for each)
+	// .............................................................
+	PeerSet (zmq::context_t & context, const std::vector<std::string> & urls)
+	  : pending (urls.size (), 0)
+	{
+	  for (const auto & url : urls) {
+		peers.emplace_back ( new SocketAdaptor<ZMQ_DEALER> {context} );
+		peers.back()->connect (url);
+		items.push_back ( { *peers.back()->getZmqSocket (), 0, ZMQ_POLLIN, 0 } );
+	  }
+	}
+
+	// .............................................................
+	/// Send correlation, "", body to peer p.
+	// .............................................................
+	void send (size_t p, const std::string & correlation, const std::vector<std::string> & body) {
+	  std::vector<std::string> lines;
+	  lines.reserve (body.size () + 2);
+	  lines.push_back (correlation);
+	  lines.push_back ("");
+	  lines.insert (lines.end (), body.begin (), body.end ());
+	  peers[p]->sendText (lines);
+	  pending[p]++;
+	}
+
+	// .............................................................
+	/// Wait up to time ms (-1 = forever) for a reply whose
+	/// correlation starts with prefix; others are dropped.
+	/// @param reply gets its body
+	/// @param correlation (if not null) gets its correlation
+	/// @return the peer replying, size() if none in time
+	// .............................................................
+	size_t receive (const std::string & prefix, long time, std::vector<std::string> & reply,
+					std::string * correlation = nullptr) {
+
+	  auto end = Clock::now () + std::chrono::milliseconds (std::max (0L, time));
+	  while (true) {
+
+		long wait = -1;
+		if ( time >= 0 ) {
+		  wait = std::max (0L, (long) std::chrono::duration_cast<std::chrono::milliseconds>
+						   (end - Clock::now ()).count ());
+		}
+
+		if ( zmq::poll (items.data (), items.size (), wait) <= 0 ) {
+		  if ( time >= 0 && Clock::now () >= end ) {
+			return peers.size ();
+		  }
+		  continue;
+		}
+
+		for (size_t k=0; k<peers.size (); k++) {
+		  size_t p = (nextPeer + k) % peers.size ();
+		  if ( ! (items[p].revents & ZMQ_POLLIN) ) {
+			continue;
+		  }
+		  peers[p]->receiveFrames (frames, 0);
+		  pending[p]--;
+
+		  // correlation, delimiter, body
+		  if ( frames.size () < 2 || frames[0].size () < prefix.size ()
+			   || memcmp (frames[0].data (), prefix.data (), prefix.size ()) != 0 ) {
+			ignored++; // to an earlier request
+			continue;
+		  }
+
+		  if ( correlation != nullptr ) {
+			correlation->assign (static_cast<const char *> (frames[0].data ()), frames[0].size ());
+		  }
+		  reply.resize (frames.size () - 2);
+		  for (size_t i=2; i<frames.size (); i++) {
+			reply[i-2].assign (static_cast<const char *> (frames[i].data ()), frames[i].size ());
+		  }
+		  nextPeer = (p + 1) % peers.size ();
+		  return p;
+		}
+	  } // while
+	}
+
+	// .............................................................
+	/// @return how many peers
+	// .............................................................
+	size_t size () const {
+	  return peers.size ();
+	}
+
+	// .............................................................
+	/// @return requests sent to peer p, not answered yet
+	// .............................................................
+	long pendingAt (size_t p) const {
+	  return pending[p];
+	}
+
+	// .............................................................
+	/// @return replies to earlier requests, dropped
+	// .............................................................
+	unsigned long ignoredCount () const {
+	  return ignored;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
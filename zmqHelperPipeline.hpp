@@ -0,0 +1,466 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperPipeline.hpp
+ *
+ * Pipeline: the parallel pipeline pattern (ventilator -> stages
+ * of workers -> sink) over PUSH/PULL sockets, inproc or ipc:
+ *
+ *    Pipeline pipe {context, "inproc://words"};
+ *    pipe.addStage ("parse", 2, parseFunction);
+ *    pipe.addStage ("count", 4, countFunction);
+ *    pipe.setSink (sinkFunction);
+ *    pipe.start ();
+ *
+ *    auto job = pipe.submit (items);   // the calling thread ventilates
+ *    pipe.waitJob (job);               // all its items reached the sink
+ *
+ * Each worker of a stage binds its own PULL, and the PUSH of each
+ * worker of the previous stage connects to all of them (PUSH sends
+ * round robin, skipping the full ones): no device in the middle.
+ * Send and receive HWMs bound the items in flight, so a slow stage
+ * holds back the ones before it (backpressure), up to submit().
+ *
+ * Every item carries its job number and the job size: the sink
+ * knows when a job is complete (items dropped by a stage are
+ * still counted).
+ *
+ * stats() tells, for each stage, items/s and how busy its workers
+ * are: the busiest stage is the one to give more workers.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_PIPELINE_H
+#define ZQM_HELPER_PIPELINE_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include "zmqHelperOptions.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The Pipeline class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class Pipeline {
+
+  public:
+
+	// .............................................................
+	/// Transforms an item (in place). @return false to drop it.
+	/// Run by the workers of the stage.
+	// .............................................................
+	using StageFunction = std::function<bool(std::vector<std::string> &)>;
+
+	// .............................................................
+	/// Gets (job, item) at the end. Run by the sink thread.
+	// .............................................................
+	using SinkFunction = std::function<void(unsigned long, const std::vector<std::string> &)>;
+
+	// .............................................................
+	/// Figures of a stage
+	// .............................................................
+	struct StageStats {
+	  std::string name;
+	  unsigned int workers;
+	  unsigned long items;
+	  double itemsPerSecond;
+	  double busy; // 0..1: fraction of the time its workers worked
+	};
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// .............................................................
+	// .............................................................
+	struct Stage {
+	  std::string name;
+	  unsigned int workers;
+	  StageFunction function;
+	  std::vector<std::thread *> threads;
+	  std::atomic<unsigned long> items {0};
+	  std::atomic<unsigned long long> busyNs {0};
+	};
+
+	// .............................................................
+	// .............................................................
+	struct JobState {
+	  unsigned long total = 0;
+	  unsigned long got = 0;
+	};
+
+	// .............................................................
+	// .............................................................
+	zmq::context_t & theContext;
+	const std::string prefix;
+	const int hwm;
+
+	std::vector< std::unique_ptr<Stage> > stages;
+	SinkFunction sink;
+	std::thread * sinkThread = nullptr;
+
+	std::unique_ptr< SocketAdaptor<ZMQ_PUSH> > ventilator;
+	unsigned long lastJob = 0;
+
+	std::atomic<bool> running {false};
+	Clock::time_point startTime;
+
+	// .............................................................
+	/// Sockets bound (they wait for each other before connecting)
+	// .............................................................
+	std::mutex theMutex;
+	std::condition_variable theCondition;
+	unsigned int bound = 0;
+
+	// .............................................................
+	/// Jobs at the sink (with theMutex)
+	// .............................................................
+	std::map<unsigned long, JobState> jobs;
+
+	// .............................................................
+	// .............................................................
+	Pipeline (const Pipeline & o) = delete;
+	Pipeline & operator=(const Pipeline & o) = delete;
+
+	// .............................................................
+	// .............................................................
+	std::string endpointOf (size_t stage, unsigned int worker) const {
+	  return prefix + "-" + std::to_string (stage) + "-" + std::to_string (worker);
+	}
+
+	std::string sinkEndpoint () const {
+	  return prefix + "-sink";
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned int socketsToBind () const {
+	  unsigned int n = 1; // the sink
+	  for (auto & s : stages) {
+		n += s->workers;
+	  }
+	  return n;
+	}
+
+	// .............................................................
+	/// HWMs (and no linger: stop() does not wait for the rest).
+	// .............................................................
+	template<int ZMQ_SOCKET_TYPE>
+	void setOptions (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket) {
+	  option::setIfValid<option::SendHwm> (socket, hwm);
+	  option::setIfValid<option::ReceiveHwm> (socket, hwm);
+	  socket.template set<option::Linger> (0);
+	}
+
+	// .............................................................
+	/// A socket is bound. Wait for all the others to be.
+	// .............................................................
+	void boundAndWait () {
+	  std::unique_lock<std::mutex> theLock {theMutex};
+	  bound++;
+	  theCondition.notify_all ();
+	  unsigned int all = socketsToBind ();
+	  theCondition.wait (theLock, [this, all] () { return bound >= all; });
+	}
+
+	// .............................................................
+	/// Connect to every worker of the stage (or to the sink).
+	// .............................................................
+	void connectTo (SocketAdaptor<ZMQ_PUSH> & out, size_t stage) {
+	  if ( stage == stages.size () ) {
+		out.connect (sinkEndpoint ());
+		return;
+	  }
+	  for (unsigned int w=0; w<stages[stage]->workers; w++) {
+		out.connect (endpointOf (stage, w));
+	  }
+	}
+
+	// .............................................................
+	/// item: job, total, flag ("1": an item, "0": dropped), payload
+	// .............................................................
+	void main_Worker (size_t s, unsigned int w) {
+	  Stage & stage = * stages[s];
+
+	  SocketAdaptor<ZMQ_PULL> in {theContext};
+	  setOptions (in);
+	  in.bind (endpointOf (s, w));
+
+	  boundAndWait ();
+
+	  SocketAdaptor<ZMQ_PUSH> out {theContext};
+	  setOptions (out);
+	  connectTo (out, s+1);
+
+	  std::vector<std::string> lines;
+	  std::vector<std::string> item;
+
+	  while ( running ) {
+		if ( ! in.receiveTextInTimeout (lines, 100) || lines.size () < 3 ) {
+		  continue;
+		}
+
+		if ( lines[2] == "1" ) {
+		  item.assign (lines.begin () + 3, lines.end ());
+
+		  auto t0 = Clock::now ();
+		  bool keep = stage.function (item);
+		  stage.busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>
+			(Clock::now () - t0).count ();
+		  stage.items++;
+
+		  lines.resize (3);
+		  if ( keep ) {
+			lines.insert (lines.end (), item.begin (), item.end ());
+		  } else {
+			lines[2] = "0";
+		  }
+		}
+
+		// not blocking: the next stage may be full (or gone) at stop()
+		zmq::pollitem_t writable [] = { { *out.getZmqSocket (), 0, ZMQ_POLLOUT, 0 } };
+		while ( ! out.trySendText (lines) && running ) {
+		  zmq::poll (writable, 1, 100);
+		}
+	  } // while
+
+	  in.close ();
+	  out.close ();
+	}
+
+	// .............................................................
+	/// @return true if text is a count (decimal digits only), and
+	/// then value gets it
+	// .............................................................
+	static bool countOf (const std::string & text, unsigned long & value) {
+	  if ( text.empty () || text.size () > 18
+		   || text.find_first_not_of ("0123456789") != std::string::npos ) {
+		return false;
+	  }
+	  value = std::stoul (text);
+	  return true;
+	}
+
+	// .............................................................
+	// .............................................................
+	void main_Sink () {
+	  SocketAdaptor<ZMQ_PULL> in {theContext};
+	  setOptions (in);
+	  in.bind (sinkEndpoint ());
+
+	  boundAndWait ();
+
+	  std::vector<std::string> lines;
+	  std::vector<std::string> item;
+
+	  while ( running ) {
+		if ( ! in.receiveTextInTimeout (lines, 100) || lines.size () < 3 ) {
+		  continue;
+		}
+
+		// job, total, flag: else dropped
+		unsigned long job = 0;
+		unsigned long total = 0;
+		if ( ! countOf (lines[0], job) || ! countOf (lines[1], total) || total == 0
+			 || (lines[2] != "1" && lines[2] != "0") ) {
+		  continue;
+		}
+
+		if ( lines[2] == "1" && sink ) {
+		  item.assign (lines.begin () + 3, lines.end ());
+		  sink (job, item);
+		}
+
+		std::unique_lock<std::mutex> theLock {theMutex};
+		JobState & state = jobs[job];
+		state.total = total;
+		state.got++;
+		if ( state.got == state.total ) {
+		  theCondition.notify_all ();
+		}
+	  } // while
+
+	  in.close ();
+	}
+
+	// .............................................................
+	// .............................................................
+	void joinAll () {
+	  for (auto & s : stages) {
+		for (auto t : s->threads) {
+		  t->join ();
+		  delete t;
+		}
+		s->threads.clear ();
+	  }
+	  if ( sinkThread != nullptr ) {
+		sinkThread->join ();
+		delete sinkThread;
+		sinkThread = nullptr;
+	  }
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param aContext context for the sockets
+	/// @param prefix_ endpoints are this + "-stage-worker"
+	/// (f.ex. "inproc://words" or "ipc:///tmp/words")
+	/// @param hwm_ send/receive HWM of every socket
+	// .............................................................
+	Pipeline (zmq::context_t & aContext, const std::string & prefix_, int hwm_ = 1000)
+	  : theContext {aContext}, prefix {prefix_}, hwm {hwm_}
+	{ }
+
+	// .............................................................
+	// .............................................................
+	~Pipeline () {
+	  stop ();
+	}
+
+	// .............................................................
+	/// Add a stage (before start()). Items go through the stages
+	/// in the order added.
+	// .............................................................
+	void addStage (const std::string & name, unsigned int workers, StageFunction function) {
+	  stages.emplace_back ( new Stage {} );
+	  stages.back()->name = name;
+	  stages.back()->workers = std::max (1u, workers);
+	  stages.back()->function = function;
+	}
+
+	// .............................................................
+	/// What to do with the items at the end (before start()).
+	// .............................................................
+	void setSink (SinkFunction function) {
+	  sink = function;
+	}
+
+	// .............................................................
+	/// Start the threads. The calling thread is the ventilator:
+	/// call submit() from it.
+	// .............................................................
+	void start () {
+	  running = true;
+	  startTime = Clock::now ();
+
+	  sinkThread = new std::thread (&Pipeline::main_Sink, this);
+	  for (size_t s=0; s<stages.size (); s++) {
+		for (unsigned int w=0; w<stages[s]->workers; w++) {
+		  stages[s]->threads.push_back ( new std::thread (&Pipeline::main_Worker, this, s, w) );
+		}
+	  }
+
+	  {
+		std::unique_lock<std::mutex> theLock {theMutex};
+		unsigned int all = socketsToBind ();
+		theCondition.wait (theLock, [this, all] () { return bound >= all; });
+	  }
+
+	  ventilator.reset ( new SocketAdaptor<ZMQ_PUSH> {theContext} );
+	  setOptions (*ventilator);
+	  connectTo (*ventilator, 0);
+	}
+
+	// .............................................................
+	/// Send the items of a job down the pipeline. Blocks while
+	/// the first stage is full.
+	/// @return the job number (for waitJob())
+	// .............................................................
+	unsigned long submit (const std::vector< std::vector<std::string> > & items) {
+	  unsigned long job = ++lastJob;
+	  std::string jobText = std::to_string (job);
+	  std::string total = std::to_string (items.size ());
+
+	  if ( items.empty () ) {
+		std::unique_lock<std::mutex> theLock {theMutex};
+		jobs[job] = JobState {};
+		return job;
+	  }
+
+	  std::vector<std::string> lines;
+	  for (auto & item : items) {
+		lines.assign ( {jobText, total, "1"} );
+		lines.insert (lines.end (), item.begin (), item.end ());
+		ventilator->sendText (lines);
+	  }
+	  return job;
+	}
+
+	// .............................................................
+	/// Wait until every item of the job reached the sink.
+	/// @param time timeout in ms (-1 = forever)
+	/// @return false if timed out
+	// .............................................................
+	bool waitJob (unsigned long job, long time = -1) {
+	  std::unique_lock<std::mutex> theLock {theMutex};
+	  auto complete = [this, job] () {
+		auto it = jobs.find (job);
+		return it != jobs.end () && it->second.got == it->second.total;
+	  };
+
+	  if ( time < 0 ) {
+		theCondition.wait (theLock, complete);
+	  } else if ( ! theCondition.wait_for (theLock, std::chrono::milliseconds (time), complete) ) {
+		return false;
+	  }
+	  jobs.erase (job);
+	  return true;
+	}
+
+	// .............................................................
+	/// Stop and join the threads (items in flight are lost:
+	/// wait for the jobs first). From the ventilator thread.
+	// .............................................................
+	void stop () {
+	  if ( ! running ) {
+		return;
+	  }
+	  running = false;
+	  joinAll ();
+	  if ( ventilator ) {
+		ventilator->close ();
+		ventilator.reset ();
+	  }
+	}
+
+	// .............................................................
+	/// @return the figures of each stage (since start())
+	// .............................................................
+	std::vector<StageStats> stats () const {
+	  double seconds = std::chrono::duration<double> (Clock::now () - startTime).count ();
+	  std::vector<StageStats> result;
+	  for (auto & s : stages) {
+		StageStats st;
+		st.name = s->name;
+		st.workers = s->workers;
+		st.items = s->items;
+		st.itemsPerSecond = seconds > 0 ? st.items / seconds : 0;
+		st.busy = seconds > 0 ? s->busyNs / (seconds * 1e9 * s->workers) : 0;
+		result.push_back (st);
+	  }
+	  return result;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
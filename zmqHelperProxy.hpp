@@ -0,0 +1,462 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperProxy.hpp
+ *
+ * Proxy: forwards whole multipart messages between a frontend and
+ * a backend socket moving the zmq frames (no copy into strings
+ * and back). Like zmq_proxy_steerable():
+ *
+ *  - optional capture socket: gets a (reference counted, not
+ *    copied) duplicate of every frame forwarded.
+ *  - optional control socket: accepts the commands
+ *    "PAUSE", "RESUME", "TERMINATE" and "STATISTICS".
+ *    (If the control socket is a REP, every command gets a reply).
+ *
+ * and it counts messages and bytes (and rates) in each direction.
+ *
+ * Optional stages (ProxyStage) see each whole message and may
+ * change it, answer it themselves or hold it (see zmqHelperCache.hpp).
+ *
+ * The proxy does not own the sockets. All of them must be owned
+ * by the thread calling run() (as SocketAdaptor checks).
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_PROXY_H
+#define ZQM_HELPER_PROXY_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <chrono>
+#include <vector>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// Counters of a direction of a Proxy
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  struct ProxyCounters {
+	unsigned long messages = 0;
+	unsigned long frames = 0;
+	unsigned long bytes = 0;
+  };
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// A stage in a Proxy: it gets each whole message (as frames)
+  /// before it is forwarded.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class ProxyStage {
+  public:
+
+	// .............................................................
+	/// Messages sent back to the frontend by a stage
+	// .............................................................
+	using Messages = std::vector< std::vector<zmq::message_t> >;
+
+	virtual ~ProxyStage () { }
+
+	// .............................................................
+	/// A message from the frontend (it may be changed).
+	/// Messages to answer through the frontend go to toFrontend.
+	/// @return true to forward message to the backend
+	// .............................................................
+	virtual bool fromFrontend (std::vector<zmq::message_t> & message,
+							   Messages & toFrontend) = 0;
+
+	// .............................................................
+	/// A message from the backend (it may be changed).
+	/// More messages for the frontend may go to toFrontend.
+	/// @return true to forward message to the frontend
+	// .............................................................
+	virtual bool fromBackend (std::vector<zmq::message_t> & message,
+							  Messages & toFrontend) = 0;
+
+	// .............................................................
+	/// @return ms until the stage wants onTimer() (-1: never)
+	// .............................................................
+	virtual long timerDue () {
+	  return -1;
+	}
+
+	// .............................................................
+	/// Time passed. Messages held by the stage and let go now go to
+	/// toBackend (and on through the next stages).
+	// .............................................................
+	virtual void onTimer (Messages & toBackend, Messages & toFrontend) {
+	  (void) toBackend;
+	  (void) toFrontend;
+	}
+  };
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The Proxy class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  template<int FRONTEND_TYPE, int BACKEND_TYPE>
+  class Proxy {
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	enum Direction { FRONT_TO_BACK = 0, BACK_TO_FRONT = 1 };
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	SocketAdaptor<FRONTEND_TYPE> & frontend;
+	SocketAdaptor<BACKEND_TYPE> & backend;
+
+	ZmqSocketType * captureSocket = nullptr;
+	ZmqSocketType * controlSocket = nullptr;
+	bool controlReplies = false;
+
+	// .............................................................
+	// .............................................................
+	ProxyCounters counters[2];
+	std::chrono::steady_clock::time_point startTime;
+
+	bool paused = false;
+
+	// .............................................................
+	// .............................................................
+	std::vector<ProxyStage *> stages;
+	std::vector<zmq::message_t> message;
+	ProxyStage::Messages toFrontend;
+	ProxyStage::Messages released;
+
+	// .............................................................
+	// .............................................................
+	Proxy (const Proxy & o) = delete;
+	Proxy & operator=(const Proxy & o) = delete;
+
+	// .............................................................
+	/// Send a whole message, moving its frames.
+	// .............................................................
+	static void sendAll (ZmqSocketType * to, std::vector<zmq::message_t> & frames) {
+	  for (unsigned int i=0; i<frames.size (); i++) {
+		to->send (frames[i], i+1<frames.size () ? ZMQ_SNDMORE : 0);
+	  }
+	}
+
+	// .............................................................
+	/// Through the stages: receive the whole message, let them
+	/// see it, then forward it (unless a stage keeps it).
+	// .............................................................
+	void forwardStaged (ZmqSocketType * from, ZmqSocketType * to, Direction dir) {
+
+	  ProxyCounters & c = counters[dir];
+
+	  unsigned int i = 0;
+	  bool more = false;
+	  do {
+		if ( i == message.size () ) {
+		  message.emplace_back ();
+		} else {
+		  message[i].rebuild ();
+		}
+		from->recv (&message[i]);
+		more = hasMore (from);
+
+		c.frames++;
+		c.bytes += message[i].size ();
+
+		if (captureSocket != nullptr) {
+		  zmq::message_t duplicate;
+		  duplicate.copy (&message[i]);
+		  captureSocket->send (duplicate, more ? ZMQ_SNDMORE : 0);
+		}
+		i++;
+	  } while (more);
+	  message.resize (i);
+	  c.messages++;
+
+	  // frontend -> backend: stages in order; back: reverse order
+	  toFrontend.clear ();
+	  bool goOn = true;
+	  if (dir == FRONT_TO_BACK) {
+		for (unsigned int s=0; s<stages.size () && goOn; s++) {
+		  goOn = stages[s]->fromFrontend (message, toFrontend);
+		}
+	  } else {
+		for (unsigned int s=stages.size (); s>0 && goOn; s--) {
+		  goOn = stages[s-1]->fromBackend (message, toFrontend);
+		}
+	  }
+
+	  if (goOn) {
+		sendAll (to, message);
+	  }
+	  ZmqSocketType * front = frontend.getZmqSocket ();
+	  for (auto & m : toFrontend) {
+		sendAll (front, m);
+	  }
+	}
+
+	// .............................................................
+	/// @return the poll timeout the stages need (-1: none)
+	// .............................................................
+	long stagesTimeout () {
+	  long timeout = -1;
+	  for (auto s : stages) {
+		long t = s->timerDue ();
+		if ( t >= 0 && (timeout < 0 || t < timeout) ) {
+		  timeout = t;
+		}
+	  }
+	  return timeout;
+	}
+
+	// .............................................................
+	/// Let the stages release the messages they were holding.
+	// .............................................................
+	void runTimers (ZmqSocketType * back) {
+	  ZmqSocketType * front = frontend.getZmqSocket ();
+	  for (unsigned int s=0; s<stages.size (); s++) {
+		released.clear ();
+		toFrontend.clear ();
+		stages[s]->onTimer (released, toFrontend);
+
+		for (auto & m : released) {
+		  bool goOn = true;
+		  for (unsigned int t=s+1; t<stages.size () && goOn; t++) {
+			goOn = stages[t]->fromFrontend (m, toFrontend);
+		  }
+		  if (goOn) {
+			sendAll (back, m);
+		  }
+		}
+		for (auto & m : toFrontend) {
+		  sendAll (front, m);
+		}
+	  }
+	}
+
+	// .............................................................
+	/// Move one whole message from -> to (and a copy to capture).
+	// .............................................................
+	void forward (ZmqSocketType * from, ZmqSocketType * to, Direction dir) {
+
+	  if ( ! stages.empty () ) {
+		forwardStaged (from, to, dir);
+		return;
+	  }
+
+	  ProxyCounters & c = counters[dir];
+
+	  bool more = false;
+	  do {
+		zmq::message_t frame;
+		from->recv (&frame);
+		more = hasMore (from);
+
+		c.frames++;
+		c.bytes += frame.size ();
+
+		if (captureSocket != nullptr) {
+		  zmq::message_t duplicate;
+		  duplicate.copy (&frame); // reference counted, not copied
+		  captureSocket->send (duplicate, more ? ZMQ_SNDMORE : 0);
+		}
+
+		to->send (frame, more ? ZMQ_SNDMORE : 0);
+	  } while (more);
+
+	  c.messages++;
+	}
+
+	// .............................................................
+	/// @return false if the proxy must terminate
+	// .............................................................
+	bool handleControl () {
+
+	  zmq::message_t command;
+	  controlSocket->recv (&command);
+	  while ( hasMore (controlSocket) ) {
+		zmq::message_t ignored;
+		controlSocket->recv (&ignored);
+	  }
+
+	  std::string text { (char *) command.data (), command.size () };
+
+	  std::vector<std::string> reply = { "OK" };
+	  bool goOn = true;
+
+	  if (text == "PAUSE") {
+		paused = true;
+	  } else if (text == "RESUME") {
+		paused = false;
+	  } else if (text == "TERMINATE") {
+		goOn = false;
+	  } else if (text == "STATISTICS") {
+		reply = statisticsText ();
+	  } else {
+		reply = { "ERROR", "unknown command: " + text };
+	  }
+
+	  if (controlReplies) {
+		for (unsigned int i=0; i<reply.size (); i++) {
+		  zmq::message_t m (reply[i].size ());
+		  memcpy (m.data (), reply[i].c_str (), reply[i].size ());
+		  controlSocket->send (m, i+1<reply.size () ? ZMQ_SNDMORE : 0);
+		}
+	  }
+
+	  return goOn;
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	// .............................................................
+	Proxy (SocketAdaptor<FRONTEND_TYPE> & front, SocketAdaptor<BACKEND_TYPE> & back)
+	  : frontend {front}, backend {back}
+	{
+	  startTime = std::chrono::steady_clock::now ();
+	}
+
+	// .............................................................
+	/// Every frame forwarded is also sent (not copied) to this socket.
+	// .............................................................
+	template<int CAPTURE_TYPE>
+	void setCapture (SocketAdaptor<CAPTURE_TYPE> & capture) {
+	  captureSocket = capture.getZmqSocket ();
+	}
+
+	// .............................................................
+	/// Commands (PAUSE, RESUME, TERMINATE, STATISTICS) come here.
+	// .............................................................
+	template<int CONTROL_TYPE>
+	void setControl (SocketAdaptor<CONTROL_TYPE> & control) {
+	  controlSocket = control.getZmqSocket ();
+	  controlReplies = (CONTROL_TYPE == ZMQ_REP);
+	}
+
+	// .............................................................
+	/// Add a stage (not owned). Messages from the frontend go
+	/// through the stages in the order added, the ones from the
+	/// backend in the reverse order.
+	// .............................................................
+	void addStage (ProxyStage & stage) {
+	  stages.push_back (&stage);
+	}
+
+	// .............................................................
+	/// Forward messages until TERMINATE is received on the control
+	/// socket (without control socket: forever).
+	// .............................................................
+	void run () {
+
+	  // the calling thread must own the sockets (they check it)
+	  ZmqSocketType * front = frontend.getZmqSocket ();
+	  ZmqSocketType * back = backend.getZmqSocket ();
+
+	  startTime = std::chrono::steady_clock::now ();
+
+	  while (true) {
+
+		// paused: only the control socket is listened to
+		zmq::pollitem_t items [3];
+		int many = 0;
+		int controlAt = -1, frontAt = -1, backAt = -1;
+		if (controlSocket != nullptr) {
+		  controlAt = many;
+		  items[many++] = { *controlSocket, 0, ZMQ_POLLIN, 0 };
+		}
+		if ( ! paused ) {
+		  frontAt = many;
+		  items[many++] = { *front, 0, ZMQ_POLLIN, 0 };
+		  backAt = many;
+		  items[many++] = { *back, 0, ZMQ_POLLIN, 0 };
+		}
+
+		zmq::poll ( &items[0], many, paused ? -1 : stagesTimeout () );
+
+		if ( controlAt >= 0 && (items[controlAt].revents & ZMQ_POLLIN) ) {
+		  if ( ! handleControl () ) {
+			return;
+		  }
+		  continue;
+		}
+
+		if ( frontAt >= 0 && (items[frontAt].revents & ZMQ_POLLIN) ) {
+		  forward (front, back, FRONT_TO_BACK);
+		}
+		if ( backAt >= 0 && (items[backAt].revents & ZMQ_POLLIN) ) {
+		  forward (back, front, BACK_TO_FRONT);
+		}
+		if ( ! paused && ! stages.empty () ) {
+		  runTimers (back);
+		}
+	  } // while
+	}
+
+	// .............................................................
+	/// @return counters for one direction
+	// .............................................................
+	const ProxyCounters & getCounters (Direction dir) const {
+	  return counters[dir];
+	}
+
+	// .............................................................
+	/// @return messages per second forwarded in one direction
+	/// (since run() started)
+	// .............................................................
+	double messageRate (Direction dir) const {
+	  double seconds = std::chrono::duration<double>
+		(std::chrono::steady_clock::now () - startTime).count ();
+	  return seconds > 0 ? counters[dir].messages / seconds : 0;
+	}
+
+	// .............................................................
+	/// @return bytes per second forwarded in one direction
+	// .............................................................
+	double byteRate (Direction dir) const {
+	  double seconds = std::chrono::duration<double>
+		(std::chrono::steady_clock::now () - startTime).count ();
+	  return seconds > 0 ? counters[dir].bytes / seconds : 0;
+	}
+
+	// .............................................................
+	/// @return the STATISTICS reply: for each direction
+	/// "frontToBack"/"backToFront", messages, bytes, msg/s, bytes/s
+	// .............................................................
+	std::vector<std::string> statisticsText () const {
+	  std::vector<std::string> lines;
+	  const char * names[] = { "frontToBack", "backToFront" };
+	  for (int d=0; d<2; d++) {
+		Direction dir = (Direction) d;
+		lines.push_back (names[d]);
+		lines.push_back (std::to_string (counters[d].messages));
+		lines.push_back (std::to_string (counters[d].bytes));
+		lines.push_back (std::to_string (messageRate (dir)));
+		lines.push_back (std::to_string (byteRate (dir)));
+	  }
+	  return lines;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperRateLimit.hpp
+ *
+ * Per client rate limiting at a ROUTER front end, so one noisy
+ * client can not flood the workers.
+ *
+ * RateLimiter: a token bucket for each client, keyed by the raw
+ * bytes of its ROUTER identity (in an IdentityMap: open addressing,
+ * no allocation per lookup). Buckets are refilled lazily, when the
+ * client sends again: no timers per client. Buckets of clients
+ * gone quiet (full again) are dropped now and then.
+ *
+ *    RateLimiter limiter {100, 20}; // 100 requests/s, bursts of 20
+ *    ...
+ *    router.receiveEnvelope (env);
+ *    if ( limiter.admit (env.identity) != 0 ) {
+ *      router.reply (env, { RATE_LIMITED_REPLY });
+ *      ...
+ *
+ * With a maximum delay, requests over the limit may wait for
+ * their token (admit() returns the wait) instead of being rejected.
+ *
+ * RateLimitStage does it in a Proxy (ROUTER frontend), before the
+ * requests reach a worker: rejected ones are answered with
+ * RATE_LIMITED_REPLY, delayed ones are held by the stage.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_RATE_LIMIT_H
+#define ZQM_HELPER_RATE_LIMIT_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#include "zmqHelperProxy.hpp"
+#include "zmqHelperIdentityMap.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// Reply body of a request rejected for being over the limit
+  // -----------------------------------------------------------------
+  const char RATE_LIMITED_REPLY[] = "RATE_LIMITED";
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The RateLimiter class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class RateLimiter {
+
+  public:
+
+	// .............................................................
+	/// admit() result: rejected
+	// .............................................................
+	static const long REJECT = -1;
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	struct Bucket {
+	  double tokens = 0;   // may be negative: tokens promised to waiters
+	  long long last = 0;  // us, last refill
+	};
+
+	// .............................................................
+	// .............................................................
+	const double rate;   // tokens per us
+	const double burst;
+	const long long maxDelay; // us
+
+	IdentityMap<Bucket> buckets;
+	size_t sweepAt;
+
+	unsigned long admitted = 0;
+	unsigned long delayed = 0;
+	unsigned long rejected = 0;
+
+	// .............................................................
+	// .............................................................
+	static long long nowUs () {
+	  return std::chrono::duration_cast<std::chrono::microseconds>
+		(std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+	}
+
+	// .............................................................
+	/// Drop the buckets of clients which would be full by now:
+	/// they are like new ones.
+	// .............................................................
+	void sweepIdle (long long now) {
+	  std::vector<std::string> idle;
+	  buckets.forEach ( [&] (const std::string & id, Bucket & b) {
+		  if ( b.tokens + rate * (now - b.last) >= burst ) {
+			idle.push_back (id);
+		  }
+		} );
+	  for (auto & id : idle) {
+		buckets.erase (id.data (), id.size ());
+	  }
+	  // not to sweep again soon if most of them are active
+	  sweepAt = std::max (sweepAt, 2 * buckets.size ());
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param perSecond requests per second of each client
+	/// @param burst_ requests a client may send at once
+	/// @param maxDelayMs a request over the limit waits up to this
+	/// for its token (0: rejected at once)
+	/// @param clients expected (initial size of the table)
+	// .............................................................
+	RateLimiter (double perSecond, double burst_, long maxDelayMs = 0,
+				 size_t clients = 1024)
+	  : rate {perSecond / 1e6}, burst {burst_}, maxDelay {maxDelayMs * 1000LL},
+		buckets {clients}, sweepAt {clients}
+	{ }
+
+	// .............................................................
+	/// A request from the client with this identity.
+	/// @return 0: go on; > 0: go on after these ms (its token is
+	/// taken); REJECT: over the limit
+	// .............................................................
+	long admit (const void * id, size_t size, long long now = nowUs ()) {
+
+	  if ( buckets.size () >= sweepAt ) {
+		sweepIdle (now);
+	  }
+
+	  Bucket * b = buckets.find (id, size);
+	  if ( b == nullptr ) {
+		b = & buckets.findOrInsert (id, size);
+		b->tokens = burst;
+		b->last = now;
+	  }
+
+	  // lazy refill
+	  b->tokens = std::min (burst, b->tokens + rate * (now - b->last));
+	  b->last = now;
+
+	  if ( b->tokens >= 1.0 ) {
+		b->tokens -= 1.0;
+		admitted++;
+		return 0;
+	  }
+
+	  // when will there be a token for this one?
+	  long long wait = (long long) ((1.0 - b->tokens) / rate);
+	  if ( wait > maxDelay ) {
+		rejected++;
+		return REJECT;
+	  }
+
+	  b->tokens -= 1.0;
+	  delayed++;
+	  return std::max (1LL, (wait + 999) / 1000);
+	}
+
+	long admit (const zmq::message_t & identity) {
+	  return admit (identity.data (), identity.size ());
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned long admittedCount () const { return admitted; }
+	unsigned long delayedCount () const { return delayed; }
+	unsigned long rejectedCount () const { return rejected; }
+
+	// .............................................................
+	/// @return clients with a bucket now
+	// .............................................................
+	size_t clientCount () const { return buckets.size (); }
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The RateLimitStage class: a RateLimiter in a Proxy with
+  /// a ROUTER frontend (the first frame is the client identity).
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class RateLimitStage : public ProxyStage {
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	RateLimiter & limiter;
+
+	// held requests, by the time they may go (in arrival order
+	// for the same time: so, in order for each client)
+	std::multimap<Clock::time_point, std::vector<zmq::message_t>> held;
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	explicit RateLimitStage (RateLimiter & limiter_) : limiter {limiter_} { }
+
+	// .............................................................
+	// .............................................................
+	bool fromFrontend (std::vector<zmq::message_t> & message,
+					   Messages & toFrontend) override {
+	  if ( message.empty () ) {
+		return true;
+	  }
+
+	  long wait = limiter.admit (message[0]);
+	  if ( wait == 0 ) {
+		return true;
+	  }
+
+	  if ( wait > 0 ) {
+		held.emplace ( Clock::now () + std::chrono::milliseconds (wait), std::move (message) );
+		message.clear ();
+		return false;
+	  }
+
+	  // rejected: route..., "", RATE_LIMITED_REPLY
+	  size_t b = bodyStart (message);
+	  message.resize (b);
+	  message.push_back ( textFrame (RATE_LIMITED_REPLY) );
+	  toFrontend.push_back ( std::move (message) );
+	  message.clear ();
+	  return false;
+	}
+
+	// .............................................................
+	// .............................................................
+	bool fromBackend (std::vector<zmq::message_t> & message,
+					  Messages & toFrontend) override {
+	  (void) message;
+	  (void) toFrontend;
+	  return true;
+	}
+
+	// .............................................................
+	// .............................................................
+	long timerDue () override {
+	  if ( held.empty () ) {
+		return -1;
+	  }
+	  // in ms, rounding up (not to wake up before it is time)
+	  auto wait = std::chrono::duration_cast<std::chrono::microseconds>
+		(held.begin()->first - Clock::now ()).count ();
+	  return std::max (0L, (long) ((wait + 999) / 1000));
+	}
+
+	// .............................................................
+	// .............................................................
+	void onTimer (Messages & toBackend, Messages & toFrontend) override {
+	  (void) toFrontend;
+	  auto now = Clock::now ();
+	  while ( ! held.empty () && held.begin()->first <= now ) {
+		toBackend.push_back ( std::move (held.begin()->second) );
+		held.erase (held.begin ());
+	  }
+	}
+
+	// .............................................................
+	/// @return requests held (delayed) now
+	// .............................................................
+	size_t heldCount () const {
+	  return held.size ();
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
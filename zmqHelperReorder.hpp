@@ -0,0 +1,273 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperReorder.hpp
+ *
+ * ReorderStage: a Proxy stage (ROUTER frontend, DEALER backend
+ * to REP workers) which gives the replies back in the order the
+ * requests arrived, although workers finish them in any order:
+ *
+ *    Proxy< ZMQ_ROUTER, ZMQ_DEALER > proxy {frontend, backend};
+ *    ReorderStage reorder {256};
+ *    proxy.addStage (reorder);
+ *
+ * Each request gets a sequence number (a frame put in its envelope,
+ * given back by REP workers). Replies wait in a ring (the reorder
+ * buffer) until the ones before them are sent. The ring is bounded:
+ * with that many requests in flight, new ones are held back in the
+ * stage until the oldest reply goes out.
+ *
+ * As the order is the one of arrival at the broker, each client
+ * gets its replies in the order of its requests.
+ *
+ * A reply which does not come (a worker died) would stop the
+ * stream: after the gap timeout, it is skipped.
+ *
+ * Requests without a route and a delimiter (route..., "", body)
+ * can not be stamped (nor answered): they are dropped.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_REORDER_H
+#define ZQM_HELPER_REORDER_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+#include "zmqHelperProxy.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// Envelope frame with the sequence number of a request
+  // -----------------------------------------------------------------
+  const char SEQUENCE_TAG[] = "#seq=";
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The ReorderStage class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class ReorderStage : public ProxyStage {
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// .............................................................
+	// .............................................................
+	struct Slot {
+	  bool done = false;
+	  Clock::time_point sentAt;
+	  std::vector<zmq::message_t> reply;
+	};
+
+	// .............................................................
+	// .............................................................
+	std::vector<Slot> ring;
+	unsigned long long head = 0; // next sequence to be sent back
+	unsigned long long next = 0; // next sequence to be given
+
+	const std::chrono::milliseconds gapTimeout;
+
+	// requests waiting for room in the ring
+	std::deque< std::vector<zmq::message_t> > held;
+
+	unsigned long reordered = 0;
+	unsigned long skipped = 0;
+	unsigned long rejected = 0;
+	size_t maxHeld = 0;
+
+	// .............................................................
+	// .............................................................
+	Slot & slotOf (unsigned long long sequence) {
+	  return ring[sequence % ring.size ()];
+	}
+
+	// .............................................................
+	/// @return true if the message is route..., "", body (with
+	/// some route)
+	// .............................................................
+	static bool hasRoute (const std::vector<zmq::message_t> & message) {
+	  size_t b = bodyStart (message);
+	  return b >= 2 && message[b-1].size () == 0;
+	}
+
+	// .............................................................
+	/// Stamp the request (route..., "", body) and take a slot.
+	// .............................................................
+	void stamp (std::vector<zmq::message_t> & message) {
+	  unsigned long long sequence = next++;
+	  Slot & s = slotOf (sequence);
+	  s.done = false;
+	  s.sentAt = Clock::now ();
+
+	  // route..., "#seq=n", "", body (hasRoute checked)
+	  size_t b = bodyStart (message);
+	  message.insert (message.begin () + (b - 1),
+					  textFrame (SEQUENCE_TAG + std::to_string (sequence)));
+	}
+
+	// .............................................................
+	/// Send back the replies which are in order now.
+	// .............................................................
+	void release (Messages & toFrontend) {
+	  while ( head < next ) {
+		Slot & s = slotOf (head);
+		if ( ! s.done ) {
+		  return;
+		}
+		toFrontend.push_back ( std::move (s.reply) );
+		s.reply.clear ();
+		s.done = false;
+		head++;
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	bool full () const {
+	  return next - head >= ring.size ();
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param capacity requests in flight at most (ring size)
+	/// @param gapTimeoutMs a reply not come after this is skipped
+	// .............................................................
+	explicit ReorderStage (size_t capacity = 256, long gapTimeoutMs = 10000)
+	  : ring (capacity), gapTimeout {gapTimeoutMs}
+	{ }
+
+	// .............................................................
+	// .............................................................
+	bool fromFrontend (std::vector<zmq::message_t> & message,
+					   Messages & toFrontend) override {
+	  (void) toFrontend;
+
+	  if ( ! hasRoute (message) ) {
+		rejected++;
+		return false; // a tag in front of the route would misroute it
+	  }
+
+	  if ( full () || ! held.empty () ) {
+		// no room: wait (in order) for the oldest reply
+		held.push_back ( std::move (message) );
+		message.clear ();
+		maxHeld = std::max (maxHeld, held.size ());
+		return false;
+	  }
+
+	  stamp (message);
+	  return true;
+	}
+
+	// .............................................................
+	// .............................................................
+	bool fromBackend (std::vector<zmq::message_t> & message,
+					  Messages & toFrontend) override {
+
+	  // route..., "#seq=n", "", reply
+	  size_t b = bodyStart (message);
+	  long long sequence = -1;
+	  if ( b < 2 || ! taggedNumber (message[b-2], SEQUENCE_TAG, sequence) ) {
+		return true; // not stamped here
+	  }
+
+	  if ( (unsigned long long) sequence < head || (unsigned long long) sequence >= next ) {
+		return false; // skipped already: too late
+	  }
+
+	  message.erase (message.begin () + (b-2));
+
+	  if ( (unsigned long long) sequence != head ) {
+		reordered++;
+	  }
+
+	  Slot & s = slotOf (sequence);
+	  s.reply.swap (message);
+	  s.done = true;
+	  message.clear ();
+
+	  release (toFrontend);
+	  return false;
+	}
+
+	// .............................................................
+	/// Due now if held requests fit in the ring; else at the gap
+	/// timeout of the oldest reply.
+	// .............................................................
+	long timerDue () override {
+	  if ( ! held.empty () && ! full () ) {
+		return 0;
+	  }
+	  if ( head == next ) {
+		return -1;
+	  }
+	  auto due = slotOf (head).sentAt + gapTimeout;
+	  auto wait = std::chrono::duration_cast<std::chrono::milliseconds> (due - Clock::now ()).count ();
+	  return std::max (0L, (long) wait + 1);
+	}
+
+	// .............................................................
+	// .............................................................
+	void onTimer (Messages & toBackend, Messages & toFrontend) override {
+
+	  // skip the replies not come in time
+	  auto now = Clock::now ();
+	  while ( head < next && ! slotOf (head).done
+			  && slotOf (head).sentAt + gapTimeout <= now ) {
+		head++;
+		skipped++;
+		release (toFrontend);
+	  }
+
+	  // held requests which fit now
+	  while ( ! held.empty () && ! full () ) {
+		stamp (held.front ());
+		toBackend.push_back ( std::move (held.front ()) );
+		held.pop_front ();
+	  }
+	}
+
+	// .............................................................
+	/// @return replies that arrived before earlier ones (and waited)
+	// .............................................................
+	unsigned long reorderedCount () const { return reordered; }
+
+	// .............................................................
+	/// @return replies given up (gap timeout)
+	// .............................................................
+	unsigned long skippedCount () const { return skipped; }
+
+	// .............................................................
+	/// @return requests dropped for having no route
+	// .............................................................
+	unsigned long rejectedCount () const { return rejected; }
+
+	// .............................................................
+	/// @return requests in flight now
+	// .............................................................
+	size_t inFlightCount () const { return next - head; }
+
+	// .............................................................
+	/// @return most requests held back at once (ring full)
+	// .............................................................
+	size_t maxHeldCount () const { return maxHeld; }
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperScatterGather.hpp
+ *
+ * ScatterGather: ask every peer (shard) at once and merge the
+ * replies as they arrive, so a query takes as long as the slowest
+ * peer instead of the sum of all of them:
+ *
+ *    ScatterGather shards {context, urls};
+ *    auto result = shards.scatterGather<long> ( {"COUNT", "foo"}, 100, 0,
+ *        [] (long & total, size_t peer, const std::vector<std::string> & reply) {
+ *          total += std::stol (reply[0]);
+ *        } );
+ *    // result.value, result.complete, result.status[peer]
+ *
+ * On timeout the result is partial: the reduction of the replies
+ * got, and the status of each peer.
+ *
+ * There is a DEALER connected to each peer (REP, or anything
+ * echoing the envelope): a PeerSet. Requests go with a correlation
+ * frame before the delimiter, so late replies to earlier queries
+ * are ignored.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_SCATTER_GATHER_H
+#define ZQM_HELPER_SCATTER_GATHER_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include "zmqHelperPeerSet.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// What happened with a peer in a query
+  // -----------------------------------------------------------------
+  enum class PeerStatus { PENDING, REPLIED, TIMED_OUT };
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// Result of a scatterGather()
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  template<typename R>
+  struct GatherResult {
+	R value;                         // the reduction of the replies got
+	std::vector<PeerStatus> status;  // for each peer
+	size_t replied = 0;
+	bool complete = false;           // every peer replied
+  };
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The ScatterGather class. Its sockets are created by the thread
+  /// calling the constructor: use it from that one.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class ScatterGather {
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	PeerSet peers;
+	unsigned long queries = 0;
+	unsigned long duplicates = 0;
+
+	std::vector<std::string> reply;
+
+	ScatterGather (const ScatterGather & o) = delete;
+	ScatterGather & operator=(const ScatterGather & o) = delete;
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param context zmq context
+	/// @param urls of the peers (one DEALER for each)
+	// .............................................................
+	ScatterGather (zmq::context_t & context, const std::vector<std::string> & urls)
+	  : peers {context, urls}
+	{ }
+
+	// .............................................................
+	/// Send request to every peer and reduce the replies.
+	/// @param time timeout in ms (-1 = until all of them reply)
+	/// @param initial initial value of the reduction
+	/// @param reducer called for each reply as it arrives
+	// .............................................................
+	template<typename R>
+	GatherResult<R> scatterGather (const std::vector<std::string> & request, long time, R initial,
+								   std::function<void(R &, size_t, const std::vector<std::string> &)> reducer) {
+
+	  GatherResult<R> result;
+	  result.value = std::move (initial);
+	  result.status.assign (peers.size (), PeerStatus::PENDING);
+
+	  //
+	  // scatter: correlation, "", request
+	  //
+	  std::string correlation = std::to_string (++queries) + ".";
+	  for (size_t p=0; p<peers.size (); p++) {
+		peers.send (p, correlation, request);
+	  }
+
+	  //
+	  // gather
+	  //
+	  auto end = Clock::now () + std::chrono::milliseconds (std::max (0L, time));
+	  while ( result.replied < peers.size () ) {
+
+		long wait = -1;
+		if ( time >= 0 ) {
+		  wait = std::max (0L, (long) std::chrono::duration_cast<std::chrono::milliseconds>
+						   (end - Clock::now ()).count ());
+		}
+
+		size_t p = peers.receive (correlation, wait, reply);
+		if ( p == peers.size () ) {
+		  break; // timed out
+		}
+		if ( result.status[p] != PeerStatus::PENDING ) {
+		  duplicates++;
+		  continue;
+		}
+
+		result.status[p] = PeerStatus::REPLIED;
+		result.replied++;
+		reducer (result.value, p, reply);
+	  } // while
+
+	  for (auto & s : result.status) {
+		if ( s == PeerStatus::PENDING ) {
+		  s = PeerStatus::TIMED_OUT;
+		}
+	  }
+	  result.complete = result.replied == peers.size ();
+
+	  return result;
+	}
+
+	// .............................................................
+	/// @return how many peers
+	// .............................................................
+	size_t peerCount () const {
+	  return peers.size ();
+	}
+
+	// .............................................................
+	/// @return replies to earlier queries, ignored
+	// .............................................................
+	unsigned long lateReplyCount () const {
+	  return peers.ignoredCount () + duplicates;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
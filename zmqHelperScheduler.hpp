@@ -0,0 +1,476 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperScheduler.hpp
+ *
+ * SocketScheduler: many sockets multiplexed onto a fixed pool
+ * of threads (by default, one per core), instead of one thread
+ * per socket (as SocketAdaptorWithThread does).
+ *
+ * Each socket is created by, and bound for its whole life to,
+ * one pool thread. So the rule "only the thread that created
+ * a socket may use it" still holds (SocketAdaptor checks it).
+ * Each pool thread polls its sockets and calls their handlers
+ * when messages arrive.
+ *
+ * addSocket waits for the setup of the socket, and throws what it
+ * threw (a bind to a port in use, say). A handler throwing loses
+ * its message only: the error is kept (rethrowHandlerError).
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_SCHEDULER_H
+#define ZQM_HELPER_SCHEDULER_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <fcntl.h>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The SocketScheduler class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class SocketScheduler {
+
+  public:
+
+	using SocketId = unsigned long;
+
+	// .............................................................
+	/// How many messages a socket may handle in a row before
+	/// the other sockets of its thread get their turn.
+	// .............................................................
+	static const int BATCH = 64;
+
+  private:
+
+	// .............................................................
+	/// A socket living in a pool thread (type erased)
+	// .............................................................
+	class ScheduledSocketBase {
+	public:
+	  SocketId id = 0;
+	  virtual ZmqSocketType * getZmqSocket () = 0;
+	  /// @return how many messages were handled
+	  virtual int onReadable () = 0;
+	  virtual ~ScheduledSocketBase () { }
+	};
+
+	// .............................................................
+	// .............................................................
+	template<int ZMQ_SOCKET_TYPE>
+	class ScheduledSocket : public ScheduledSocketBase {
+	public:
+	  using SocketAdaptorType = SocketAdaptor<ZMQ_SOCKET_TYPE>;
+	  using HandlerType
+		= std::function<void(SocketAdaptorType &, std::vector<std::string> &)>;
+
+	private:
+	  SocketAdaptorType theSocketAdaptor;
+	  HandlerType theHandler;
+	  std::vector<std::string> lines;
+
+	public:
+	  ScheduledSocket (zmq::context_t & aContext,
+					   std::function<void(SocketAdaptorType &)> setup,
+					   HandlerType handler)
+		: theSocketAdaptor {aContext}, theHandler {handler}
+	  {
+		setup (theSocketAdaptor);
+	  }
+
+	  ZmqSocketType * getZmqSocket () override {
+		return theSocketAdaptor.getZmqSocket ();
+	  }
+
+	  int onReadable () override {
+		int handled = 0;
+		while ( handled < BATCH && theSocketAdaptor.tryReceiveText (lines) ) {
+		  theHandler (theSocketAdaptor, lines);
+		  handled++;
+		}
+		return handled;
+	  }
+	};
+
+	// .............................................................
+	/// Order for a pool thread: to create a socket (factory != nullptr)
+	/// or to remove one.
+	// .............................................................
+	struct Command {
+	  SocketId id;
+	  std::function<ScheduledSocketBase * ()> factory;
+	};
+
+	// .............................................................
+	/// A thread of the pool, with its sockets.
+	// .............................................................
+	class PoolThread {
+
+	private:
+
+	  // only used by the pool thread
+	  std::vector< std::unique_ptr<ScheduledSocketBase> > theSockets;
+
+	  // orders from other threads, and a pipe to awake the poll
+	  std::mutex theMutex;
+	  std::vector<Command> pendingCommands;
+	  int wakeupPipe[2] = {-1, -1};
+
+	  // (with theMutex) sockets created, or failed, not yet waited
+	  // for; and the first error of a handler
+	  std::condition_variable theCondition;
+	  std::vector< std::pair<SocketId, std::exception_ptr> > setUps;
+	  std::exception_ptr handlerFailure;
+
+	  std::atomic<bool> running {true};
+	  std::thread * theThread = nullptr;
+
+	  // .............................................................
+	  // .............................................................
+	  void wakeup () {
+		char c = 0;
+		ssize_t n = write (wakeupPipe[1], &c, 1);
+		(void) n; // a full pipe means an awakening is already pending
+	  }
+
+	  // .............................................................
+	  // .............................................................
+	  void runCommands () {
+		char buff[64];
+		while ( read (wakeupPipe[0], buff, sizeof (buff)) == sizeof (buff) ) { }
+
+		std::vector<Command> commands;
+		{
+		  std::unique_lock<std::mutex> theLock {theMutex};
+		  commands.swap (pendingCommands);
+		}
+
+		for (auto & c : commands) {
+		  if (c.factory) {
+			// the socket is created here: this thread owns it
+			std::exception_ptr error;
+			try {
+			  theSockets.emplace_back ( c.factory () );
+			  theSockets.back()->id = c.id;
+			} catch (...) {
+			  error = std::current_exception ();
+			}
+			std::unique_lock<std::mutex> theLock {theMutex};
+			setUps.push_back ( {c.id, error} );
+			theCondition.notify_all ();
+		  } else {
+			theSockets.erase ( std::remove_if ( theSockets.begin (), theSockets.end (),
+				[&c] (const std::unique_ptr<ScheduledSocketBase> & s) { return s->id == c.id; }),
+			  theSockets.end () );
+		  }
+		}
+	  }
+
+	  // .............................................................
+	  // .............................................................
+	  void main_Thread () {
+
+		std::vector<zmq::pollitem_t> items;
+
+		while (running) {
+
+		  items.clear ();
+		  items.push_back ( { nullptr, wakeupPipe[0], ZMQ_POLLIN, 0 } );
+		  for (auto & s : theSockets) {
+			items.push_back ( { *s->getZmqSocket (), 0, ZMQ_POLLIN, 0 } );
+		  }
+
+		  zmq::poll ( &items[0], items.size (), -1 );
+
+		  // handlers first: runCommands() may change theSockets
+		  for (unsigned int i=1; i<items.size (); i++) {
+			if ( items[i].revents & ZMQ_POLLIN ) {
+			  try {
+				handledMessages += theSockets[i-1]->onReadable ();
+			  } catch (...) {
+				handlerErrors++;
+				std::unique_lock<std::mutex> theLock {theMutex};
+				if ( ! handlerFailure ) {
+				  handlerFailure = std::current_exception ();
+				}
+			  }
+			}
+		  }
+
+		  if ( items[0].revents & ZMQ_POLLIN ) {
+			runCommands ();
+		  }
+		} // while
+
+		// sockets are closed by their owner: this thread
+		theSockets.clear ();
+	  }
+
+	  PoolThread (const PoolThread & o) = delete;
+	  PoolThread & operator=(const PoolThread & o) = delete;
+
+	public:
+
+	  std::atomic<unsigned long> handledMessages {0};
+	  std::atomic<unsigned long> handlerErrors {0};
+	  std::atomic<unsigned int> socketCount {0};
+
+	  // .............................................................
+	  // .............................................................
+	  PoolThread () {
+		if ( pipe (wakeupPipe) != 0 ) {
+		  throw std::runtime_error ("SocketScheduler: can't create pipe");
+		}
+		fcntl (wakeupPipe[0], F_SETFL, O_NONBLOCK);
+		fcntl (wakeupPipe[1], F_SETFL, O_NONBLOCK);
+
+		theThread = new std::thread (&PoolThread::main_Thread, this);
+	  }
+
+	  // .............................................................
+	  // .............................................................
+	  ~PoolThread () {
+		stopAndJoin ();
+		close (wakeupPipe[0]);
+		close (wakeupPipe[1]);
+	  }
+
+	  // .............................................................
+	  // .............................................................
+	  void post (Command && c) {
+		{
+		  std::unique_lock<std::mutex> theLock {theMutex};
+		  pendingCommands.push_back (std::move (c));
+		}
+		wakeup ();
+	  }
+
+	  // .............................................................
+	  /// Wait for the socket id to be created.
+	  /// @return what its setup threw (or nullptr)
+	  // .............................................................
+	  std::exception_ptr waitSetUp (SocketId id) {
+		std::unique_lock<std::mutex> theLock {theMutex};
+		while (true) {
+		  for (auto p = setUps.begin (); p != setUps.end (); ++p) {
+			if ( p->first == id ) {
+			  std::exception_ptr error = p->second;
+			  setUps.erase (p);
+			  return error;
+			}
+		  }
+		  if ( ! running ) {
+			return std::make_exception_ptr
+			  ( std::runtime_error ("SocketScheduler: pool thread stopped") );
+		  }
+		  theCondition.wait (theLock);
+		}
+	  }
+
+	  // .............................................................
+	  /// @return the first error of a handler (forgotten then)
+	  // .............................................................
+	  std::exception_ptr takeHandlerFailure () {
+		std::unique_lock<std::mutex> theLock {theMutex};
+		std::exception_ptr error = handlerFailure;
+		handlerFailure = nullptr;
+		return error;
+	  }
+
+	  // .............................................................
+	  // .............................................................
+	  void stopAndJoin () {
+		if (theThread == nullptr) {
+		  return;
+		}
+		{
+		  std::unique_lock<std::mutex> theLock {theMutex};
+		  running = false;
+		  theCondition.notify_all ();
+		}
+		wakeup ();
+		theThread->join ();
+		delete theThread;
+		theThread = nullptr;
+	  }
+
+	}; // class
+
+	// .............................................................
+	// .............................................................
+	zmq::context_t & theContext;
+
+	std::vector< std::unique_ptr<PoolThread> > thePool;
+
+	std::atomic<SocketId> nextId {1};
+
+	// .............................................................
+	/// Where each socket lives. Only used by the owner of the scheduler.
+	// .............................................................
+	std::vector< std::pair<SocketId, unsigned int> > placement;
+
+	// .............................................................
+	// .............................................................
+	SocketScheduler (const SocketScheduler & o) = delete;
+	SocketScheduler & operator=(const SocketScheduler & o) = delete;
+
+	// .............................................................
+	/// The thread with fewer sockets.
+	// .............................................................
+	unsigned int choosePoolThread () {
+	  unsigned int best = 0;
+	  for (unsigned int i=1; i<thePool.size (); i++) {
+		if ( thePool[i]->socketCount < thePool[best]->socketCount ) {
+		  best = i;
+		}
+	  }
+	  return best;
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param aContext the context for all the sockets (share it
+	/// with the peers when using 'inproc').
+	/// @param threads size of the pool. 0 = one per core.
+	// .............................................................
+	explicit SocketScheduler (zmq::context_t & aContext, unsigned int threads = 0)
+	  : theContext {aContext}
+	{
+	  if (threads == 0) {
+		threads = std::max (1u, std::thread::hardware_concurrency ());
+	  }
+
+	  for (unsigned int i=0; i<threads; i++) {
+		thePool.emplace_back ( new PoolThread {} );
+	  }
+	}
+
+	// .............................................................
+	/// Destructor. Stop the threads (their sockets are closed).
+	// .............................................................
+	~SocketScheduler () {
+	  stop ();
+	}
+
+	// .............................................................
+	/// Add a socket. It is created by (and bound to) one pool thread,
+	/// which first calls setup (to bind, connect, subscribe ...)
+	/// and afterwards handler, for each message received.
+	/// Both run in the pool thread: don't block in them.
+	/// Returns once setup is done; throws what it threw (the socket
+	/// is not added then).
+	/// @return the id of the socket (to remove it)
+	// .............................................................
+	template<int ZMQ_SOCKET_TYPE>
+	SocketId addSocket (std::function<void(SocketAdaptor<ZMQ_SOCKET_TYPE> &)> setup,
+						typename ScheduledSocket<ZMQ_SOCKET_TYPE>::HandlerType handler) {
+
+	  SocketId id = nextId++;
+	  unsigned int where = choosePoolThread ();
+
+	  zmq::context_t & context = theContext;
+	  Command c { id, [&context, setup, handler] () -> ScheduledSocketBase * {
+		  return new ScheduledSocket<ZMQ_SOCKET_TYPE> {context, setup, handler};
+		} };
+
+	  thePool[where]->socketCount++;
+	  placement.push_back ( {id, where} );
+	  thePool[where]->post (std::move (c));
+
+	  std::exception_ptr error = thePool[where]->waitSetUp (id);
+	  if ( error ) {
+		thePool[where]->socketCount--;
+		placement.pop_back ();
+		std::rethrow_exception (error);
+	  }
+	  return id;
+	}
+
+	// .............................................................
+	/// Remove (and close) a socket.
+	// .............................................................
+	void removeSocket (SocketId id) {
+	  for (auto p = placement.begin (); p != placement.end (); ++p) {
+		if (p->first == id) {
+		  thePool[p->second]->socketCount--;
+		  thePool[p->second]->post ( Command {id, nullptr} );
+		  placement.erase (p);
+		  return;
+		}
+	  }
+	}
+
+	// .............................................................
+	/// Stop and join the pool threads. Their sockets are closed.
+	// .............................................................
+	void stop () {
+	  for (auto & t : thePool) {
+		t->stopAndJoin ();
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned int threadCount () const {
+	  return thePool.size ();
+	}
+
+	// .............................................................
+	/// @return sockets living in the i-th pool thread
+	// .............................................................
+	unsigned int socketCount (unsigned int i) const {
+	  return thePool[i]->socketCount;
+	}
+
+	// .............................................................
+	/// @return messages handled so far by the i-th pool thread
+	// .............................................................
+	unsigned long handledMessages (unsigned int i) const {
+	  return thePool[i]->handledMessages;
+	}
+
+	// .............................................................
+	/// @return handlers of the i-th pool thread which threw
+	// .............................................................
+	unsigned long handlerErrorCount (unsigned int i) const {
+	  return thePool[i]->handlerErrors;
+	}
+
+	// .............................................................
+	/// Throw the first error of a handler not yet thrown (if any).
+	// .............................................................
+	void rethrowHandlerError () {
+	  for (auto & t : thePool) {
+		std::exception_ptr error = t->takeHandlerFailure ();
+		if ( error ) {
+		  std::rethrow_exception (error);
+		}
+	  }
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,621 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperServiceBroker.hpp
+ *
+ * A broker routing requests by service name (in the style of
+ * Majordomo), so a slow service does not hold back a fast one:
+ *
+ *   clients (REQ/DEALER) -> ROUTER [ServiceBroker] ROUTER <- workers (DEALER)
+ *
+ * Each service has its own queue of ready workers (least recently
+ * used first) and its own backlog of requests. Workers register
+ * for one or more services. Idle workers and the broker exchange
+ * heartbeats; idle workers silent for too long are evicted.
+ *
+ * Client side: the first body frame is the service name:
+ *
+ *    requester.sendText ( { "echo", "hello" } );   // reply: body only
+ *
+ * Worker side (first frame = command):
+ *
+ *   worker -> broker:  "READY", service...
+ *                      "REPLY", route..., "", body
+ *                      "HEARTBEAT"
+ *                      "DISCONNECT"
+ *   broker -> worker:  "REQUEST", service, route..., "", body
+ *                      "HEARTBEAT"
+ *
+ * A worker handles one request at a time. A busy worker can not
+ * heartbeat: it is taken as dead when silent for longer than the
+ * request timeout (30 s by default); its client then gets
+ * REQUEST_LOST_REPLY (the request is not sent again: it may have
+ * been done).
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_SERVICE_BROKER_H
+#define ZQM_HELPER_SERVICE_BROKER_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+
+#include "zmqHelperIdentityMap.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // -----------------------------------------------------------------
+  /// Reply body when the backlog of the service is full
+  // -----------------------------------------------------------------
+  const char SERVICE_BUSY_REPLY[] = "SERVICE_BUSY";
+
+  // -----------------------------------------------------------------
+  /// Reply body when the worker handling the request died
+  // -----------------------------------------------------------------
+  const char REQUEST_LOST_REPLY[] = "REQUEST_LOST";
+
+  // -----------------------------------------------------------------
+  /// Heartbeats missed before a peer is taken as dead
+  // -----------------------------------------------------------------
+  const int HEARTBEAT_LIVENESS = 3;
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The ServiceBroker class. It does not own the sockets: call
+  /// run() (or pollOnce()) from the thread owning them.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class ServiceBroker {
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// .............................................................
+	// .............................................................
+	struct WorkerState {
+	  std::vector<std::string> services;
+	  bool ready = false;
+	  unsigned long readyStamp = 0; // to spot stale ready queue entries
+	  unsigned int nextService = 0; // round robin over its backlogs
+	  Clock::time_point expiry;
+	  /// busy: route (with delimiter) of the client, and until when
+	  /// it may be silent
+	  std::vector<zmq::message_t> route;
+	  Clock::time_point busyExpiry;
+	};
+
+	// .............................................................
+	// .............................................................
+	struct Service {
+	  // LRU: (worker, readyStamp) pushed back, taken from the front
+	  std::deque< std::pair<std::string, unsigned long> > ready;
+	  std::deque< std::vector<zmq::message_t> > backlog;
+	  unsigned long requests = 0;
+	};
+
+	// .............................................................
+	// .............................................................
+	SocketAdaptor<ZMQ_ROUTER> & frontend;
+	SocketAdaptor<ZMQ_ROUTER> & backend;
+
+	const std::chrono::milliseconds heartbeat;
+	Clock::time_point nextHeartbeat;
+	size_t maxBacklog = 100000;
+	std::chrono::milliseconds requestTimeout {30000};
+
+	IdentityMap<Service> services;
+	IdentityMap<WorkerState> workers;
+
+	unsigned long evicted = 0;
+	unsigned long lost = 0;
+
+	// reused from message to message
+	std::vector<zmq::message_t> frames;
+	std::vector<zmq::message_t> outgoing;
+
+	// .............................................................
+	// .............................................................
+	ServiceBroker (const ServiceBroker & o) = delete;
+	ServiceBroker & operator=(const ServiceBroker & o) = delete;
+
+	// .............................................................
+	// .............................................................
+	static std::string textOf (const zmq::message_t & frame) {
+	  return std::string { (const char *) frame.data (), frame.size () };
+	}
+
+	// .............................................................
+	/// Send a request (route..., "", service, body) to a worker.
+	// .............................................................
+	void sendRequest (const std::string & worker, const std::string & service,
+					  std::vector<zmq::message_t> & request) {
+
+	  // the worker is busy with it: keep the route, to answer if it dies
+	  WorkerState * w = workers.find (worker.data (), worker.size ());
+	  size_t b = bodyStart (request);
+	  w->route.clear ();
+	  for (size_t i=0; i<b; i++) {
+		w->route.emplace_back ();
+		w->route.back().copy (&request[i]); // reference counted
+	  }
+	  w->busyExpiry = Clock::now () + requestTimeout;
+
+	  outgoing.clear ();
+	  outgoing.push_back ( textFrame (worker) );
+	  outgoing.push_back ( textFrame ("REQUEST") );
+	  outgoing.push_back ( textFrame (service) );
+
+	  // route..., "" and the body without the service frame
+	  for (size_t i=0; i<request.size (); i++) {
+		if ( i != b ) {
+		  outgoing.push_back ( std::move (request[i]) );
+		}
+	  }
+	  backend.sendFrames (outgoing);
+	}
+
+	// .............................................................
+	/// @return a ready worker of the service (LRU), or nullptr
+	// .............................................................
+	const std::string * takeReadyWorker (Service & service, std::string & id) {
+	  while ( ! service.ready.empty () ) {
+		id.swap (service.ready.front().first);
+		unsigned long stamp = service.ready.front().second;
+		service.ready.pop_front ();
+
+		WorkerState * w = workers.find (id.data (), id.size ());
+		if ( w != nullptr && w->ready && w->readyStamp == stamp ) {
+		  w->ready = false;
+		  return &id;
+		}
+		// stale: evicted, or busy since
+	  }
+	  return nullptr;
+	}
+
+	// .............................................................
+	/// Drop the stale entries of a ready queue (when it grows).
+	// .............................................................
+	void compact (Service & service) {
+	  std::deque< std::pair<std::string, unsigned long> > valid;
+	  for (auto & entry : service.ready) {
+		WorkerState * w = workers.find (entry.first.data (), entry.first.size ());
+		if ( w != nullptr && w->ready && w->readyStamp == entry.second ) {
+		  valid.push_back ( std::move (entry) );
+		}
+	  }
+	  service.ready.swap (valid);
+	}
+
+	// .............................................................
+	/// The worker is free: give it the oldest request waiting for
+	/// one of its services, or put it in their ready queues.
+	// .............................................................
+	void workerReady (const std::string & id) {
+	  WorkerState * w = workers.find (id.data (), id.size ());
+	  unsigned int n = w->services.size ();
+
+	  for (unsigned int k=0; k<n; k++) {
+		const std::string & name = w->services[ (w->nextService + k) % n ];
+		Service & s = services.findOrInsert (name);
+		if ( ! s.backlog.empty () ) {
+		  w->nextService = (w->nextService + k + 1) % n;
+		  w->ready = false;
+		  sendRequest (id, name, s.backlog.front ());
+		  s.backlog.pop_front ();
+		  return;
+		}
+	  }
+
+	  w->ready = true;
+	  w->readyStamp++;
+	  for (const auto & name : w->services) {
+		Service & s = services.findOrInsert (name);
+		s.ready.emplace_back (id, w->readyStamp);
+		if ( s.ready.size () > 2 * workers.size () + 16 ) {
+		  compact (s);
+		}
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	void fromClient () {
+	  frontend.receiveFrames (frames);
+
+	  size_t b = bodyStart (frames);
+	  if ( b >= frames.size () ) {
+		return; // no service name
+	  }
+
+	  std::string name = textOf (frames[b]);
+	  Service & s = services.findOrInsert (name);
+	  s.requests++;
+
+	  std::string id;
+	  if ( takeReadyWorker (s, id) != nullptr ) {
+		sendRequest (id, name, frames);
+		return;
+	  }
+
+	  if ( s.backlog.size () >= maxBacklog ) {
+		frames.resize (b);
+		frames.push_back ( textFrame (SERVICE_BUSY_REPLY) );
+		frontend.sendFrames (frames);
+		return;
+	  }
+
+	  s.backlog.emplace_back ();
+	  s.backlog.back().swap (frames);
+	}
+
+	// .............................................................
+	// .............................................................
+	void fromWorker () {
+	  backend.receiveFrames (frames);
+	  if ( frames.size () < 2 ) {
+		return;
+	  }
+
+	  std::string id = textOf (frames[0]);
+	  WorkerState * w = workers.find (id.data (), id.size ());
+
+	  if ( frameIs (frames[1], "READY") ) {
+		if ( w == nullptr ) {
+		  w = & workers.findOrInsert (id);
+		}
+		requestLost (*w); // (if it restarted while busy)
+		w->services.clear ();
+		for (size_t i=2; i<frames.size (); i++) {
+		  w->services.push_back ( textOf (frames[i]) );
+		}
+		w->expiry = Clock::now () + HEARTBEAT_LIVENESS * heartbeat;
+		workerReady (id);
+		return;
+	  }
+
+	  if ( w == nullptr ) {
+		return; // unknown (evicted?): it should send READY again
+	  }
+	  w->expiry = Clock::now () + HEARTBEAT_LIVENESS * heartbeat;
+
+	  if ( frameIs (frames[1], "REPLY") ) {
+		w->route.clear ();
+		// route..., "", body back to the client
+		outgoing.clear ();
+		for (size_t i=2; i<frames.size (); i++) {
+		  outgoing.push_back ( std::move (frames[i]) );
+		}
+		frontend.sendFrames (outgoing);
+		workerReady (id);
+	  } else if ( frameIs (frames[1], "DISCONNECT") ) {
+		requestLost (*w);
+		workers.erase (id.data (), id.size ());
+	  }
+	  // HEARTBEAT: only the expiry
+	}
+
+	// .............................................................
+	/// The worker is gone: answer the request it was handling.
+	// .............................................................
+	void requestLost (WorkerState & w) {
+	  if ( w.route.empty () ) {
+		return;
+	  }
+	  outgoing.clear ();
+	  for (auto & f : w.route) {
+		outgoing.push_back ( std::move (f) );
+	  }
+	  outgoing.push_back ( textFrame (REQUEST_LOST_REPLY) );
+	  frontend.sendFrames (outgoing);
+	  w.route.clear ();
+	  lost++;
+	}
+
+	// .............................................................
+	/// Heartbeat the idle workers and evict the silent ones (busy
+	/// ones: silent beyond the request timeout).
+	// .............................................................
+	void heartbeats () {
+	  auto now = Clock::now ();
+	  if ( now < nextHeartbeat ) {
+		return;
+	  }
+	  nextHeartbeat = now + heartbeat;
+
+	  std::vector<std::string> dead;
+	  workers.forEach ( [&] (const std::string & id, WorkerState & w) {
+		  if ( ! w.ready ) {
+			// busy: it can not answer now
+			if ( w.expiry < now && w.busyExpiry < now ) {
+			  dead.push_back (id);
+			}
+			return;
+		  }
+		  if ( w.expiry < now ) {
+			dead.push_back (id);
+		  } else {
+			backend.sendText ( {id, "HEARTBEAT"} );
+		  }
+		} );
+
+	  for (auto & id : dead) {
+		requestLost (* workers.find (id.data (), id.size ()));
+		workers.erase (id.data (), id.size ());
+		evicted++;
+	  }
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param front ROUTER for the clients
+	/// @param back ROUTER for the workers
+	/// @param heartbeatMs interval of the heartbeats
+	// .............................................................
+	ServiceBroker (SocketAdaptor<ZMQ_ROUTER> & front, SocketAdaptor<ZMQ_ROUTER> & back,
+				   long heartbeatMs = 1000)
+	  : frontend {front}, backend {back},
+		heartbeat {heartbeatMs}, nextHeartbeat {Clock::now () + heartbeat}
+	{ }
+
+	// .............................................................
+	/// Requests for a service over this many, waiting for a worker,
+	/// are answered SERVICE_BUSY_REPLY.
+	// .............................................................
+	void setMaxBacklog (size_t n) {
+	  maxBacklog = n;
+	}
+
+	// .............................................................
+	/// A busy worker silent for longer than ms is taken as dead
+	/// (longer than any request takes). (By default, 30000).
+	// .............................................................
+	void setRequestTimeout (long ms) {
+	  requestTimeout = std::chrono::milliseconds {ms};
+	}
+
+	// .............................................................
+	/// Wait up to time ms (less if a heartbeat is due) and handle
+	/// what arrives. @return false if nothing arrived.
+	// .............................................................
+	bool pollOnce (long time = -1) {
+
+	  long untilHeartbeat = std::max (0L, (long) std::chrono::duration_cast
+									  <std::chrono::milliseconds> (nextHeartbeat - Clock::now ()).count ());
+	  if ( time < 0 || untilHeartbeat < time ) {
+		time = untilHeartbeat;
+	  }
+
+	  zmq::pollitem_t items [] = {
+		{ *backend.getZmqSocket (), 0, ZMQ_POLLIN, 0 },
+		{ *frontend.getZmqSocket (), 0, ZMQ_POLLIN, 0 } };
+
+	  int some = zmq::poll ( &items[0], 2, time );
+
+	  if ( some > 0 && (items[0].revents & ZMQ_POLLIN) ) {
+		fromWorker ();
+	  }
+	  if ( some > 0 && (items[1].revents & ZMQ_POLLIN) ) {
+		fromClient ();
+	  }
+
+	  heartbeats ();
+
+	  return some > 0;
+	}
+
+	// .............................................................
+	/// Forever.
+	// .............................................................
+	void run () {
+	  while (true) {
+		pollOnce (-1);
+	  }
+	}
+
+	// .............................................................
+	/// @return workers registered (alive)
+	// .............................................................
+	size_t workerCount () const {
+	  return workers.size ();
+	}
+
+	// .............................................................
+	/// @return workers evicted for being silent
+	// .............................................................
+	unsigned long evictedCount () const {
+	  return evicted;
+	}
+
+	// .............................................................
+	/// @return requests answered REQUEST_LOST_REPLY
+	// .............................................................
+	unsigned long lostCount () const {
+	  return lost;
+	}
+
+	// .............................................................
+	/// @return requests of the service waiting for a worker
+	// .............................................................
+	size_t backlogCount (const std::string & service) {
+	  Service * s = services.find (service.data (), service.size ());
+	  return s == nullptr ? 0 : s->backlog.size ();
+	}
+
+	// .............................................................
+	/// @return requests got for the service
+	// .............................................................
+	unsigned long requestCount (const std::string & service) {
+	  Service * s = services.find (service.data (), service.size ());
+	  return s == nullptr ? 0 : s->requests;
+	}
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The ServiceWorker class: the worker side, on a DEALER socket
+  /// connected to the backend of a ServiceBroker.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class ServiceWorker {
+
+  public:
+
+	// .............................................................
+	/// Gets the service name and the request body,
+	/// @return the reply body.
+	// .............................................................
+	using HandlerType = std::function<std::vector<std::string>
+	  (const std::string &, const std::vector<std::string> &)>;
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	SocketAdaptor<ZMQ_DEALER> & socket;
+	const std::vector<std::string> services;
+	const std::chrono::milliseconds heartbeat;
+
+	Clock::time_point nextHeartbeat;
+	Clock::time_point brokerExpiry;
+	unsigned long handled = 0;
+
+	std::vector<zmq::message_t> frames;
+	std::vector<zmq::message_t> outgoing;
+	std::vector<std::string> body;
+
+	ServiceWorker (const ServiceWorker & o) = delete;
+	ServiceWorker & operator=(const ServiceWorker & o) = delete;
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param s DEALER socket (owned by the calling thread)
+	/// @param services_ names of the services given
+	/// @param heartbeatMs as the one of the broker
+	// .............................................................
+	ServiceWorker (SocketAdaptor<ZMQ_DEALER> & s,
+				   const std::vector<std::string> & services_,
+				   long heartbeatMs = 1000)
+	  : socket {s}, services {services_}, heartbeat {heartbeatMs}
+	{ }
+
+	// .............................................................
+	/// Register (after connecting).
+	// .............................................................
+	void start () {
+	  std::vector<std::string> ready = { "READY" };
+	  ready.insert (ready.end (), services.begin (), services.end ());
+	  socket.sendText (ready);
+	  nextHeartbeat = Clock::now () + heartbeat;
+	  brokerExpiry = Clock::now () + HEARTBEAT_LIVENESS * heartbeat;
+	}
+
+	// .............................................................
+	/// Leave.
+	// .............................................................
+	void stop () {
+	  socket.sendText ( {"DISCONNECT"} );
+	}
+
+	// .............................................................
+	/// Wait up to time ms for a request (sending heartbeats
+	/// meanwhile) and handle it.
+	/// @return false if none arrived.
+	// .............................................................
+	bool handleOne (HandlerType handler, long time = -1) {
+
+	  auto end = Clock::now () + std::chrono::milliseconds (time < 0 ? 0 : time);
+
+	  while (true) {
+		auto now = Clock::now ();
+		if ( now >= nextHeartbeat ) {
+		  socket.sendText ( {"HEARTBEAT"} );
+		  nextHeartbeat = now + heartbeat;
+		}
+
+		auto until = nextHeartbeat;
+		if ( time >= 0 && end < until ) {
+		  until = end;
+		}
+		long wait = std::max (0L, (long) std::chrono::duration_cast
+							  <std::chrono::milliseconds> (until - now).count ());
+
+		if ( ! socket.receiveFrames (frames, wait) ) {
+		  if ( time >= 0 && Clock::now () >= end ) {
+			return false;
+		  }
+		  continue;
+		}
+
+		brokerExpiry = Clock::now () + HEARTBEAT_LIVENESS * heartbeat;
+		if ( frames.size () >= 3 && frameIs (frames[0], "REQUEST") ) {
+		  break;
+		}
+		// HEARTBEAT
+	  } // while
+
+	  // "REQUEST", service, route..., "", body
+	  std::string service { (const char *) frames[1].data (), frames[1].size () };
+	  size_t b = bodyStart (frames, 2);
+
+	  body.clear ();
+	  for (size_t i=b; i<frames.size (); i++) {
+		body.push_back ( std::string { (const char *) frames[i].data (), frames[i].size () } );
+	  }
+
+	  std::vector<std::string> reply = handler (service, body);
+	  handled++;
+
+	  // "REPLY", route..., "", reply
+	  outgoing.clear ();
+	  outgoing.push_back ( textFrame ("REPLY") );
+	  for (size_t i=2; i<b; i++) {
+		outgoing.push_back ( std::move (frames[i]) );
+	  }
+	  for (auto & line : reply) {
+		outgoing.push_back ( textFrame (line) );
+	  }
+	  socket.sendFrames (outgoing);
+	  nextHeartbeat = Clock::now () + heartbeat;
+
+	  return true;
+	}
+
+	// .............................................................
+	/// @return false if the broker has been silent too long
+	/// (then, reconnect and start() again)
+	// .............................................................
+	bool brokerAlive () const {
+	  return Clock::now () < brokerExpiry;
+	}
+
+	// .............................................................
+	/// @return requests handled
+	// .............................................................
+	unsigned long handledCount () const {
+	  return handled;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,594 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperSharedRing.hpp
+ *
+ * Shared memory transport for big payloads between processes of
+ * the same host (images, tensors): the payload is written into a
+ * ring of shared memory (shm_open + mmap) owned by the sender, and
+ * only a small descriptor goes through the zmq socket. The
+ * receiver reads it in place; when done, an acknowledgement goes
+ * back and the sender reuses that part of the ring.
+ *
+ *    // sender (DEALER, PAIR ...: it gets the acks back)
+ *    SharedRingSender<ZMQ_DEALER> out {socket, "ipc:///tmp/frames", "/frames-ring"};
+ *    out.send (image.data (), image.size ());
+ *    out.send (size, [&] (void * where) { render (where); }); // no copy
+ *
+ *    // receiver (ROUTER, DEALER, PAIR ...)
+ *    SharedRingReceiver<ZMQ_ROUTER> in {socket};
+ *    SharedPayload payload;
+ *    in.receive (payload);
+ *    use (payload.data (), payload.size ());
+ *    payload.release ();   // (or its destructor): the ack
+ *
+ * (a payload must be released before its receiver is gone)
+ *
+ * Frames (after the envelope, if any):
+ *    {"#shm", ring name, nonce, generation, offset, length}
+ *    {"#inline", payload}
+ *    back: {"#ack", nonce, generation, offset}
+ *
+ * (generation: times the ring wrapped around at that block.
+ * nonce: of the sender instance, also kept at the beginning of the
+ * ring; a receiver maps the ring again when a restarted sender
+ * created it anew under the same name.)
+ *
+ * The payload goes inline (a plain frame) when the endpoint is not
+ * on this host (only ipc, inproc and tcp to localhost count as such),
+ * when it is small, or when the ring stays full for a while.
+ * When a block stays unacked too long (setAckTimeout) the receiver
+ * is taken as gone: every payload goes inline (no waiting) until
+ * the blocks are acked, or reclaim() is called.
+ *
+ * The sender's socket is for this only (acks come on it).
+ *
+ * Features C++11, POSIX shared memory (link with -lrt on old glibc)
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_SHARED_RING_H
+#define ZQM_HELPER_SHARED_RING_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  /// bytes at the beginning of a ring (its nonce) before the blocks
+  // ---------------------------------------------------------------
+  const size_t SHARED_RING_HEADER = 64;
+
+  // ---------------------------------------------------------------
+  /// @return true if the endpoint is on this host
+  // ---------------------------------------------------------------
+  inline bool isSameHost (const std::string & endpoint) {
+	for (const char * local : {"ipc://", "inproc://", "tcp://localhost:", "tcp://127.", "tcp://[::1]:"}) {
+	  if ( endpoint.compare (0, strlen (local), local) == 0 ) {
+		return true;
+	  }
+	}
+	return false;
+  } // ()
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// A mapping of a shared memory object
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class SharedMapping {
+
+  private:
+
+	std::string name;
+	void * base = MAP_FAILED;
+	size_t size = 0;
+	bool owner = false;
+
+	SharedMapping (const SharedMapping & o) = delete;
+	SharedMapping & operator=(const SharedMapping & o) = delete;
+
+  public:
+
+	// .............................................................
+	/// Create it (size_ bytes, read and write; removed at the end)
+	/// or open it (size_ = 0: read only).
+	// .............................................................
+	SharedMapping (const std::string & name_, size_t size_)
+	  : name {name_}, size {size_}, owner {size_ > 0}
+	{
+	  int fd = owner ? shm_open (name.c_str (), O_CREAT | O_RDWR | O_TRUNC, 0600)
+		: shm_open (name.c_str (), O_RDONLY, 0);
+	  if ( fd < 0 ) {
+		throw std::runtime_error ("SharedMapping: can't open " + name);
+	  }
+
+	  if ( owner ) {
+		if ( ftruncate (fd, size) != 0 ) {
+		  ::close (fd);
+		  shm_unlink (name.c_str ());
+		  throw std::runtime_error ("SharedMapping: can't size " + name);
+		}
+	  } else {
+		struct stat st;
+		fstat (fd, &st);
+		size = st.st_size;
+	  }
+
+	  base = mmap (nullptr, size, owner ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	  ::close (fd);
+	  if ( base == MAP_FAILED ) {
+		if ( owner ) {
+		  shm_unlink (name.c_str ());
+		}
+		throw std::runtime_error ("SharedMapping: can't map " + name);
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	~SharedMapping () {
+	  munmap (base, size);
+	  if ( owner ) {
+		shm_unlink (name.c_str ());
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	char * data () const { return static_cast<char *> (base); }
+	size_t bytes () const { return size; }
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The SharedRingSender class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  template<int ZMQ_SOCKET_TYPE>
+  class SharedRingSender {
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	struct Block {
+	  uint64_t start; // (bytes ever given: never wraps)
+	  uint64_t end;
+	  bool acked;
+	  std::chrono::steady_clock::time_point sent;
+	};
+
+	SocketAdaptor<ZMQ_SOCKET_TYPE> & socket;
+	const std::string ringName;
+	const bool shared;
+	const size_t minShared;
+	const long fullWait;
+	std::unique_ptr<SharedMapping> ring;
+	uint64_t capacity = 0;
+	long long nonce = 0;
+	long ackTimeout = 5000;
+	bool peerGone = false;
+
+	uint64_t head = 0; // next byte to give
+	uint64_t tail = 0; // first byte not acked
+	std::deque<Block> blocks;
+
+	std::vector<zmq::message_t> frames;
+
+	unsigned long sharedSends = 0;
+	unsigned long inlineSends = 0;
+	unsigned long fullRing = 0;
+	unsigned long peerLost = 0;
+
+	// .............................................................
+	/// Room for size bytes (contiguous: the end of the ring may be
+	/// skipped). @return its start, or false if full
+	// .............................................................
+	bool allocate (uint64_t size, uint64_t & start) {
+	  uint64_t at = head;
+	  uint64_t offset = at % capacity;
+	  if ( offset + size > capacity ) {
+		at += capacity - offset; // skip to the beginning
+	  }
+	  if ( at + size - tail > capacity ) {
+		return false;
+	  }
+	  start = at;
+	  head = at + size;
+	  blocks.push_back ( Block {start, head, false, std::chrono::steady_clock::now ()} );
+	  return true;
+	}
+
+	// .............................................................
+	// .............................................................
+	void acked (uint64_t start) {
+	  for (auto & b : blocks) {
+		if ( b.start == start ) {
+		  b.acked = true;
+		  break;
+		}
+	  }
+	  while ( ! blocks.empty () && blocks.front().acked ) {
+		tail = blocks.front().end;
+		blocks.pop_front ();
+	  }
+	  if ( blocks.empty () ) {
+		tail = head;
+	  }
+	}
+
+	// .............................................................
+	/// The receiver is gone when the oldest block is unacked for
+	/// longer than ackTimeout; back when every block is acked.
+	/// @return true if gone
+	// .............................................................
+	bool isGone () {
+	  if ( peerGone ) {
+		peerGone = ! blocks.empty ();
+	  } else if ( ! blocks.empty ()
+				  && std::chrono::steady_clock::now () - blocks.front().sent
+				  > std::chrono::milliseconds (ackTimeout) ) {
+		peerGone = true;
+		peerLost++;
+	  }
+	  return peerGone;
+	}
+
+	// .............................................................
+	/// A nonce for this instance (positive, fits a long long)
+	// .............................................................
+	static long long newNonce () {
+	  std::random_device device;
+	  uint64_t n = (uint64_t (device ()) << 32) ^ device ()
+		^ uint64_t (std::chrono::steady_clock::now ().time_since_epoch ().count ())
+		^ (uint64_t (getpid ()) << 16);
+	  return (long long) (n & 0x3fffffffffffffffULL) + 1;
+	}
+
+  public:
+
+	// .............................................................
+	/// @param socket_ (connected or bound to endpoint) for this only
+	/// @param endpoint where it sends to (is it on this host?)
+	/// @param ringName_ shared memory name ("/something", unique)
+	/// @param capacity_ bytes of the ring
+	/// @param minShared_ smaller payloads go inline
+	/// @param fullWait_ ms to wait for acks when the ring is full
+	/// (then, inline)
+	// .............................................................
+	SharedRingSender (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket_, const std::string & endpoint,
+					  const std::string & ringName_, size_t capacity_ = 64 * 1024 * 1024,
+					  size_t minShared_ = 64 * 1024, long fullWait_ = 1000)
+	  : socket {socket_}, ringName {ringName_}, shared {isSameHost (endpoint)},
+		minShared {minShared_}, fullWait {fullWait_}
+	{
+	  if ( shared ) {
+		ring.reset ( new SharedMapping {ringName, SHARED_RING_HEADER + capacity_} );
+		capacity = capacity_;
+		nonce = newNonce ();
+		memcpy (ring->data (), &nonce, sizeof (nonce));
+	  }
+	}
+
+	// .............................................................
+	/// ms a block may stay unacked before the receiver is taken as
+	/// gone (then, inline until acked or reclaimed)
+	// .............................................................
+	void setAckTimeout (long ms) {
+	  ackTimeout = ms;
+	}
+
+	// .............................................................
+	/// Send size bytes written by fill (into the ring, or into an
+	/// inline frame).
+	// .............................................................
+	void send (size_t size, std::function<void(void *)> fill) {
+	  processAcks ();
+
+	  // in the ring (waiting a while for acks if full) or inline
+	  uint64_t start = 0;
+	  bool inRing = false;
+	  if ( shared && size >= minShared && size <= capacity && ! isGone () ) {
+		auto end = std::chrono::steady_clock::now () + std::chrono::milliseconds (fullWait);
+		while ( ! (inRing = allocate (size, start))
+				&& std::chrono::steady_clock::now () < end ) {
+		  processAcks (1);
+		  if ( isGone () ) {
+			break;
+		  }
+		}
+		if ( ! inRing ) {
+		  fullRing++;
+		}
+	  }
+
+	  frames.clear ();
+	  frames.emplace_back (); // delimiter
+	  if ( inRing ) {
+		fill (ring->data () + SHARED_RING_HEADER + start % capacity);
+		std::atomic_thread_fence (std::memory_order_release);
+		frames.push_back (textFrame ("#shm"));
+		frames.push_back (textFrame (ringName));
+		frames.push_back (textFrame (std::to_string (nonce)));
+		frames.push_back (textFrame (std::to_string (start / capacity)));
+		frames.push_back (textFrame (std::to_string (start % capacity)));
+		frames.push_back (textFrame (std::to_string (size)));
+		sharedSends++;
+	  } else {
+		frames.push_back (textFrame ("#inline"));
+		frames.emplace_back (size);
+		fill (frames.back().data ());
+		inlineSends++;
+	  }
+	  socket.sendFrames (frames);
+	}
+
+	// .............................................................
+	/// Send a copy of the bytes.
+	// .............................................................
+	void send (const void * data, size_t size) {
+	  send (size, [data, size] (void * where) { memcpy (where, data, size); } );
+	}
+
+	// .............................................................
+	/// Take the acks waiting (send does it).
+	/// @param time ms to wait for the first one
+	/// @return acks taken
+	// .............................................................
+	int processAcks (long time = 0) {
+	  int n = 0;
+	  while ( socket.receiveFrames (frames, n == 0 ? time : 0) ) {
+		size_t at = bodyStart (frames);
+		long long from, generation, offset;
+		if ( at + 4 <= frames.size () && frameIs (frames[at], "#ack")
+			 && frameNumber (frames[at+1], from) && from == nonce
+			 && frameNumber (frames[at+2], generation) && generation >= 0
+			 && frameNumber (frames[at+3], offset) && offset >= 0 ) {
+		  acked (uint64_t (generation) * capacity + uint64_t (offset));
+		  n++;
+		}
+		// (malformed, or for another instance: ignored)
+	  }
+	  return n;
+	}
+
+	// .............................................................
+	/// Wait for every payload in the ring to be acked.
+	/// @return false if timed out
+	// .............................................................
+	bool drain (long time = -1) {
+	  auto end = std::chrono::steady_clock::now () + std::chrono::milliseconds (time);
+	  while ( ! blocks.empty () ) {
+		if ( time >= 0 && std::chrono::steady_clock::now () > end ) {
+		  return false;
+		}
+		processAcks (10);
+	  }
+	  return true;
+	}
+
+	// .............................................................
+	/// Forget the blocks not acked: the whole ring is free again.
+	/// (Only when the receiver is known to be gone, e.g. restarted:
+	/// otherwise it may still be reading them.)
+	// .............................................................
+	void reclaim () {
+	  blocks.clear ();
+	  tail = head;
+	  peerGone = false;
+	}
+
+	// .............................................................
+	// .............................................................
+	bool isShared () const { return shared; }
+	bool isPeerGone () const { return peerGone; }
+	unsigned long sharedCount () const { return sharedSends; }
+	unsigned long inlineCount () const { return inlineSends; }
+	unsigned long fullRingCount () const { return fullRing; }
+	unsigned long peerGoneCount () const { return peerLost; }
+	uint64_t bytesInUse () const { return head - tail; }
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// A payload received: in the ring of the sender, or inline.
+  /// release() (or the destructor) lets the sender reuse it.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class SharedPayload {
+
+	template<int> friend class SharedRingReceiver;
+
+  private:
+
+	const char * where = nullptr;
+	size_t length = 0;
+	zmq::message_t inlined;
+	std::shared_ptr<SharedMapping> mapping; // (kept while in use)
+
+	/// the ack (envelope + "#ack", nonce, generation, offset), and who sends it
+	std::vector<zmq::message_t> ack;
+	std::function<void(std::vector<zmq::message_t> &)> sendAck;
+
+	SharedPayload (const SharedPayload & o) = delete;
+	SharedPayload & operator=(const SharedPayload & o) = delete;
+
+  public:
+
+	SharedPayload () { }
+
+	~SharedPayload () {
+	  try {
+		release ();
+	  } catch (...) { }
+	}
+
+	// .............................................................
+	// .............................................................
+	const void * data () const { return where; }
+	size_t size () const { return length; }
+
+	// .............................................................
+	/// Done with it (the data is not valid any more).
+	// .............................................................
+	void release () {
+	  if ( sendAck ) {
+		sendAck (ack);
+		sendAck = nullptr;
+	  }
+	  ack.clear ();
+	  mapping.reset ();
+	  where = nullptr;
+	  length = 0;
+	}
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The SharedRingReceiver class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  template<int ZMQ_SOCKET_TYPE>
+  class SharedRingReceiver {
+
+  private:
+
+	SocketAdaptor<ZMQ_SOCKET_TYPE> & socket;
+
+	/// the rings of the senders, by name
+	std::map< std::string, std::shared_ptr<SharedMapping> > rings;
+
+	std::vector<zmq::message_t> frames;
+
+	// .............................................................
+	// .............................................................
+	static std::string text (const zmq::message_t & frame) {
+	  return std::string { (const char *) frame.data (), frame.size () };
+	}
+
+	// .............................................................
+	// .............................................................
+	static bool isOfNonce (const SharedMapping & ring, long long nonce) {
+	  long long n = 0;
+	  if ( ring.bytes () < SHARED_RING_HEADER ) {
+		return false;
+	  }
+	  memcpy (&n, ring.data (), sizeof (n));
+	  return n == nonce;
+	}
+
+	// .............................................................
+	/// The ring of that name and nonce: mapped again if the sender
+	/// created it anew (the old mapping lives on while a payload
+	/// still uses it).
+	/// @return nullptr if not there (or of another nonce)
+	// .............................................................
+	std::shared_ptr<SharedMapping> ringNamed (const std::string & name, long long nonce) {
+	  auto & ring = rings[name];
+	  if ( ! ring || ! isOfNonce (*ring, nonce) ) {
+		try {
+		  ring.reset ( new SharedMapping {name, 0} );
+		} catch (std::runtime_error &) {
+		  ring.reset ();
+		  return nullptr;
+		}
+	  }
+	  return isOfNonce (*ring, nonce) ? ring : nullptr;
+	}
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	explicit SharedRingReceiver (SocketAdaptor<ZMQ_SOCKET_TYPE> & socket_)
+	  : socket {socket_}
+	{ }
+
+	// .............................................................
+	/// Receive a payload (the former one in payload is released).
+	/// @param time timeout in ms (-1 = blocking)
+	/// @return false if none (in time)
+	// .............................................................
+	bool receive (SharedPayload & payload, long time = -1) {
+	  payload.release ();
+
+	  while ( socket.receiveFrames (frames, time) ) {
+		size_t at = bodyStart (frames);
+
+		if ( at + 2 <= frames.size () && frameIs (frames[at], "#inline") ) {
+		  payload.inlined.move (&frames[at+1]);
+		  payload.where = static_cast<const char *> (payload.inlined.data ());
+		  payload.length = payload.inlined.size ();
+		  return true;
+		}
+
+		long long nonce, offset, length;
+		if ( at + 6 <= frames.size () && frameIs (frames[at], "#shm")
+			 && frameNumber (frames[at+2], nonce)
+			 && frameNumber (frames[at+4], offset) && offset >= 0
+			 && frameNumber (frames[at+5], length) && length >= 0 ) {
+		  auto ring = ringNamed (text (frames[at+1]), nonce);
+		  const uint64_t room = ring ? ring->bytes () - SHARED_RING_HEADER : 0;
+		  if ( ! ring || uint64_t (length) > room || uint64_t (offset) > room - length ) {
+			continue; // (a stale sender, or out of the ring: ignored)
+		  }
+		  std::atomic_thread_fence (std::memory_order_acquire);
+		  payload.where = ring->data () + SHARED_RING_HEADER + offset;
+		  payload.length = length;
+		  payload.mapping = ring;
+
+		  // the ack: the same envelope, nonce, generation and offset
+		  payload.ack.clear ();
+		  for (size_t i=0; i<at; i++) {
+			payload.ack.emplace_back ();
+			payload.ack.back().copy (&frames[i]);
+		  }
+		  payload.ack.push_back (textFrame ("#ack"));
+		  for (size_t i=at+2; i<at+5; i++) {
+			payload.ack.emplace_back ();
+			payload.ack.back().move (&frames[i]);
+		  }
+		  payload.sendAck = [this] (std::vector<zmq::message_t> & ack) {
+			socket.sendFrames (ack);
+		  };
+		  return true;
+		}
+		// (something else: ignored)
+	  }
+	  return false;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperSlowSubscriber.hpp
+ *
+ * SlowSubscriber: a SUB for consumers slower than their publisher
+ * (dashboards, monitors) which want recent data, not all of it.
+ *
+ *    SlowSubscriber quotes {theContext, "tcp://feed:5556", {"EUR", "USD"},
+ *                           SlowConsumerPolicy::CONFLATE};
+ *    while ( quotes.receive (lines, 1000) ) {
+ *      draw (lines);   // slow
+ *    }
+ *
+ * An inner thread reads the SUB as fast as messages come, so its
+ * zmq queue does not fill up (and the publisher does not drop at
+ * random for it), and keeps them in a bounded local buffer:
+ *
+ *  - CONFLATE: the latest message of each topic (the first frame)
+ *    only; a new one replaces the one still waiting, in its place.
+ *  - DROP_OLDEST: a ring of the last messages.
+ *
+ * Either way, memory is bounded (capacity messages) and what is
+ * read is recent. Counters tell how much was dropped and how old
+ * messages were when read (lag).
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_SLOW_SUBSCRIBER_H
+#define ZQM_HELPER_SLOW_SUBSCRIBER_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  enum class SlowConsumerPolicy { CONFLATE, DROP_OLDEST };
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The SlowSubscriber class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class SlowSubscriber {
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// .............................................................
+	// .............................................................
+	struct Item {
+	  std::vector<std::string> lines;
+	  Clock::time_point arrived;
+	};
+
+	// .............................................................
+	// .............................................................
+	const SlowConsumerPolicy policy;
+	const size_t capacity;
+
+	std::mutex theMutex;
+	std::condition_variable theCondition;
+
+	/// DROP_OLDEST: the messages; CONFLATE: the topics waiting
+	std::deque<Item> ring;
+	std::deque<std::string> topics;
+	std::unordered_map<std::string, Item> latest;
+
+	unsigned long received = 0;
+	unsigned long delivered = 0;
+	unsigned long dropped = 0;
+	size_t maxPending = 0;
+	long lastLag = 0;
+	long maxLag = 0;
+
+	std::atomic<bool> running {true};
+
+	// (last: its thread uses all of the above)
+	SocketAdaptorWithThread<ZMQ_SUB> theSocket;
+
+	// .............................................................
+	// .............................................................
+	SlowSubscriber (const SlowSubscriber & o) = delete;
+	SlowSubscriber & operator=(const SlowSubscriber & o) = delete;
+
+	// .............................................................
+	/// (with theMutex)
+	// .............................................................
+	size_t pending () const {
+	  return policy == SlowConsumerPolicy::CONFLATE ? topics.size () : ring.size ();
+	}
+
+	// .............................................................
+	/// A message came (inner thread).
+	// .............................................................
+	void store (std::vector<std::string> & lines) {
+	  std::unique_lock<std::mutex> theLock {theMutex};
+	  received++;
+
+	  if ( policy == SlowConsumerPolicy::DROP_OLDEST ) {
+		if ( ring.size () == capacity ) {
+		  ring.pop_front ();
+		  dropped++;
+		}
+		ring.push_back ( Item {} );
+		ring.back().lines.swap (lines);
+		ring.back().arrived = Clock::now ();
+	  } else {
+		const std::string topic = lines.empty () ? std::string {} : lines[0];
+		auto it = latest.find (topic);
+		if ( it != latest.end () ) {
+		  // replaced, keeps its place
+		  dropped++;
+		} else {
+		  if ( topics.size () == capacity ) {
+			latest.erase (topics.front ());
+			topics.pop_front ();
+			dropped++;
+		  }
+		  topics.push_back (topic);
+		  it = latest.emplace (topic, Item {}).first;
+		}
+		it->second.lines.swap (lines);
+		it->second.arrived = Clock::now ();
+	  }
+
+	  maxPending = std::max (maxPending, pending ());
+	  theCondition.notify_one ();
+	}
+
+	// .............................................................
+	// .............................................................
+	void main_Reader (SocketAdaptor<ZMQ_SUB> & socket,
+					  const std::string & url, const std::vector<std::string> & filters) {
+	  socket.connect (url);
+	  for (auto & f : filters) {
+		socket.subscribe (f);
+	  }
+
+	  std::vector<std::string> lines;
+	  while ( running ) {
+		if ( socket.receiveTextInTimeout (lines, 100) ) {
+		  store (lines);
+		}
+	  }
+	  socket.close ();
+	}
+
+  public:
+
+	// .............................................................
+	/// @param aContext the context (shared, for inproc)
+	/// @param url where the publisher is
+	/// @param filters subscriptions ("" for all)
+	/// @param policy_ what to keep when the consumer is behind
+	/// @param capacity_ messages kept at most (CONFLATE: topics)
+	// .............................................................
+	SlowSubscriber (zmq::context_t & aContext, const std::string & url,
+					const std::vector<std::string> & filters,
+					SlowConsumerPolicy policy_, size_t capacity_ = 1024)
+	  : policy {policy_}, capacity {std::max ((size_t) 1, capacity_)},
+		theSocket { aContext,
+		  [this, url, filters] (SocketAdaptor<ZMQ_SUB> & socket) {
+			main_Reader (socket, url, filters);
+		  } }
+	{ }
+
+	// .............................................................
+	// .............................................................
+	~SlowSubscriber () {
+	  stop ();
+	}
+
+	// .............................................................
+	/// Stop the inner thread.
+	// .............................................................
+	void stop () {
+	  {
+		std::unique_lock<std::mutex> theLock {theMutex};
+		running = false;
+	  }
+	  theCondition.notify_all ();
+	  theSocket.joinTheThread ();
+	}
+
+	// .............................................................
+	/// The next message kept (the oldest of them).
+	/// @param time timeout in ms (-1 = blocking)
+	/// @return false if none (in time)
+	// .............................................................
+	bool receive (std::vector<std::string> & lines, long time = -1) {
+	  std::unique_lock<std::mutex> theLock {theMutex};
+	  auto some = [this] () { return pending () > 0 || ! running; };
+
+	  if ( time < 0 ) {
+		theCondition.wait (theLock, some);
+	  } else {
+		theCondition.wait_for (theLock, std::chrono::milliseconds (time), some);
+	  }
+	  if ( pending () == 0 ) {
+		lines.clear ();
+		return false;
+	  }
+
+	  Clock::time_point arrived;
+	  if ( policy == SlowConsumerPolicy::DROP_OLDEST ) {
+		lines.swap (ring.front().lines);
+		arrived = ring.front().arrived;
+		ring.pop_front ();
+	  } else {
+		auto it = latest.find (topics.front ());
+		lines.swap (it->second.lines);
+		arrived = it->second.arrived;
+		latest.erase (it);
+		topics.pop_front ();
+	  }
+
+	  delivered++;
+	  lastLag = std::chrono::duration_cast<std::chrono::milliseconds>
+		(Clock::now () - arrived).count ();
+	  maxLag = std::max (maxLag, lastLag);
+	  return true;
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned long receivedCount () { std::unique_lock<std::mutex> l {theMutex}; return received; }
+	unsigned long deliveredCount () { std::unique_lock<std::mutex> l {theMutex}; return delivered; }
+	unsigned long dropCount () { std::unique_lock<std::mutex> l {theMutex}; return dropped; }
+	size_t pendingCount () { std::unique_lock<std::mutex> l {theMutex}; return pending (); }
+	size_t maxPendingCount () { std::unique_lock<std::mutex> l {theMutex}; return maxPending; }
+
+	// .............................................................
+	/// ms the last message read waited here (and the most)
+	// .............................................................
+	long lagMs () { std::unique_lock<std::mutex> l {theMutex}; return lastLag; }
+	long maxLagMs () { std::unique_lock<std::mutex> l {theMutex}; return maxLag; }
+
+  }; // class
+
+}; // namespace
+
+#endif
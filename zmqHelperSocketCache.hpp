@@ -0,0 +1,252 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperSocketCache.hpp
+ *
+ * SocketCache: a cache, per thread, of connected sockets, so that
+ * short conversations do not pay for a new socket and a new
+ * connection (handshake) each time:
+ *
+ *    {
+ *      auto socket = SocketCache::forThisThread ()
+ *                       .get<ZMQ_REQ> (theContext, "tcp://bank:5555");
+ *      socket->sendText ( {"put", "12.34"} );
+ *      socket->receiveText (lines);
+ *    } // the socket goes back to the cache, still connected
+ *
+ * Sockets are keyed by (context, type, endpoint). Being per thread,
+ * a socket is only used by the thread that made it, as always.
+ *
+ * Idle sockets are closed after some time, and beyond a cap (the
+ * least recently used first).
+ *
+ * Caution:
+ *  - Give a socket back ready for a new conversation (a REQ that
+ *    did not get its reply is not): else, call discard() on it.
+ *  - Call clear() before the context is destroyed in a thread that
+ *    outlives it (f.ex. main): an open socket would keep the context
+ *    waiting. Other threads close their sockets on exit.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_SOCKET_CACHE_H
+#define ZQM_HELPER_SOCKET_CACHE_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <chrono>
+#include <list>
+#include <memory>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The SocketCache class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class SocketCache {
+
+  public:
+
+	template<int ZMQ_SOCKET_TYPE> class Lease;
+
+  private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// .............................................................
+	/// A socket of any type.
+	// .............................................................
+	struct Holder {
+	  virtual ~Holder () { }
+	};
+
+	template<int ZMQ_SOCKET_TYPE>
+	struct TypedHolder : public Holder {
+	  SocketAdaptor<ZMQ_SOCKET_TYPE> socket;
+	  explicit TypedHolder (zmq::context_t & aContext) : socket {aContext} { }
+	};
+
+	// .............................................................
+	// .............................................................
+	struct Idle {
+	  zmq::context_t * context;
+	  int type;
+	  std::string endpoint;
+	  std::unique_ptr<Holder> holder;
+	  Clock::time_point since;
+	};
+
+	// .............................................................
+	// .............................................................
+	std::list<Idle> idle; // oldest first
+
+	size_t maxIdle = 64;
+	long idleMs = 30000;
+
+	unsigned long hits = 0;
+	unsigned long misses = 0;
+	unsigned long evictions = 0;
+
+	// .............................................................
+	// .............................................................
+	SocketCache () { }
+
+	SocketCache (const SocketCache & o) = delete;
+	SocketCache & operator=(const SocketCache & o) = delete;
+
+	// .............................................................
+	/// Close the ones idle for too long, or beyond the cap.
+	// .............................................................
+	void evict () {
+	  auto oldest = Clock::now () - std::chrono::milliseconds (idleMs);
+	  while ( ! idle.empty ()
+			  && (idle.size () > maxIdle || idle.front().since < oldest) ) {
+		idle.pop_front ();
+		evictions++;
+	  }
+	}
+
+	// .............................................................
+	/// (from a Lease)
+	// .............................................................
+	void giveBack (zmq::context_t * context, int type, const std::string & endpoint,
+				   std::unique_ptr<Holder> holder) {
+	  idle.push_back ( Idle {context, type, endpoint, std::move (holder), Clock::now ()} );
+	  evict ();
+	}
+
+  public:
+
+	// .............................................................
+	/// A socket taken from the cache: it goes back when this
+	/// goes out of scope.
+	// .............................................................
+	template<int ZMQ_SOCKET_TYPE>
+	class Lease {
+
+	  friend class SocketCache;
+
+	private:
+
+	  SocketCache * cache;
+	  zmq::context_t * context;
+	  std::string endpoint;
+	  std::unique_ptr<Holder> holder;
+
+	  Lease (SocketCache * cache_, zmq::context_t * context_,
+			 const std::string & endpoint_, std::unique_ptr<Holder> holder_)
+		: cache {cache_}, context {context_}, endpoint {endpoint_}, holder {std::move (holder_)}
+	  { }
+
+	  Lease (const Lease & o) = delete;
+	  Lease & operator=(const Lease & o) = delete;
+
+	public:
+
+	  // ...........................................................
+	  // ...........................................................
+	  Lease (Lease && o)
+		: cache {o.cache}, context {o.context}, endpoint {std::move (o.endpoint)},
+		  holder {std::move (o.holder)}
+	  { }
+
+	  // ...........................................................
+	  // ...........................................................
+	  ~Lease () {
+		if ( holder ) {
+		  cache->giveBack (context, ZMQ_SOCKET_TYPE, endpoint, std::move (holder));
+		}
+	  }
+
+	  // ...........................................................
+	  // ...........................................................
+	  SocketAdaptor<ZMQ_SOCKET_TYPE> & operator* () {
+		return static_cast< TypedHolder<ZMQ_SOCKET_TYPE> & > (*holder).socket;
+	  }
+
+	  SocketAdaptor<ZMQ_SOCKET_TYPE> * operator-> () {
+		return & (**this);
+	  }
+
+	  // ...........................................................
+	  /// Close the socket instead of giving it back (f.ex. a
+	  /// REQ which did not get its reply).
+	  // ...........................................................
+	  void discard () {
+		holder.reset ();
+	  }
+
+	}; // class
+
+	// .............................................................
+	/// The cache of the calling thread.
+	// .............................................................
+	static SocketCache & forThisThread () {
+	  static thread_local SocketCache cache;
+	  return cache;
+	}
+
+	// .............................................................
+	/// A socket of this type connected to the endpoint: an idle
+	/// one if any (the most recently used), else a new one.
+	// .............................................................
+	template<int ZMQ_SOCKET_TYPE>
+	Lease<ZMQ_SOCKET_TYPE> get (zmq::context_t & aContext, const std::string & endpoint) {
+	  evict ();
+
+	  for (auto it = idle.rbegin (); it != idle.rend (); ++it) {
+		if ( it->context == &aContext && it->type == ZMQ_SOCKET_TYPE
+			 && it->endpoint == endpoint ) {
+		  std::unique_ptr<Holder> holder = std::move (it->holder);
+		  idle.erase (std::next (it).base ());
+		  hits++;
+		  return Lease<ZMQ_SOCKET_TYPE> {this, &aContext, endpoint, std::move (holder)};
+		}
+	  }
+
+	  misses++;
+	  auto typed = new TypedHolder<ZMQ_SOCKET_TYPE> {aContext};
+	  std::unique_ptr<Holder> holder {typed};
+	  typed->socket.connect (endpoint);
+	  return Lease<ZMQ_SOCKET_TYPE> {this, &aContext, endpoint, std::move (holder)};
+	}
+
+	// .............................................................
+	/// @param maxIdle_ idle sockets kept at most
+	/// @param idleMs_ idle sockets are closed after this
+	// .............................................................
+	void setLimits (size_t maxIdle_, long idleMs_) {
+	  maxIdle = maxIdle_;
+	  idleMs = idleMs_;
+	  evict ();
+	}
+
+	// .............................................................
+	/// Close all the idle sockets.
+	// .............................................................
+	void clear () {
+	  idle.clear ();
+	}
+
+	// .............................................................
+	// .............................................................
+	size_t idleCount () const { return idle.size (); }
+	unsigned long hitCount () const { return hits; }
+	unsigned long missCount () const { return misses; }
+	unsigned long evictionCount () const { return evictions; }
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,434 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperStreaming.hpp
+ *
+ * Transfer of objects of any size (files, blobs of gigabytes) in
+ * chunks, as the file transfer of the zguide ("credit-based flow
+ * control"): the receiver asks for chunks, keeping at most a window
+ * of them asked for and not yet got. So both sides hold only that
+ * window in memory, whatever the size of the object, and the pipe
+ * is never empty.
+ *
+ *    // sender: ROUTER, objects offered by name
+ *    StreamSender out {router};
+ *    out.offer ("data.bin", fd);            // read with pread
+ *    out.offer ("frame", region, size);     // (as mmap) sent without copy
+ *    out.run ();                            // or serveOnce ()
+ *    out.withdraw ("frame", 1000);          // (then region can go)
+ *
+ *    // receiver: DEALER
+ *    StreamReceiver in {dealer};
+ *    long long got = in.fetch ("data.bin", [&] (const void * p, size_t n) {
+ *        ...; return true; } );            // chunks in order
+ *    in.fetchTo ("data.bin", fd);           // or straight to a file
+ *
+ * Frames (after the envelope):
+ *    {"#fetch", fetch id, name, offset, size}
+ *    back: {"#chunk", fetch id, offset, bytes} (short: the end)
+ *          {"#unknown", fetch id, name}
+ *          {"#refused", fetch id, name} (malformed, or size over the
+ *          maximum chunk of the sender)
+ *          {"#error", fetch id, name} (the file could not be read)
+ *
+ * Features C++11, POSIX (pread, write)
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_STREAMING_H
+#define ZQM_HELPER_STREAMING_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The StreamSender class. It does not own the socket: call
+  /// run() (or serveOnce()) from the thread owning it.
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class StreamSender {
+
+  private:
+
+	// .............................................................
+	// .............................................................
+	struct Source {
+	  int fd = -1;                  // read with pread, or
+	  const char * region = nullptr; // sent as it is
+	  uint64_t size = 0;
+	  bool withdrawn = false;
+	  /// frames of region not yet freed by zmq (shared with their
+	  /// free function, so it may outlive the source)
+	  std::shared_ptr< std::atomic<long> > inFlight {new std::atomic<long> {0}};
+	};
+
+	using Counter = std::shared_ptr< std::atomic<long> >;
+
+	SocketAdaptor<ZMQ_ROUTER> & socket;
+	const uint64_t maxChunk;
+	std::map<std::string, Source> sources;
+
+	std::vector<zmq::message_t> frames;
+
+	unsigned long long bytes = 0;
+	unsigned long chunks = 0;
+
+	// .............................................................
+	// .............................................................
+	static std::string text (const zmq::message_t & frame) {
+	  return std::string { (const char *) frame.data (), frame.size () };
+	}
+
+	// .............................................................
+	/// zmq is done with a frame of a region
+	// .............................................................
+	static void regionFrameFreed (void *, void * hint) {
+	  Counter * inFlight = static_cast<Counter *> (hint);
+	  (**inFlight)--;
+	  delete inFlight;
+	}
+
+	// .............................................................
+	/// The chunk [offset, offset+size) of source (cut at its end).
+	/// @return false if the file could not be read
+	// .............................................................
+	static bool chunkOf (const Source & source, uint64_t offset, uint64_t size,
+						 zmq::message_t & chunk) {
+	  uint64_t n = offset >= source.size ? 0 : std::min (size, source.size - offset);
+
+	  if ( source.region != nullptr && n > 0 ) {
+		// no copy: counted in flight until zmq frees it (see withdraw)
+		(*source.inFlight)++;
+		zmq::message_t inPlace { const_cast<char *> (source.region + offset), n,
+			regionFrameFreed, new Counter {source.inFlight} };
+		chunk.move (&inPlace);
+		return true;
+	  }
+
+	  zmq::message_t whole (n);
+	  char * to = static_cast<char *> (whole.data ());
+	  uint64_t done = 0;
+	  while ( done < n ) {
+		ssize_t r = pread (source.fd, to + done, n - done, offset + done);
+		if ( r < 0 && errno == EINTR ) {
+		  continue;
+		}
+		if ( r < 0 ) {
+		  return false;
+		}
+		if ( r == 0 ) {
+		  break; // (shrunk: a short chunk, the end)
+		}
+		done += r;
+	  }
+	  if ( done < n ) {
+		zmq::message_t shorter (to, done);
+		chunk.move (&shorter);
+	  } else {
+		chunk.move (&whole);
+	  }
+	  return true;
+	}
+
+	// .............................................................
+	/// Reply {tag, fetch id, name} to the fetch in frames (at: its body)
+	// .............................................................
+	void fail (std::vector<zmq::message_t> & reply, const char * tag, size_t at) {
+	  reply.push_back (textFrame (tag));
+	  reply.emplace_back ();
+	  reply.back().move (&frames[at+1]);
+	  reply.emplace_back ();
+	  reply.back().move (&frames[at+2]);
+	  socket.sendFrames (reply);
+	}
+
+	// .............................................................
+	// .............................................................
+	void serve () {
+	  size_t at = bodyStart (frames);
+	  if ( at + 5 > frames.size () || ! frameIs (frames[at], "#fetch") ) {
+		return; // not for us
+	  }
+
+	  std::vector<zmq::message_t> reply;
+	  for (size_t i=0; i<at; i++) {
+		reply.emplace_back ();
+		reply.back().move (&frames[i]); // envelope
+	  }
+
+	  auto it = sources.find (text (frames[at+2]));
+	  long long offset, size;
+	  const bool known = it != sources.end () && ! it->second.withdrawn;
+	  const bool wellFormed = frameNumber (frames[at+3], offset) && offset >= 0
+		&& frameNumber (frames[at+4], size) && size >= 0
+		&& uint64_t (size) <= maxChunk;
+	  if ( ! known || ! wellFormed ) {
+		fail (reply, known ? "#refused" : "#unknown", at);
+		return;
+	  }
+
+	  zmq::message_t chunk;
+	  if ( ! chunkOf (it->second, offset, size, chunk) ) {
+		fail (reply, "#error", at);
+		return;
+	  }
+
+	  reply.push_back (textFrame ("#chunk"));
+	  reply.emplace_back ();
+	  reply.back().move (&frames[at+1]);
+	  reply.emplace_back ();
+	  reply.back().move (&frames[at+3]);
+	  reply.emplace_back ();
+	  reply.back().move (&chunk);
+
+	  bytes += reply.back().size ();
+	  chunks++;
+	  socket.sendFrames (reply);
+	}
+
+  public:
+
+	// .............................................................
+	/// @param maxChunk_ bytes of the biggest chunk it sends (bigger
+	/// fetches are refused): memory of a fetch
+	// .............................................................
+	explicit StreamSender (SocketAdaptor<ZMQ_ROUTER> & socket_,
+						   uint64_t maxChunk_ = 4 * 1024 * 1024)
+	  : socket {socket_}, maxChunk {maxChunk_}
+	{ }
+
+	// .............................................................
+	/// Offer the file open at fd (not owned: close it after
+	/// withdraw). Its size is taken now.
+	// .............................................................
+	bool offer (const std::string & name, int fd) {
+	  struct stat st;
+	  if ( fstat (fd, &st) != 0 ) {
+		return false;
+	  }
+	  Source s;
+	  s.fd = fd;
+	  s.size = st.st_size;
+	  sources[name] = s;
+	  return true;
+	}
+
+	// .............................................................
+	/// Offer the bytes of region (an mmap of a file, say). Chunks
+	/// are sent without copy: the region must stay there (unchanged)
+	/// until withdraw says no chunk of it is in flight.
+	// .............................................................
+	void offer (const std::string & name, const void * region, uint64_t size) {
+	  Source s;
+	  s.region = static_cast<const char *> (region);
+	  s.size = size;
+	  sources[name] = s;
+	}
+
+	// .............................................................
+	/// No more fetches of it; waits for its chunks in flight (zmq
+	/// still sending them) to be freed.
+	/// @param time ms to wait (-1 = until freed)
+	/// @return true if gone (a region can be unmapped); false if
+	/// chunks still in flight (withdraw again later)
+	// .............................................................
+	bool withdraw (const std::string & name, long time = -1) {
+	  auto it = sources.find (name);
+	  if ( it == sources.end () ) {
+		return true;
+	  }
+	  it->second.withdrawn = true;
+	  auto end = std::chrono::steady_clock::now () + std::chrono::milliseconds (time);
+	  while ( *it->second.inFlight > 0 ) {
+		if ( time >= 0 && std::chrono::steady_clock::now () > end ) {
+		  return false;
+		}
+		std::this_thread::sleep_for (std::chrono::milliseconds (1));
+	  }
+	  sources.erase (it);
+	  return true;
+	}
+
+	// .............................................................
+	/// @return chunks of name not yet freed by zmq
+	// .............................................................
+	long inFlightCount (const std::string & name) const {
+	  auto it = sources.find (name);
+	  return it == sources.end () ? 0 : it->second.inFlight->load ();
+	}
+
+	// .............................................................
+	/// Serve the fetches waiting (waits time ms for the first one).
+	/// @return false if none
+	// .............................................................
+	bool serveOnce (long time = -1) {
+	  if ( ! socket.receiveFrames (frames, time) ) {
+		return false;
+	  }
+	  do {
+		serve ();
+	  } while ( socket.receiveFrames (frames, 0) );
+	  return true;
+	}
+
+	// .............................................................
+	/// Forever.
+	// .............................................................
+	void run () {
+	  while (true) {
+		serveOnce (-1);
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned long long bytesSent () const { return bytes; }
+	unsigned long chunksSent () const { return chunks; }
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The StreamReceiver class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class StreamReceiver {
+
+  public:
+
+	/// gets the chunks in order; false to stop
+	using Sink = std::function<bool(const void *, size_t)>;
+
+  private:
+
+	SocketAdaptor<ZMQ_DEALER> & socket;
+	const size_t chunkSize;
+	const int window;
+
+	/// (replies to former fetches, given up, are told by it)
+	unsigned long fetchId = 0;
+
+	std::vector<zmq::message_t> frames;
+
+	// .............................................................
+	// .............................................................
+	static std::string text (const zmq::message_t & frame) {
+	  return std::string { (const char *) frame.data (), frame.size () };
+	}
+
+  public:
+
+	// .............................................................
+	/// @param chunkSize_ bytes of a chunk
+	/// @param window_ chunks asked for and not yet got (credit):
+	/// memory in flight is chunkSize_ * window_
+	// .............................................................
+	StreamReceiver (SocketAdaptor<ZMQ_DEALER> & socket_,
+					size_t chunkSize_ = 256 * 1024, int window_ = 8)
+	  : socket {socket_}, chunkSize {chunkSize_}, window {window_}
+	{ }
+
+	// .............................................................
+	/// Get the object: its chunks, in order, go to sink.
+	/// @param time ms to wait for each chunk (-1 = blocking)
+	/// @return its size; -1 if unknown, refused, unreadable, timed
+	/// out, stopped by sink or a chunk out of sequence
+	// .............................................................
+	long long fetch (const std::string & name, Sink sink, long time = -1) {
+	  const std::string id = std::to_string (++fetchId);
+	  uint64_t offset = 0;
+	  long long got = 0;
+	  int credit = window;
+	  bool ended = false;
+
+	  while (true) {
+
+		// spend the credit
+		while ( ! ended && credit > 0 ) {
+		  socket.sendText ( {"", "#fetch", id, name, std::to_string (offset),
+				std::to_string (chunkSize)} );
+		  offset += chunkSize;
+		  credit--;
+		}
+
+		if ( credit == window ) {
+		  return got; // every chunk asked for, got
+		}
+
+		if ( ! socket.receiveFrames (frames, time) ) {
+		  return -1;
+		}
+		size_t at = bodyStart (frames);
+		if ( at + 2 > frames.size () || ! frameIs (frames[at+1], id.c_str ()) ) {
+		  continue; // from a former fetch
+		}
+		if ( frameIs (frames[at], "#unknown") || frameIs (frames[at], "#refused")
+			 || frameIs (frames[at], "#error") ) {
+		  return -1;
+		}
+		if ( at + 4 > frames.size () || ! frameIs (frames[at], "#chunk") ) {
+		  continue;
+		}
+
+		credit++;
+		if ( ended ) {
+		  continue; // asked for before the end was known: dropped
+		}
+		long long chunkOffset;
+		if ( ! frameNumber (frames[at+2], chunkOffset) || chunkOffset != got ) {
+		  return -1; // out of sequence: the sink would get a hole
+		}
+		const zmq::message_t & chunk = frames[at+3];
+		if ( chunk.size () > 0 && ! sink (chunk.data (), chunk.size ()) ) {
+		  return -1;
+		}
+		got += chunk.size ();
+		if ( chunk.size () < chunkSize ) {
+		  ended = true;
+		}
+	  } // while
+	}
+
+	// .............................................................
+	/// Get the object, written to fd.
+	// .............................................................
+	long long fetchTo (const std::string & name, int fd, long time = -1) {
+	  return fetch (name, [fd] (const void * data, size_t size) {
+		  const char * p = static_cast<const char *> (data);
+		  while ( size > 0 ) {
+			ssize_t w = ::write (fd, p, size);
+			if ( w <= 0 ) {
+			  return false;
+			}
+			p += w;
+			size -= w;
+		  }
+		  return true;
+		}, time);
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperWorkStealing.hpp
+ *
+ * WorkStealingServer: one ROUTER front end, handlers run on
+ * a pool of worker threads (one per core by default).
+ *
+ *  -> ROUTER -> (thread calling run()) -> per-worker deques
+ *                     ^                        | (idle workers steal)
+ *                     |                        v
+ *                     +---- return queue <---- handler
+ *
+ * Only the thread calling run() touches the ROUTER socket.
+ * Workers don't use sockets at all: they get requests from
+ * their own deque (or steal them from a busy worker),
+ * and give back their replies through a lock-free queue.
+ * Thus, skewed request costs don't leave cores idle
+ * while one worker is backlogged.
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_WORK_STEALING_H
+#define ZQM_HELPER_WORK_STEALING_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+
+#include "zmqHelper.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// MpscQueue: lock-free, unbounded, many producers, one consumer.
+  /// (Vyukov's intrusive queue)
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  template<typename T>
+  class MpscQueue {
+
+  private:
+
+	struct Node {
+	  std::atomic<Node *> next {nullptr};
+	  T value;
+	};
+
+	std::atomic<Node *> head; // producers push here
+	Node * tail; // consumer pops here (always a consumed node)
+
+	MpscQueue (const MpscQueue & o) = delete;
+	MpscQueue & operator=(const MpscQueue & o) = delete;
+
+  public:
+
+	// .............................................................
+	// .............................................................
+	MpscQueue () {
+	  Node * stub = new Node {};
+	  head = stub;
+	  tail = stub;
+	}
+
+	// .............................................................
+	// .............................................................
+	~MpscQueue () {
+	  T dummy;
+	  while ( pop (dummy) ) { }
+	  delete tail;
+	}
+
+	// .............................................................
+	/// Any thread.
+	// .............................................................
+	void push (T && value) {
+	  Node * n = new Node {};
+	  n->value = std::move (value);
+	  Node * prev = head.exchange (n, std::memory_order_acq_rel);
+	  prev->next.store (n, std::memory_order_release);
+	}
+
+	// .............................................................
+	/// Consumer thread only.
+	/// @return false if empty (or a push is half done).
+	// .............................................................
+	bool pop (T & out) {
+	  Node * next = tail->next.load (std::memory_order_acquire);
+	  if (next == nullptr) {
+		return false;
+	  }
+	  out = std::move (next->value);
+	  delete tail;
+	  tail = next;
+	  return true;
+	}
+
+  }; // class
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The WorkStealingServer class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class WorkStealingServer {
+
+  public:
+
+	// .............................................................
+	/// Gets the request body (without the envelope),
+	/// @return the reply body. Run by the worker threads.
+	// .............................................................
+	using HandlerType
+	  = std::function<std::vector<std::string>(const std::vector<std::string> &)>;
+
+  private:
+
+	// .............................................................
+	/// A request (or its reply): the ROUTER envelope
+	/// (identities + empty delimiter) and the body.
+	// .............................................................
+	struct Job {
+	  std::vector<std::string> envelope;
+	  std::vector<std::string> body;
+	};
+
+	// .............................................................
+	/// A worker, with its deque. The owner takes from the front
+	/// (oldest first), thieves take from the back.
+	// .............................................................
+	struct Worker {
+	  std::atomic_flag lock = ATOMIC_FLAG_INIT; // short critical sections
+	  std::deque<Job> jobs;
+	  std::thread * theThread = nullptr;
+	  std::atomic<unsigned long> handled {0};
+	  std::atomic<unsigned long> stolen {0};
+
+	  void acquire () { while ( lock.test_and_set (std::memory_order_acquire) ) { } }
+	  void release () { lock.clear (std::memory_order_release); }
+
+	  void push (Job && j) {
+		acquire ();
+		jobs.push_back (std::move (j));
+		release ();
+	  }
+
+	  bool take (Job & j, bool fromFront) {
+		acquire ();
+		if ( jobs.empty () ) {
+		  release ();
+		  return false;
+		}
+		if (fromFront) {
+		  j = std::move (jobs.front ());
+		  jobs.pop_front ();
+		} else {
+		  j = std::move (jobs.back ());
+		  jobs.pop_back ();
+		}
+		release ();
+		return true;
+	  }
+	};
+
+	// .............................................................
+	// .............................................................
+	zmq::context_t & theContext;
+	const std::string url;
+	HandlerType theHandler;
+
+	std::vector< std::unique_ptr<Worker> > theWorkers;
+	unsigned int nextWorker = 0;
+
+	// .............................................................
+	/// Idle workers sleep here.
+	// .............................................................
+	std::atomic<long> pendingJobs {0};
+	std::atomic<int> sleepingWorkers {0};
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+
+	// .............................................................
+	/// Replies back to the ROUTER thread, and a pipe to awake it.
+	// .............................................................
+	MpscQueue<Job> replies;
+	std::atomic<bool> wakeupPending {false};
+	int wakeupPipe[2] = {-1, -1};
+
+	/// true from the start: only stop() changes it (so a stop()
+	/// before run() is not lost)
+	std::atomic<bool> running {true};
+
+	// .............................................................
+	// .............................................................
+	WorkStealingServer (const WorkStealingServer & o) = delete;
+	WorkStealingServer & operator=(const WorkStealingServer & o) = delete;
+
+	// .............................................................
+	// .............................................................
+	void wakeupRouterThread () {
+	  if ( wakeupPending.exchange (true) ) {
+		return; // already awaken
+	  }
+	  char c = 0;
+	  ssize_t n = write (wakeupPipe[1], &c, 1);
+	  (void) n;
+	}
+
+	// .............................................................
+	/// Own deque first, otherwise steal (starting at a random victim).
+	// .............................................................
+	bool findJob (unsigned int me, Job & j, std::minstd_rand & random) {
+	  if ( theWorkers[me]->take (j, true) ) {
+		return true;
+	  }
+	  unsigned int n = theWorkers.size ();
+	  unsigned int start = random () % n;
+	  for (unsigned int k=0; k<n; k++) {
+		unsigned int victim = (start + k) % n;
+		if ( victim != me && theWorkers[victim]->take (j, false) ) {
+		  theWorkers[me]->stolen++;
+		  return true;
+		}
+	  }
+	  return false;
+	}
+
+	// .............................................................
+	// .............................................................
+	void main_Worker (unsigned int me) {
+
+	  std::minstd_rand random {me + 1};
+	  Job j;
+
+	  while (running) {
+
+		if ( findJob (me, j, random) ) {
+		  pendingJobs--;
+		  j.body = theHandler (j.body);
+		  theWorkers[me]->handled++;
+		  replies.push (std::move (j));
+		  wakeupRouterThread ();
+		  continue;
+		}
+
+		// nothing to do: sleep
+		std::unique_lock<std::mutex> theLock {sleepMutex};
+		sleepingWorkers++;
+		sleepCondition.wait (theLock, [this] () { return pendingJobs > 0 || ! running; });
+		sleepingWorkers--;
+	  } // while
+	}
+
+	// .............................................................
+	/// Called by the ROUTER thread. Round robin among the workers.
+	// .............................................................
+	void dispatch (Job && j) {
+	  theWorkers[nextWorker]->push (std::move (j));
+	  nextWorker = (nextWorker + 1) % theWorkers.size ();
+
+	  pendingJobs++;
+	  if (sleepingWorkers > 0) {
+		std::unique_lock<std::mutex> theLock {sleepMutex};
+		sleepCondition.notify_one ();
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	void startWorkers () {
+	  for (unsigned int i=0; i<theWorkers.size (); i++) {
+		theWorkers[i]->theThread = new std::thread (&WorkStealingServer::main_Worker, this, i);
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	void joinWorkers () {
+	  {
+		std::unique_lock<std::mutex> theLock {sleepMutex};
+		sleepCondition.notify_all ();
+	  }
+	  for (auto & w : theWorkers) {
+		if (w->theThread != nullptr) {
+		  w->theThread->join ();
+		  delete w->theThread;
+		  w->theThread = nullptr;
+		}
+	  }
+	}
+
+  public:
+
+	// .............................................................
+	/// Constructor.
+	/// @param aContext the context for the ROUTER socket.
+	/// @param url where the ROUTER binds.
+	/// @param handler the function serving the requests.
+	/// @param workers how many worker threads. 0 = one per core.
+	// .............................................................
+	WorkStealingServer (zmq::context_t & aContext, const std::string & url_,
+						HandlerType handler, unsigned int workers = 0)
+	  : theContext {aContext}, url {url_}, theHandler {handler}
+	{
+	  if (workers == 0) {
+		workers = std::max (1u, std::thread::hardware_concurrency ());
+	  }
+	  for (unsigned int i=0; i<workers; i++) {
+		theWorkers.emplace_back ( new Worker {} );
+	  }
+
+	  if ( pipe (wakeupPipe) != 0 ) {
+		throw std::runtime_error ("WorkStealingServer: can't create pipe");
+	  }
+	  fcntl (wakeupPipe[0], F_SETFL, O_NONBLOCK);
+	  fcntl (wakeupPipe[1], F_SETFL, O_NONBLOCK);
+	}
+
+	// .............................................................
+	// .............................................................
+	~WorkStealingServer () {
+	  running = false;
+	  joinWorkers ();
+	  close (wakeupPipe[0]);
+	  close (wakeupPipe[1]);
+	}
+
+	// .............................................................
+	/// Serve until stop() is called (once: if stop() came before,
+	/// it returns at once). The calling thread creates (and it is
+	/// the only one using) the ROUTER socket.
+	// .............................................................
+	void run () {
+
+	  if ( ! running ) {
+		return;
+	  }
+
+	  SocketAdaptor< ZMQ_ROUTER > router {theContext};
+	  router.bind (url);
+
+	  startWorkers ();
+
+	  std::vector<std::string> lines;
+
+	  while (running) {
+
+		zmq::pollitem_t items [] = {
+		  { *router.getZmqSocket (), 0, ZMQ_POLLIN, 0 },
+		  { nullptr, wakeupPipe[0], ZMQ_POLLIN, 0 } };
+
+		zmq::poll ( &items[0], 2, -1 );
+
+		//
+		// replies first
+		//
+		if ( items[1].revents & ZMQ_POLLIN ) {
+		  char buff[64];
+		  while ( read (wakeupPipe[0], buff, sizeof (buff)) > 0 ) { }
+		  // clear before draining: a reply pushed from now on
+		  // will write to the pipe again
+		  wakeupPending = false;
+
+		  Job j;
+		  while ( replies.pop (j) ) {
+			j.envelope.insert (j.envelope.end (), j.body.begin (), j.body.end ());
+			router.sendText (j.envelope);
+		  }
+		}
+
+		//
+		// requests
+		//
+		if ( items[0].revents & ZMQ_POLLIN ) {
+		  while ( router.tryReceiveText (lines) ) {
+			// split envelope and body at the empty delimiter
+			auto delimiter = std::find (lines.begin (), lines.end (), "");
+			if ( delimiter == lines.end () ) {
+			  continue; // not a REQ/DEALER with envelope: ignore
+			}
+			Job j;
+			j.envelope.assign (lines.begin (), delimiter + 1);
+			j.body.assign (delimiter + 1, lines.end ());
+			dispatch (std::move (j));
+		  }
+		}
+	  } // while
+
+	  joinWorkers ();
+
+	  router.close ();
+	}
+
+	// .............................................................
+	/// Stop run(). (Any thread).
+	// .............................................................
+	void stop () {
+	  running = false;
+	  wakeupPending = false;
+	  wakeupRouterThread ();
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned int workerCount () const {
+	  return theWorkers.size ();
+	}
+
+	// .............................................................
+	/// @return requests served by the i-th worker
+	// .............................................................
+	unsigned long handledBy (unsigned int i) const {
+	  return theWorkers[i]->handled;
+	}
+
+	// .............................................................
+	/// @return requests the i-th worker stole from the others
+	// .............................................................
+	unsigned long stolenBy (unsigned int i) const {
+	  return theWorkers[i]->stolen;
+	}
+
+  }; // class
+
+}; // namespace
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * -----------------------------------------------------------------
+ * zmqHelperXPublisher.hpp
+ *
+ * SubscriptionAwarePublisher: a publisher (on a XPUB) which knows
+ * what its subscribers want, from their subscribe / unsubscribe
+ * messages, so the work of making an update nobody wants is not
+ * done:
+ *
+ *    SubscriptionAwarePublisher pub {theContext};
+ *    pub.bind ("ipc:///tmp/quotes");
+ *    ...
+ *    pub.publish (topic, [&] (std::vector<std::string> & body) {
+ *      body.push_back (encode (state));   // only if wanted
+ *    });
+ *
+ * Subscriptions are kept as prefixes with their count (as many as
+ * subscribers did subscribe it): isWanted(topic) tells if any of
+ * them matches, subscriberCount(prefix) how many there are.
+ *
+ * awaitSubscriber(topic) waits for somebody to want it: no update
+ * is lost for a subscriber that joins late (as with a sleep).
+ *
+ * Owned by the thread making it (as its socket).
+ *
+ * Features C++11
+ *
+ * -----------------------------------------------------------------
+ */
+
+#ifndef ZQM_HELPER_XPUBLISHER_H
+#define ZQM_HELPER_XPUBLISHER_H
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+#include <chrono>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+#include "zmqHelperOptions.hpp"
+
+// -----------------------------------------------------------------
+// -----------------------------------------------------------------
+namespace zmqHelper {
+
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  ///
+  /// The SubscriptionAwarePublisher class
+  ///
+  // ---------------------------------------------------------------
+  // ---------------------------------------------------------------
+  class SubscriptionAwarePublisher {
+
+  private:
+
+	SocketAdaptor<ZMQ_XPUB> theSocket;
+
+	/// prefix -> subscribers
+	std::map<std::string, int> subscriptions;
+
+	/// topic -> wanted? (forgotten when subscriptions change)
+	std::unordered_map<std::string, bool> wanted;
+
+	std::vector<std::string> lines;
+	std::vector<zmq::message_t> frames;
+
+	unsigned long published = 0;
+	unsigned long skipped = 0;
+
+	// .............................................................
+	// .............................................................
+	SubscriptionAwarePublisher (const SubscriptionAwarePublisher & o) = delete;
+	SubscriptionAwarePublisher & operator=(const SubscriptionAwarePublisher & o) = delete;
+
+	// .............................................................
+	/// A (un)subscription: 1 or 0, then the prefix.
+	// .............................................................
+	void apply (const zmq::message_t & frame) {
+	  if ( frame.size () == 0 ) {
+		return;
+	  }
+	  const char * data = static_cast<const char *> (frame.data ());
+	  std::string prefix {data + 1, frame.size () - 1};
+
+	  if ( data[0] == 1 ) {
+		subscriptions[prefix]++;
+	  } else if ( data[0] == 0 ) {
+		auto it = subscriptions.find (prefix);
+		if ( it != subscriptions.end () && --it->second <= 0 ) {
+		  subscriptions.erase (it);
+		}
+	  } else {
+		return;
+	  }
+	  wanted.clear ();
+	}
+
+  public:
+
+	// .............................................................
+	/// @param aContext context (shared, for inproc)
+	// .............................................................
+	explicit SubscriptionAwarePublisher (zmq::context_t & aContext)
+	  : theSocket {aContext}
+	{
+	  // every subscribe / unsubscribe comes up (not only the first
+	  // and the last one of a prefix): they are counted
+#ifdef ZMQ_XPUB_VERBOSER
+	  theSocket.set<option::XpubVerboser> (1);
+#else
+	  theSocket.set<option::XpubVerbose> (1);
+#endif
+	}
+
+	// .............................................................
+	// .............................................................
+	void bind (const std::string & url) {
+	  theSocket.bind (url);
+	}
+
+	void connect (const std::string & url) {
+	  theSocket.connect (url);
+	}
+
+	void close () {
+	  theSocket.close ();
+	}
+
+	// .............................................................
+	/// Take the subscription messages waiting (publish does it).
+	/// @param time ms to wait for the first one (0: don't)
+	/// @return true if there was any
+	// .............................................................
+	bool processSubscriptions (long time = 0) {
+	  bool any = false;
+	  while ( theSocket.receiveFrames (frames, any ? 0 : time) ) {
+		any = true;
+		for (auto & f : frames) {
+		  apply (f);
+		}
+	  }
+	  return any;
+	}
+
+	// .............................................................
+	/// @return does any subscription match the topic?
+	// .............................................................
+	bool isWanted (const std::string & topic) {
+	  auto it = wanted.find (topic);
+	  if ( it != wanted.end () ) {
+		return it->second;
+	  }
+
+	  bool yes = false;
+	  for (size_t n=0; n<=topic.size () && ! yes; n++) {
+		yes = subscriptions.count (topic.substr (0, n)) > 0;
+	  }
+	  if ( wanted.size () >= 4096 ) {
+		wanted.clear ();
+	  }
+	  wanted[topic] = yes;
+	  return yes;
+	}
+
+	// .............................................................
+	/// Wait until the topic is wanted.
+	/// @param time timeout in ms (-1 = forever)
+	/// @return false if timed out
+	// .............................................................
+	bool awaitSubscriber (const std::string & topic, long time = -1) {
+	  auto end = std::chrono::steady_clock::now () + std::chrono::milliseconds (time);
+	  processSubscriptions ();
+	  while ( ! isWanted (topic) ) {
+		long left = -1;
+		if ( time >= 0 ) {
+		  left = std::chrono::duration_cast<std::chrono::milliseconds>
+			(end - std::chrono::steady_clock::now ()).count ();
+		  if ( left <= 0 ) {
+			return false;
+		  }
+		}
+		processSubscriptions (left);
+	  }
+	  return true;
+	}
+
+	// .............................................................
+	/// Publish topic + the frames made by encode, if the topic is
+	/// wanted. Else, encode is not even called.
+	/// @param encode void(std::vector<std::string> & body)
+	/// @return true if published
+	// .............................................................
+	template<typename Encoder>
+	bool publish (const std::string & topic, Encoder encode) {
+	  processSubscriptions ();
+
+	  if ( ! isWanted (topic) ) {
+		skipped++;
+		return false;
+	  }
+
+	  lines.assign (1, topic);
+	  encode (lines);
+	  theSocket.sendText (lines);
+	  published++;
+	  return true;
+	}
+
+	// .............................................................
+	/// Publish topic + body (already made), if wanted.
+	// .............................................................
+	bool publish (const std::string & topic, const std::vector<std::string> & body) {
+	  return publish (topic, [&body] (std::vector<std::string> & out) {
+		  out.insert (out.end (), body.begin (), body.end ());
+		} );
+	}
+
+	// .............................................................
+	/// @return subscribers of exactly this prefix
+	// .............................................................
+	int subscriberCount (const std::string & prefix) const {
+	  auto it = subscriptions.find (prefix);
+	  return it == subscriptions.end () ? 0 : it->second;
+	}
+
+	// .............................................................
+	/// Visit every (prefix, subscribers).
+	// .............................................................
+	void forEachSubscription (std::function<void(const std::string &, int)> f) const {
+	  for (auto & s : subscriptions) {
+		f (s.first, s.second);
+	  }
+	}
+
+	// .............................................................
+	// .............................................................
+	unsigned long publishedCount () const { return published; }
+	unsigned long skippedCount () const { return skipped; }
+
+  }; // class
+
+}; // namespace
+
+#endif